@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/intel8080.h"
+
+/* ALU heavy loop: flags are written by every op but only read by JNZ/ADC */
+static const uint8_t alu_loop[] = {
+    0x31, 0x00, 0xF0,   // 0000 LXI SP,$F000
+    0x06, 0x00,         // 0003 MVI B,#00
+    0x81,               // 0005 ADD C
+    0x8A,               // 0006 ADC D
+    0x93,               // 0007 SUB E
+    0x2C,               // 0008 INR L
+    0xAC,               // 0009 XRA H
+    0xB1,               // 000A ORA C
+    0xA2,               // 000B ANA D
+    0xBB,               // 000C CMP E
+    0x1C,               // 000D INR E
+    0x15,               // 000E DCR D
+    0x05,               // 000F DCR B
+    0xC2, 0x05, 0x00,   // 0010 JNZ $0005
+    0xC3, 0x03, 0x00    // 0013 JMP $0003
+};
+
+#define BENCH_CYCLES (200000000ULL)
+#define BENCH_REPEATS (5)
+
+int main(void){
+    i8080_state_t *cpu = create_cpu(0);
+    double best = 0;
+
+    if(cpu == NULL){
+        fprintf(stderr, "[ERROR]: Could not intialise CPU\n");
+        return 1;
+    }
+    memcpy(cpu->memory, alu_loop, sizeof(alu_loop));
+#ifdef I8080_DECODE_CACHE
+    if(init_decode_cache(cpu) != I8080_OK){
+        fprintf(stderr, "[ERROR]: Could not allocate decode cache\n");
+        return 1;
+    }
+#endif
+
+    for(int i = 0; i < BENCH_REPEATS; i++){
+        struct timespec start, end;
+        cpu->pc = 0;
+        cpu->cycles = 0;
+        clear_flags(cpu);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while(cpu->cycles < BENCH_CYCLES)
+            run_cycles(cpu, I8080_CYCLES_PER_FRAME);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        double mhz = cpu->cycles / secs / 1e6;
+        if(mhz > best)
+            best = mhz;
+    }
+
+#ifdef I8080_LAZY_FLAGS
+    printf("flags=lazy  ");
+#else
+    printf("flags=eager ");
+#endif
+    printf("best of %d: %.1f emulated MHz (A=%02X F=%02X)\n", BENCH_REPEATS, best, cpu->a, get_flags(cpu));
+
+#ifdef I8080_DECODE_CACHE
+    free_decode_cache(cpu);
+#endif
+    destroy_cpu(cpu);
+    return 0;
+}
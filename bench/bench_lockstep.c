@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/intel8080.h"
+#include "../include/i8080_lockstep.h"
+
+/* Lockstep against scalar execution of the same instances. Every instance
+   runs the same loop on its own input, once with run_cycles() one after the
+   other and once in lockstep groups regrouped by PC after every slice, and
+   one CSV row per core is printed:
+     core,lanes,instances,cycles,seconds,mhz,speedup,utilization
+   utilization is the share of lanes with cycles left that ran each step.
+   Both runs have to end in the same state.
+   Usage: bench_lockstep [-i instances] [-c cycles per instance] [-s slice] */
+
+#define BENCH_INSTANCES (256)
+#define BENCH_CYCLES (2000000ULL)
+#define BENCH_SLICE (33333)
+
+/* A sum and checksum over a table, with a branch taken on the input bits */
+static const uint8_t program[] = {
+    0x31, 0x00, 0xF0,   // 0000 LXI SP,$F000
+    0x21, 0x00, 0x01,   // 0003 LXI H,$0100
+    0x0E, 0x40,         // 0006 MVI C,#40
+    0xAF,               // 0008 XRA A
+    0x86,               // 0009 ADD M
+    0x57,               // 000A MOV D,A
+    0x78,               // 000B MOV A,B
+    0x0F,               // 000C RRC
+    0x47,               // 000D MOV B,A
+    0xD2, 0x15, 0x00,   // 000E JNC $0015
+    0x7A,               // 0011 MOV A,D
+    0xEE, 0x5A,         // 0012 XRI #5A
+    0x57,               // 0014 MOV D,A
+    0x7A,               // 0015 MOV A,D
+    0x23,               // 0016 INX H
+    0x0D,               // 0017 DCR C
+    0xC2, 0x09, 0x00,   // 0018 JNZ $0009
+    0xC5,               // 001B PUSH B
+    0xCD, 0x24, 0x00,   // 001C CALL $0024
+    0xC1,               // 001F POP B
+    0x04,               // 0020 INR B
+    0xC3, 0x03, 0x00,   // 0021 JMP $0003
+    0x83,               // 0024 ADD E
+    0x5F,               // 0025 MOV E,A
+    0xC9                // 0026 RET
+};
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int reset_instances(i8080_arena_t *arena){
+    for(uint32_t i = 0; i < arena->count; i++){
+        i8080_state_t *cpu = arena_cpu(arena, i);
+        memcpy(cpu->memory, program, sizeof(program));
+        for(uint32_t j = 0; j < 0x40; j++){
+            cpu->memory[0x100 + j] = (uint8_t)(j * 37 + 11);
+        }
+        cpu->pc = 0;
+        cpu->cycles = 0;
+        cpu->b = (uint8_t)i; //The input
+        cpu->e = 0;
+        enable_idle_skip(cpu, 0);
+#ifdef I8080_DECODE_CACHE
+        if(init_decode_cache(cpu) != I8080_OK){
+            return I8080_ERROR;
+        }
+#endif
+    }
+    return I8080_OK;
+}
+
+int main(int argc, char **argv){
+    uint32_t instances = BENCH_INSTANCES, slice = BENCH_SLICE, groups;
+    uint64_t cycles = BENCH_CYCLES, total = 0, lane_steps = 0, live_steps = 0;
+    i8080_arena_t *arena, *reference;
+    i8080_lockstep_t *group;
+    double scalar_seconds, lockstep_seconds;
+    uint64_t start;
+
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-i") == 0 && i + 1 < argc){
+            instances = strtoul(argv[++i], NULL, 0);
+        }else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){
+            cycles = strtoull(argv[++i], NULL, 0);
+        }else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc){
+            slice = strtoul(argv[++i], NULL, 0);
+        }else{
+            fprintf(stderr, "[ERROR]: Usage: %s [-i instances] [-c cycles] [-s slice]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(instances == 0 || cycles == 0 || slice == 0){
+        fprintf(stderr, "[ERROR]: Usage: %s [-i instances] [-c cycles] [-s slice]\n", argv[0]);
+        return 1;
+    }
+    groups = (instances + I8080_LOCKSTEP_LANES - 1) / I8080_LOCKSTEP_LANES;
+
+    reference = create_arena(instances, 0);
+    arena = create_arena(instances, 0);
+    group = malloc(groups * sizeof(*group));
+    if(reference == NULL || arena == NULL || group == NULL){
+        return 1;
+    }
+
+    if(reset_instances(reference) != I8080_OK){
+        return 1;
+    }
+    start = now_ns();
+    for(uint32_t i = 0; i < instances; i++){
+        i8080_state_t *cpu = arena_cpu(reference, i);
+        for(uint64_t run = 0; run < cycles; run += slice){
+            run_cycles(cpu, slice);
+        }
+        total += cpu->cycles;
+    }
+    scalar_seconds = (now_ns() - start) / 1e9;
+
+    if(reset_instances(arena) != I8080_OK){
+        return 1;
+    }
+    for(uint32_t g = 0; g < groups; g++){
+        i8080_state_t *cpus[I8080_LOCKSTEP_LANES];
+        uint32_t count = 0;
+        for(uint32_t i = g * I8080_LOCKSTEP_LANES; i < instances && count < I8080_LOCKSTEP_LANES; i++){
+            cpus[count++] = arena_cpu(arena, i);
+        }
+        if(init_lockstep(&group[g], cpus, count) != I8080_OK){
+            return 1;
+        }
+    }
+    start = now_ns();
+    for(uint64_t run = 0; run < cycles; run += slice){
+        for(uint32_t g = 0; g < groups; g++){
+            run_lockstep(&group[g], slice);
+        }
+        regroup_lockstep(group, groups);
+    }
+    lockstep_seconds = (now_ns() - start) / 1e9;
+
+    for(uint32_t i = 0; i < instances; i++){
+        i8080_state_t *x = arena_cpu(reference, i), *y = arena_cpu(arena, i);
+        if(x->pc != y->pc || x->cycles != y->cycles || x->a != y->a || get_flags(x) != get_flags(y) || x->bc != y->bc || x->de != y->de || x->hl != y->hl ||
+           memcmp(x->memory, y->memory, 0x10000) != 0){
+            fprintf(stderr, "[ERROR]: Instance %u differs between the scalar and lockstep runs\n", i);
+            return 1;
+        }
+    }
+    for(uint32_t g = 0; g < groups; g++){
+        lane_steps += group[g].lane_steps;
+        live_steps += group[g].live_steps;
+    }
+
+    printf("core,lanes,instances,cycles,seconds,mhz,speedup,utilization\n");
+    printf("scalar,1,%u,%llu,%.3f,%.1f,1.00,1.00\n", instances, (unsigned long long)total,
+           scalar_seconds, total / scalar_seconds / 1e6);
+    printf("lockstep,%d,%u,%llu,%.3f,%.1f,%.2f,%.2f\n", I8080_LOCKSTEP_LANES, instances, (unsigned long long)total,
+           lockstep_seconds, total / lockstep_seconds / 1e6, scalar_seconds / lockstep_seconds,
+           live_steps ? (double)lane_steps / live_steps : 0.0);
+
+#ifdef I8080_DECODE_CACHE
+    for(uint32_t i = 0; i < instances; i++){
+        free_decode_cache(arena_cpu(arena, i));
+        free_decode_cache(arena_cpu(reference, i));
+    }
+#endif
+    free(group);
+    destroy_arena(arena);
+    destroy_arena(reference);
+    return 0;
+}
@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "../include/intel8080.h"
+
+/* Per-opcode microbenchmarks. Each of the 256 op-codes is placed alone at
+   OPCODE_BASE and run_instruction() is timed over it with the registers, SP
+   and flags taken from a table of random states and memory filled with
+   random bytes, so M operands, stack traffic and condition outcomes vary the
+   way they would in a real program. The PC, registers and code bytes are put
+   back before every instruction, and the same loop around a NOP gives the
+   harness overhead that the net column takes off.
+   Usage: bench_opcodes [-n iterations] [-r rounds] [-o out.csv]
+          bench_opcodes -c a.csv b.csv  (side by side, e.g. two core builds) */
+
+#define OPCODE_BASE (0x0100)
+#define OPCODE_ITERATIONS (200000)
+#define OPCODE_ROUNDS (5)
+#define OPCODE_STATES (4096) //Power of two
+#define OPCODE_SEED (8080)
+
+/* Op-code name with operand placeholders, e.g. "LXI B,d16" */
+static const char *opcode_name(uint8_t op){
+    static char names[256][16];
+    static const char *const operands[] = {"", "d8", "d16", "a16"};
+    const i8080_opcode_t *entry = &i8080_opcode_table[op];
+
+    if(names[op][0] == '\0'){
+        snprintf(names[op], sizeof(names[op]), "%s%s%s%s%s", entry->name,
+                 entry->args[0] || entry->operand ? " " : "", entry->args,
+                 entry->args[0] && entry->operand ? "," : "", operands[entry->operand]);
+    }
+    return names[op];
+}
+
+/* Register state one timed instruction starts from */
+typedef struct bench_regs_t{
+    uint16_t bc, de, hl, sp;
+    uint8_t a, flags;
+}bench_regs_t;
+
+typedef struct bench_result_t{
+    uint8_t op;
+    double ns;  //Best round, ns per instruction including the harness
+    double net; //ns minus the NOP baseline
+}bench_result_t;
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Build options of the core under test, e.g. "threaded+cache" */
+static const char *core_name(void){
+    static char name[64];
+    name[0] = '\0';
+#ifdef I8080_LAZY_FLAGS
+    strcat(name, "+lazy");
+#endif
+#ifdef I8080_THREADED_CORE
+    strcat(name, "+threaded");
+#endif
+#ifdef I8080_DECODE_CACHE
+    strcat(name, "+cache");
+#endif
+#ifdef I8080_FUSION
+    strcat(name, "+fusion");
+#endif
+    return name[0] ? name + 1 : "switch";
+}
+
+/* Best of [rounds] passes of [iterations] lone [op]s, in ns per instruction */
+static double time_opcode(i8080_state_t *cpu, const bench_regs_t *states, uint8_t op,
+                          int iterations, int rounds){
+    uint8_t code[4] = {op, (uint8_t)rand(), (uint8_t)rand(), 0x00}; //NOP after it so nothing fuses
+    double best = 0;
+
+    //The previous op-code's decode is still cached at OPCODE_BASE
+    memcpy(&cpu->memory[OPCODE_BASE], code, sizeof(code));
+    invalidate_range(cpu, OPCODE_BASE, sizeof(code));
+    for(int round = 0; round < rounds; round++){
+        double start = now();
+        double elapsed;
+        for(int i = 0; i < iterations; i++){
+            const bench_regs_t *s = &states[i & (OPCODE_STATES - 1)];
+            //Stores with random addresses can land on the code, the decode cache drops it then
+            memcpy(&cpu->memory[OPCODE_BASE], code, sizeof(code));
+            cpu->pc = OPCODE_BASE;
+            cpu->bc = s->bc;
+            cpu->de = s->de;
+            cpu->hl = s->hl;
+            cpu->sp = s->sp;
+            cpu->a = s->a;
+            clear_flags(cpu);
+            cpu->flags = s->flags;
+            cpu->halted = 0;
+            run_instruction(cpu);
+        }
+        elapsed = (now() - start) * 1e9 / iterations;
+        if(round == 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+static int by_ns(const void *a, const void *b){
+    const bench_result_t *x = a, *y = b;
+    return (x->ns < y->ns) - (x->ns > y->ns);
+}
+
+static int run_opcodes(int iterations, int rounds, const char *csv_filename){
+    i8080_state_t *cpu = create_cpu(0);
+    bench_regs_t *states = calloc(OPCODE_STATES, sizeof(bench_regs_t));
+    bench_result_t results[256];
+    FILE *csv = NULL;
+    double baseline;
+
+    if(cpu == NULL || states == NULL){
+        fprintf(stderr, "[ERROR]: Could not intialise CPU\n");
+        return I8080_ERROR;
+    }
+    if(csv_filename != NULL && (csv = fopen(csv_filename, "w")) == NULL){
+        fprintf(stderr, "[ERROR]: Could not open %s\n", csv_filename);
+        return I8080_ERROR;
+    }
+
+    srand(OPCODE_SEED);
+    for(uint32_t addr = 0; addr < I8080_MAX_MEMORY_SIZE; addr++)
+        cpu->memory[addr] = rand();
+    for(int i = 0; i < OPCODE_STATES; i++){
+        states[i].bc = rand();
+        states[i].de = rand();
+        states[i].hl = rand();
+        states[i].sp = rand();
+        states[i].a = rand();
+        states[i].flags = (rand() & 0xd5) | 0x02; //Only the real flag bits, bit 1 always set
+    }
+    enable_idle_skip(cpu, 0); //Time the jumps, not the skipping
+#ifdef I8080_DECODE_CACHE
+    if(init_decode_cache(cpu) != I8080_OK){
+        fprintf(stderr, "[ERROR]: Could not allocate decode cache\n");
+        return I8080_ERROR;
+    }
+#endif
+
+    for(int op = 0; op < 256; op++){
+        results[op].op = op;
+        results[op].ns = time_opcode(cpu, states, op, iterations, rounds);
+    }
+
+    baseline = results[0x00].ns;
+    for(int op = 0; op < 256; op++)
+        results[op].net = results[op].ns - baseline;
+
+    if(csv != NULL){
+        //Mnemonic last, it holds commas
+        fprintf(csv, "op,core,ns,net_ns,mnemonic\n");
+        for(int op = 0; op < 256; op++){
+            fprintf(csv, "%02X,%s,%.3f,%.3f,%s\n", op, core_name(),
+                    results[op].ns, results[op].net, opcode_name(op));
+        }
+        fclose(csv);
+    }
+
+    qsort(results, 256, sizeof(results[0]), by_ns);
+    printf("Core: %s, best of %d x %d, NOP baseline %.3f ns\n", core_name(), rounds, iterations, baseline);
+    printf("%4s  %-2s  %-10s  %8s  %8s  %6s\n", "rank", "op", "mnemonic", "ns/op", "net", "cycles");
+    for(int i = 0; i < 256; i++){
+        printf("%4d  %02X  %-10s  %8.3f  %8.3f  %6u\n", i + 1, results[i].op, opcode_name(results[i].op),
+               results[i].ns, results[i].net, i8080_cycle_table[results[i].op]);
+    }
+
+#ifdef I8080_DECODE_CACHE
+    free_decode_cache(cpu);
+#endif
+    destroy_cpu(cpu);
+    free(states);
+    return I8080_OK;
+}
+
+/* ns per op-code and the core name from a CSV written with -o */
+static int read_results(const char *filename, double *ns, char *core, size_t core_size){
+    FILE *csv = fopen(filename, "r");
+    char line[256];
+    int count = 0;
+
+    if(csv == NULL){
+        fprintf(stderr, "[ERROR]: Could not open %s\n", filename);
+        return I8080_ERROR;
+    }
+    fgets(line, sizeof(line), csv); //Header
+    while(fgets(line, sizeof(line), csv) != NULL){
+        unsigned op;
+        char build[64];
+        double value, net;
+        if(sscanf(line, "%x,%63[^,],%lf,%lf", &op, build, &value, &net) != 4 || op > 0xff){
+            continue;
+        }
+        ns[op] = value;
+        snprintf(core, core_size, "%s", build);
+        count++;
+    }
+    fclose(csv);
+    if(count != 256){
+        fprintf(stderr, "[ERROR]: %s holds %d op-codes, expected 256\n", filename, count);
+        return I8080_ERROR;
+    }
+    return I8080_OK;
+}
+
+/* Two result files side by side, ranked by how much slower b is than a */
+static int compare_results(const char *file_a, const char *file_b){
+    double ns_a[256], ns_b[256], log_sum = 0;
+    char core_a[64], core_b[64];
+    bench_result_t ratios[256];
+
+    if(read_results(file_a, ns_a, core_a, sizeof(core_a)) != I8080_OK ||
+       read_results(file_b, ns_b, core_b, sizeof(core_b)) != I8080_OK){
+        return I8080_ERROR;
+    }
+    for(int op = 0; op < 256; op++){
+        ratios[op].op = op;
+        ratios[op].ns = ns_a[op] > 0 ? ns_b[op] / ns_a[op] : 0;
+        log_sum += ratios[op].ns > 0 ? log2(ratios[op].ns) : 0;
+    }
+    qsort(ratios, 256, sizeof(ratios[0]), by_ns);
+
+    printf("a: %s (%s)\nb: %s (%s)\n", file_a, core_a, file_b, core_b);
+    printf("%4s  %-2s  %-10s  %8s  %8s  %6s\n", "rank", "op", "mnemonic", "a ns", "b ns", "b/a");
+    for(int i = 0; i < 256; i++){
+        uint8_t op = ratios[i].op;
+        printf("%4d  %02X  %-10s  %8.3f  %8.3f  %6.2f\n", i + 1, op, opcode_name(op),
+               ns_a[op], ns_b[op], ratios[i].ns);
+    }
+    printf("Geometric mean b/a: %.3f\n", exp2(log_sum / 256));
+    return I8080_OK;
+}
+
+int main(int argc, char **argv){
+    int iterations = OPCODE_ITERATIONS;
+    int rounds = OPCODE_ROUNDS;
+    char *csv_filename = NULL;
+
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-c") == 0 && i + 2 < argc){
+            return compare_results(argv[i + 1], argv[i + 2]) == I8080_OK ? 0 : 1;
+        }else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+            iterations = atoi(argv[++i]);
+        }else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc){
+            rounds = atoi(argv[++i]);
+        }else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+            csv_filename = argv[++i];
+        }else{
+            iterations = 0;
+            break;
+        }
+    }
+    if(iterations < 1 || rounds < 1){
+        fprintf(stderr, "[ERROR]: Usage: %s [-n iterations] [-r rounds] [-o out.csv] | -c a.csv b.csv\n", argv[0]);
+        return 1;
+    }
+    return run_opcodes(iterations, rounds, csv_filename) == I8080_OK ? 0 : 1;
+}
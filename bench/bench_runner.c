@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/intel8080.h"
+#include "../include/i8080_runner.h"
+
+/* Multi-instance runner scaling. One arena of instances runs the same loop
+   on 1, 2, 4... up to the core count workers, and one CSV row per worker
+   count is printed:
+     threads,instances,cycles,seconds,mhz,speedup,efficiency,steals
+   Instances stop after a seeded share of the cycle target, so the workers'
+   ranges are uneven and the stealing has to balance them.
+   Usage: bench_runner [-i instances] [-c cycles per instance] [-t max threads] */
+
+#define BENCH_INSTANCES (256)
+#define BENCH_CYCLES (20000000ULL)
+
+/* Nested CALL/RET and an ALU loop */
+static const uint8_t program[] = {
+    0x31, 0x00, 0xF0,   // 0000 LXI SP,$F000
+    0x06, 0x00,         // 0003 MVI B,#00
+    0xCD, 0x0F, 0x00,   // 0005 CALL $000F
+    0x05,               // 0008 DCR B
+    0xC2, 0x05, 0x00,   // 0009 JNZ $0005
+    0xC3, 0x03, 0x00,   // 000C JMP $0003
+    0xC5,               // 000F PUSH B
+    0x81,               // 0010 ADD C
+    0x8A,               // 0011 ADC D
+    0x93,               // 0012 SUB E
+    0x1C,               // 0013 INR E
+    0xC1,               // 0014 POP B
+    0xC9                // 0015 RET
+};
+
+/* Stop each instance once it has run its own cycle quota */
+static int stop_at_quota(i8080_state_t *cpu, uint32_t index, void *ctx){
+    const uint64_t *quota = ctx;
+    return cpu->cycles >= quota[index];
+}
+
+static void reset_instances(i8080_arena_t *arena){
+    for(uint32_t i = 0; i < arena->count; i++){
+        i8080_state_t *cpu = arena_cpu(arena, i);
+        cpu->pc = 0;
+        cpu->cycles = 0;
+    }
+}
+
+int main(int argc, char **argv){
+    uint32_t instances = BENCH_INSTANCES;
+    uint64_t cycles = BENCH_CYCLES;
+    long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    i8080_arena_t *arena;
+    uint64_t *quota;
+    double base_mhz = 0;
+
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-i") == 0 && i + 1 < argc){
+            instances = strtoul(argv[++i], NULL, 0);
+        }else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){
+            cycles = strtoull(argv[++i], NULL, 0);
+        }else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc){
+            max_threads = strtol(argv[++i], NULL, 0);
+        }else{
+            fprintf(stderr, "[ERROR]: Usage: %s [-i instances] [-c cycles] [-t max threads]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(instances == 0 || cycles == 0 || max_threads < 1){
+        fprintf(stderr, "[ERROR]: Usage: %s [-i instances] [-c cycles] [-t max threads]\n", argv[0]);
+        return 1;
+    }
+
+    arena = create_arena(instances, I8080_ARENA_HUGE_PAGES);
+    quota = malloc(instances * sizeof(uint64_t));
+    if(arena == NULL || quota == NULL){
+        return 1;
+    }
+    srand(8080);
+    for(uint32_t i = 0; i < instances; i++){
+        i8080_state_t *cpu = arena_cpu(arena, i);
+        memcpy(cpu->memory, program, sizeof(program));
+        enable_idle_skip(cpu, 0); //Measure the work, not the skipping
+#ifdef I8080_DECODE_CACHE
+        if(init_decode_cache(cpu) != I8080_OK){
+            return 1;
+        }
+#endif
+        quota[i] = cycles / 4 + (uint64_t)rand() % (cycles - cycles / 4 + 1); //A quarter to all of it
+    }
+
+    printf("threads,instances,cycles,seconds,mhz,speedup,efficiency,steals\n");
+    for(long threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads){
+        i8080_runner_t *runner = create_runner(arena, threads);
+        uint64_t total = 0, steals = 0;
+        double seconds, mhz;
+        if(runner == NULL){
+            return 1;
+        }
+        reset_instances(arena);
+        if(run_instances(runner, cycles, 0, stop_at_quota, quota) != I8080_OK){
+            return 1;
+        }
+        for(uint32_t i = 0; i < runner->threads; i++){
+            total += runner->workers[i].cycles;
+            steals += runner->workers[i].steals;
+        }
+        seconds = runner->ns / 1e9;
+        mhz = total / seconds / 1e6;
+        if(threads == 1)
+            base_mhz = mhz;
+        printf("%u,%u,%llu,%.3f,%.1f,%.2f,%.2f,%llu\n", runner->threads, instances, (unsigned long long)total,
+               seconds, mhz, mhz / base_mhz, mhz / base_mhz / runner->threads, (unsigned long long)steals);
+        destroy_runner(runner);
+        if(threads == max_threads)
+            break;
+    }
+
+#ifdef I8080_DECODE_CACHE
+    for(uint32_t i = 0; i < instances; i++){
+        free_decode_cache(arena_cpu(arena, i));
+    }
+#endif
+    free(quota);
+    destroy_arena(arena);
+    return 0;
+}
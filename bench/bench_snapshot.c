@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/intel8080.h"
+
+/* Snapshot restore cost, as a fuzzing loop uses it: restore, run a short
+   burst that dirties a few pages, repeat. The dirty run restores onto the
+   instance the snapshot was taken from, the full run alternates between two
+   instances so every restore copies the whole memory. One CSV row each:
+     mode,restores,ns_per_restore,pages_per_restore
+   Usage: bench_snapshot [-n restores] [-c cycles per burst] */
+
+#define BENCH_RESTORES (200000)
+#define BENCH_CYCLES (2000)
+
+/* Fills a 512 byte buffer at $2000 with a running sum through a CALL */
+static const uint8_t program[] = {
+    0x31, 0x00, 0xF0,   // 0000 LXI SP,$F000
+    0x21, 0x00, 0x20,   // 0003 LXI H,$2000
+    0x01, 0x00, 0x02,   // 0006 LXI B,$0200
+    0xCD, 0x16, 0x00,   // 0009 CALL $0016
+    0x23,               // 000C INX H
+    0x0B,               // 000D DCX B
+    0x78,               // 000E MOV A,B
+    0xB1,               // 000F ORA C
+    0xC2, 0x09, 0x00,   // 0010 JNZ $0009
+    0xC3, 0x03, 0x00,   // 0013 JMP $0003
+    0x83,               // 0016 ADD E
+    0x77,               // 0017 MOV M,A
+    0x5F,               // 0018 MOV E,A
+    0xC9                // 0019 RET
+};
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv){
+    uint32_t restores = BENCH_RESTORES, cycles = BENCH_CYCLES;
+    i8080_state_t *cpu[2];
+    i8080_snapshot_t *snapshot;
+
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+            restores = strtoul(argv[++i], NULL, 0);
+        }else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){
+            cycles = strtoul(argv[++i], NULL, 0);
+        }else{
+            fprintf(stderr, "[ERROR]: Usage: %s [-n restores] [-c cycles]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(restores == 0 || cycles == 0){
+        fprintf(stderr, "[ERROR]: Usage: %s [-n restores] [-c cycles]\n", argv[0]);
+        return 1;
+    }
+
+    cpu[0] = create_cpu(0);
+    cpu[1] = create_cpu(0);
+    snapshot = create_snapshot();
+    if(cpu[0] == NULL || cpu[1] == NULL || snapshot == NULL){
+        return 1;
+    }
+    for(int i = 0; i < 2; i++){
+        memcpy(cpu[i]->memory, program, sizeof(program));
+        enable_idle_skip(cpu[i], 0);
+#ifdef I8080_DECODE_CACHE
+        if(init_decode_cache(cpu[i]) != I8080_OK){
+            return 1;
+        }
+#endif
+    }
+    take_snapshot(cpu[0], snapshot);
+
+    printf("mode,restores,ns_per_restore,pages_per_restore\n");
+    for(int full = 0; full < 2; full++){
+        uint64_t ns = 0, pages = 0;
+        for(uint32_t i = 0; i < restores; i++){
+            i8080_state_t *target = cpu[full ? i & 1 : 0];
+            uint64_t start = now_ns();
+            if(restore_snapshot(target, snapshot) != I8080_OK){
+                return 1;
+            }
+            ns += now_ns() - start;
+            pages += snapshot->pages_copied;
+            run_cycles(target, cycles);
+        }
+        printf("%s,%u,%.1f,%.1f\n", full ? "full" : "dirty", restores, (double)ns / restores,
+               (double)pages / restores);
+    }
+
+    destroy_snapshot(snapshot);
+#ifdef I8080_DECODE_CACHE
+    free_decode_cache(cpu[0]);
+    free_decode_cache(cpu[1]);
+#endif
+    destroy_cpu(cpu[1]);
+    destroy_cpu(cpu[0]);
+    return 0;
+}
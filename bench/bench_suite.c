@@ -0,0 +1,283 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "../include/intel8080.h"
+#include "../include/i8080_jit.h"
+
+/* Headless benchmark suite. Every workload runs for a fixed number of
+   emulated cycles, several times, and one CSV row per workload is printed:
+     workload,core,runs,cycles,instructions,mips,mips_sd,ns_per_instr,ns_per_instr_sd,mhz,mhz_sd
+   Instruction counts come from stepping the same cycles once an instruction
+   at a time, the timed runs go a frame at a time (a JIT build's stream can
+   differ by the block overshoot at event deadlines).
+   Usage: bench_suite [-n runs] [-c cycles] [rom_file] */
+
+#define BENCH_CYCLES (100000000ULL)
+#define BENCH_RUNS (5)
+
+/* ALU ops with flags read back by ADC/JNZ */
+static const uint8_t alu_loop[] = {
+    0x31, 0x00, 0xF0,   // 0000 LXI SP,$F000
+    0x06, 0x00,         // 0003 MVI B,#00
+    0x81,               // 0005 ADD C
+    0x8A,               // 0006 ADC D
+    0x93,               // 0007 SUB E
+    0x2C,               // 0008 INR L
+    0xAC,               // 0009 XRA H
+    0xB1,               // 000A ORA C
+    0xA2,               // 000B ANA D
+    0xBB,               // 000C CMP E
+    0x1C,               // 000D INR E
+    0x15,               // 000E DCR D
+    0x05,               // 000F DCR B
+    0xC2, 0x05, 0x00,   // 0010 JNZ $0005
+    0xC3, 0x03, 0x00    // 0013 JMP $0003
+};
+
+/* Copy 4 KiB from $4000 to $8000, over and over */
+static const uint8_t copy_loop[] = {
+    0x21, 0x00, 0x40,   // 0000 LXI H,$4000
+    0x11, 0x00, 0x80,   // 0003 LXI D,$8000
+    0x06, 0x10,         // 0006 MVI B,#10
+    0x0E, 0x00,         // 0008 MVI C,#00
+    0x7E,               // 000A MOV A,M
+    0x12,               // 000B STAX D
+    0x23,               // 000C INX H
+    0x13,               // 000D INX D
+    0x0D,               // 000E DCR C
+    0xC2, 0x0A, 0x00,   // 000F JNZ $000A
+    0x05,               // 0012 DCR B
+    0xC2, 0x0A, 0x00,   // 0013 JNZ $000A
+    0xC3, 0x00, 0x00    // 0016 JMP $0000
+};
+
+/* Nested CALL/RET with PUSH/POP around the inner call */
+static const uint8_t call_loop[] = {
+    0x31, 0x00, 0xF0,   // 0000 LXI SP,$F000
+    0x06, 0x00,         // 0003 MVI B,#00
+    0xCD, 0x0F, 0x00,   // 0005 CALL $000F
+    0x05,               // 0008 DCR B
+    0xC2, 0x05, 0x00,   // 0009 JNZ $0005
+    0xC3, 0x03, 0x00,   // 000C JMP $0003
+    0xC5,               // 000F PUSH B
+    0xCD, 0x16, 0x00,   // 0010 CALL $0016
+    0xC1,               // 0013 POP B
+    0xC9,               // 0014 RET
+    0x00,               // 0015 NOP
+    0x3C,               // 0016 INR A
+    0xC9                // 0017 RET
+};
+
+typedef struct bench_workload_t{
+    const char *name;
+    const uint8_t *code;
+    size_t size;
+}bench_workload_t;
+
+typedef struct bench_stats_t{
+    double mean;
+    double sd;
+}bench_stats_t;
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bench_stats_t stats(const double *values, int count){
+    bench_stats_t result = {0, 0};
+    for(int i = 0; i < count; i++)
+        result.mean += values[i];
+    result.mean /= count;
+    for(int i = 0; i < count; i++)
+        result.sd += (values[i] - result.mean) * (values[i] - result.mean);
+    result.sd = count > 1 ? sqrt(result.sd / (count - 1)) : 0;
+    return result;
+}
+
+/* Build options of the core under test, e.g. "threaded+cache" */
+static const char *core_name(void){
+    static char name[64];
+    name[0] = '\0';
+#ifdef I8080_LAZY_FLAGS
+    strcat(name, "+lazy");
+#endif
+#ifdef I8080_THREADED_CORE
+    strcat(name, "+threaded");
+#endif
+#ifdef I8080_DECODE_CACHE
+    strcat(name, "+cache");
+#endif
+#ifdef I8080_FUSION
+    strcat(name, "+fusion");
+#endif
+#ifdef I8080_JIT
+    strcat(name, "+jit");
+#endif
+    return name[0] ? name + 1 : "switch";
+}
+
+/* Fresh CPU with the image at $0000, the screen interrupts scheduled for ROMs */
+static i8080_state_t *setup(const uint8_t *image, size_t size, int interrupts){
+    i8080_state_t *cpu = create_cpu(0);
+    if(cpu == NULL){
+        return NULL;
+    }
+    memcpy(cpu->memory, image, size);
+    enable_idle_skip(cpu, 0); //Measure the work, not the skipping
+#ifdef I8080_DECODE_CACHE
+    if(init_decode_cache(cpu) != I8080_OK){
+        destroy_cpu(cpu);
+        return NULL;
+    }
+#endif
+    if(interrupts){
+        schedule_event(cpu, I8080_CYCLES_PER_FRAME / 2, I8080_CYCLES_PER_FRAME, 1, NULL, NULL);
+        schedule_event(cpu, I8080_CYCLES_PER_FRAME, I8080_CYCLES_PER_FRAME, 2, NULL, NULL);
+    }
+    return cpu;
+}
+
+static void teardown(i8080_state_t *cpu){
+#ifdef I8080_JIT
+    jit_free(cpu);
+#endif
+#ifdef I8080_DECODE_CACHE
+    free_decode_cache(cpu);
+#endif
+    destroy_cpu(cpu);
+}
+
+/* Instructions executed from reset to [cycles], stepping one at a time */
+static uint64_t count_instructions(const uint8_t *image, size_t size, int interrupts, uint64_t cycles){
+    i8080_state_t *cpu = setup(image, size, interrupts);
+    uint64_t count = 0;
+    if(cpu == NULL){
+        return 0;
+    }
+    while(cpu->cycles < cycles){
+        uint8_t halted = cpu->halted;
+        //run_cycles() rather than run_instruction() so events fire as in the timed runs
+        run_cycles(cpu, 1);
+        count += !halted;
+    }
+    teardown(cpu);
+    return count;
+}
+
+static int run_workload(const char *name, const uint8_t *image, size_t size, int interrupts,
+                        uint64_t cycles, int runs){
+    double *elapsed = calloc(runs, sizeof(double));
+    double *mips = calloc(runs, sizeof(double));
+    double *ns = calloc(runs, sizeof(double));
+    double *mhz = calloc(runs, sizeof(double));
+    uint64_t reached = 0;
+    uint64_t instructions;
+    bench_stats_t s_mips, s_ns, s_mhz;
+
+    if(elapsed == NULL || mips == NULL || ns == NULL || mhz == NULL){
+        fprintf(stderr, "[ERROR]: Out of memory\n");
+        return I8080_ERROR;
+    }
+    for(int run = 0; run < runs; run++){
+        i8080_state_t *cpu = setup(image, size, interrupts);
+        double start;
+        if(cpu == NULL){
+            fprintf(stderr, "[ERROR]: Could not intialise CPU\n");
+            return I8080_ERROR;
+        }
+#ifdef I8080_JIT
+        if(jit_init(cpu) != I8080_OK){
+            fprintf(stderr, "[ERROR]: JIT not available, timing the interpreter\n");
+        }
+#endif
+        start = now();
+        while(cpu->cycles < cycles){
+#ifdef I8080_JIT
+            run_cycles_jit(cpu, I8080_CYCLES_PER_FRAME);
+#else
+            run_cycles(cpu, I8080_CYCLES_PER_FRAME);
+#endif
+        }
+        elapsed[run] = now() - start;
+        reached = cpu->cycles;
+        mhz[run] = cpu->cycles / elapsed[run] / 1e6;
+        teardown(cpu);
+    }
+
+    instructions = count_instructions(image, size, interrupts, reached);
+    for(int run = 0; run < runs; run++){
+        mips[run] = instructions / elapsed[run] / 1e6;
+        ns[run] = elapsed[run] * 1e9 / instructions;
+    }
+    s_mips = stats(mips, runs);
+    s_ns = stats(ns, runs);
+    s_mhz = stats(mhz, runs);
+    printf("%s,%s,%d,%llu,%llu,%.2f,%.2f,%.3f,%.3f,%.2f,%.2f\n", name, core_name(), runs,
+           (unsigned long long)reached, (unsigned long long)instructions,
+           s_mips.mean, s_mips.sd, s_ns.mean, s_ns.sd, s_mhz.mean, s_mhz.sd);
+    fflush(stdout);
+
+    free(elapsed);
+    free(mips);
+    free(ns);
+    free(mhz);
+    return I8080_OK;
+}
+
+static const bench_workload_t workloads[] = {
+    {"alu", alu_loop, sizeof(alu_loop)},
+    {"copy", copy_loop, sizeof(copy_loop)},
+    {"call", call_loop, sizeof(call_loop)},
+};
+
+int main(int argc, char **argv){
+    uint64_t cycles = BENCH_CYCLES;
+    int runs = BENCH_RUNS;
+    char *rom_filename = NULL;
+
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+            runs = atoi(argv[++i]);
+        }else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){
+            cycles = strtoull(argv[++i], NULL, 0);
+        }else{
+            rom_filename = argv[i];
+        }
+    }
+    if(runs < 1 || cycles == 0){
+        fprintf(stderr, "[ERROR]: Usage: %s [-n runs] [-c cycles] [rom_file]\n", argv[0]);
+        return 1;
+    }
+
+    printf("workload,core,runs,cycles,instructions,mips,mips_sd,ns_per_instr,ns_per_instr_sd,mhz,mhz_sd\n");
+    for(size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++){
+        if(run_workload(workloads[i].name, workloads[i].code, workloads[i].size, 0, cycles, runs) != I8080_OK){
+            return 1;
+        }
+    }
+
+    //Full ROM at $0000 with the mid/end of screen interrupts
+    if(rom_filename != NULL){
+        uint8_t *image = calloc(1, I8080_MAX_MEMORY_SIZE);
+        FILE *rom_file = fopen(rom_filename, "rb");
+        size_t size;
+        if(image == NULL || rom_file == NULL){
+            fprintf(stderr, "[ERROR]: Could not open ROM %s\n", rom_filename);
+            return 1;
+        }
+        size = fread(image, 1, I8080_MAX_MEMORY_SIZE, rom_file);
+        fclose(rom_file);
+        if(run_workload("rom", image, size, 1, cycles, runs) != I8080_OK){
+            return 1;
+        }
+        free(image);
+    }
+    return 0;
+}
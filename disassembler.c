@@ -1,321 +1,243 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 
-int parse_opcode(int pgm_cnt, unsigned char *buf){
-    // Pop first bytes off buffer as op-code
-    int pc = pgm_cnt;
-    unsigned char op = buf[pc];
-    int op_length = 1; //Length of instruction - this is returned to increment program counter
+#include "include/intel8080.h"
+#include "include/i8080_analysis.h"
 
-    // Determine op-code and print info to stdout
-    switch(op){
-        // If op-code length > 1, update this values
-        case 0x00: printf("NOP"); break;
-        case 0x01: printf("LXI  B,#$%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0x02: printf("STAX B"); break;
-        case 0x03: printf("INX  B"); break;
-        case 0x04: printf("INR  B"); break;
-        case 0x05: printf("DCR  B"); break;
-        case 0x06: printf("MVI  B,#%02X", buf[pc+1]); op_length = 2; break;
-        case 0x07: printf("RLC"); break;
-        case 0x08: printf("NOP"); break;
-        case 0x09: printf("DAD  B"); break;
-        case 0x0A: printf("LDAX B"); break;
-        case 0x0B: printf("DCX  B"); break;
-        case 0x0C: printf("INR  C"); break;
-        case 0x0D: printf("DCR  C"); break;
-        case 0x0E: printf("MVI  C,#%02X", buf[pc+1]); op_length = 2; break;
-        case 0x0F: printf("RRC"); break;
-        case 0x10: printf("NOP"); break;
-        case 0x11: printf("LXI  D,#$%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0x12: printf("STAX D"); break;
-        case 0x13: printf("INX  D"); break;
-        case 0x14: printf("INR  D"); break;
-        case 0x15: printf("DCR  D"); break;
-        case 0x16: printf("MVI  D,#%02X", buf[pc+1]); op_length = 2; break;
-        case 0x17: printf("RAL"); break;
-        case 0x18: printf("NOP"); break;
-        case 0x19: printf("DAD  D"); break;
-        case 0x1A: printf("LDAX D"); break;
-        case 0x1B: printf("DCX  D"); break;
-        case 0x1C: printf("INR  E"); break;
-        case 0x1D: printf("DCR  E"); break;
-        case 0x1E: printf("MVI  E,#%02X", buf[pc+1]); op_length = 2; break;
-        case 0x1F: printf("RAR"); break;
-        case 0x20: printf("NOP"); break;
-        case 0x21: printf("LXI  H,#%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0x22: printf("SHLD $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0x23: printf("INX  H"); break;
-        case 0x24: printf("INR  H"); break;
-        case 0x25: printf("DCR  H"); break;
-        case 0x26: printf("MVI  H,#%02X", buf[pc+1]); op_length = 2; break;
-        case 0x27: printf("DAA"); break;
-        case 0x28: printf("NOP"); break;
-        case 0x29: printf("DAD  H"); break;
-        case 0x2A: printf("LHLD $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0x2B: printf("DCX  H"); break;
-        case 0x2C: printf("INR  L"); break;
-        case 0x2D: printf("DCR  L"); break;
-        case 0x2E: printf("MVI  L,#%02X", buf[pc+1]); op_length = 2; break;
-        case 0x2F: printf("CMA"); break;
-        case 0x30: printf("NOP"); break;
-        case 0x31: printf("LXI  SP,#%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0x32: printf("STA  A,$%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0x33: printf("INX  SP"); break;
-        case 0x34: printf("INR  M"); break;
-        case 0x35: printf("DCR  M"); break;
-        case 0x36: printf("MVI  M,#%02X", buf[pc+1]); op_length = 2; break;
-        case 0x37: printf("STC"); break;
-        case 0x38: printf("NOP"); break;
-        case 0x39: printf("DAD  SP"); break;
-        case 0x3A: printf("LDA  $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0x3B: printf("DCX  SP"); break;
-        case 0x3C: printf("INR  A"); break;
-        case 0x3D: printf("DCR  A"); break;
-        case 0x3E: printf("MVI  A,#%02X", buf[pc+1]); op_length = 2; break;
-        case 0x3F: printf("CMC"); break;
-        case 0x40: printf("MOV  B,B"); break;
-        case 0x41: printf("MOV  B,C"); break;
-        case 0x42: printf("MOV  B,D"); break;
-        case 0x43: printf("MOV  B,E"); break;
-        case 0x44: printf("MOV  B,H"); break;
-        case 0x45: printf("MOV  B,L"); break;
-        case 0x46: printf("MOV  B,M"); break;
-        case 0x47: printf("MOV  B,A"); break;
-        case 0x48: printf("MOV  C,B"); break;
-        case 0x49: printf("MOV  C,C"); break;
-        case 0x4A: printf("MOV  C,D"); break;
-        case 0x4B: printf("MOV  C,E"); break;
-        case 0x4C: printf("MOV  C,H"); break;
-        case 0x4D: printf("MOV  C,L"); break;
-        case 0x4E: printf("MOV  C,M"); break;
-        case 0x4F: printf("MOV  C,A"); break;
-        case 0x50: printf("MOV  D,B"); break;
-        case 0x51: printf("MOV  D,C"); break;
-        case 0x52: printf("MOV  D,D"); break;
-        case 0x53: printf("MOV  D,E"); break;
-        case 0x54: printf("MOV  D,H"); break;
-        case 0x55: printf("MOV  D,L"); break;
-        case 0x56: printf("MOV  D,M"); break;
-        case 0x57: printf("MOV  D,A"); break;
-        case 0x58: printf("MOV  E,B"); break;
-        case 0x59: printf("MOV  E,C"); break;
-        case 0x5A: printf("MOV  E,D"); break;
-        case 0x5B: printf("MOV  E,E"); break;
-        case 0x5C: printf("MOV  E,H"); break;
-        case 0x5D: printf("MOV  E,L"); break;
-        case 0x5E: printf("MOV  E,M"); break;
-        case 0x5F: printf("MOV  E,A"); break;
-        case 0x60: printf("MOV  H,B"); break;
-        case 0x61: printf("MOV  H,C"); break;
-        case 0x62: printf("MOV  H,D"); break;
-        case 0x63: printf("MOV  H,E"); break;
-        case 0x64: printf("MOV  H,H"); break;
-        case 0x65: printf("MOV  H,L"); break;
-        case 0x66: printf("MOV  H,M"); break;
-        case 0x67: printf("MOV  H,A"); break;
-        case 0x68: printf("MOV  L,B"); break;
-        case 0x69: printf("MOV  L,C"); break;
-        case 0x6A: printf("MOV  L,D"); break;
-        case 0x6B: printf("MOV  L,E"); break;
-        case 0x6C: printf("MOV  L,H"); break;
-        case 0x6D: printf("MOV  L,L"); break;
-        case 0x6E: printf("MOV  L,M"); break;
-        case 0x6F: printf("MOV  L,A"); break;
-        case 0x70: printf("MOV  M,B"); break;
-        case 0x71: printf("MOV  M,C"); break;
-        case 0x72: printf("MOV  M,D"); break;
-        case 0x73: printf("MOV  M,E"); break;
-        case 0x74: printf("MOV  M,H"); break;
-        case 0x75: printf("MOV  M,L"); break;
-        case 0x76: printf("HLT"); break;
-        case 0x77: printf("MOV  M,A"); break;
-        case 0x78: printf("MOV  A,B"); break;
-        case 0x79: printf("MOV  A,C"); break;
-        case 0x7A: printf("MOV  A,D"); break;
-        case 0x7B: printf("MOV  A,E"); break;
-        case 0x7C: printf("MOV  A,H"); break;
-        case 0x7D: printf("MOV  A,L"); break;
-        case 0x7E: printf("MOV  A,M"); break;
-        case 0x7F: printf("MOV  A,A"); break;
-        case 0x80: printf("ADD  B"); break;
-        case 0x81: printf("ADD  C"); break;
-        case 0x82: printf("ADD  D"); break;
-        case 0x83: printf("ADD  E"); break;
-        case 0x84: printf("ADD  H"); break;
-        case 0x85: printf("ADD  L"); break;
-        case 0x86: printf("ADD  M"); break;
-        case 0x87: printf("ADD  A"); break;
-        case 0x88: printf("ADC  B"); break;
-        case 0x89: printf("ADC  C"); break;
-        case 0x8A: printf("ADC  D"); break;
-        case 0x8B: printf("ADC  E"); break;
-        case 0x8C: printf("ADC  H"); break;
-        case 0x8D: printf("ADC  L"); break;
-        case 0x8E: printf("ADC  M"); break;
-        case 0x8F: printf("ADC  A"); break;
-        case 0x90: printf("SUB  B"); break;
-        case 0x91: printf("SUB  C"); break;
-        case 0x92: printf("SUB  D"); break;
-        case 0x93: printf("SUB  E"); break;
-        case 0x94: printf("SUB  H"); break;
-        case 0x95: printf("SUB  L"); break;
-        case 0x96: printf("SUB  M"); break;
-        case 0x97: printf("SUB  A"); break;
-        case 0x98: printf("SBB  B"); break;
-        case 0x99: printf("SBB  C"); break;
-        case 0x9A: printf("SBB  D"); break;
-        case 0x9B: printf("SBB  E"); break;
-        case 0x9C: printf("SBB  H"); break;
-        case 0x9D: printf("SBB  L"); break;
-        case 0x9E: printf("SBB  M"); break;
-        case 0x9F: printf("SBB  A"); break;
-        case 0xA0: printf("ANA  B"); break;
-        case 0xA1: printf("ANA  C"); break;
-        case 0xA2: printf("ANA  D"); break;
-        case 0xA3: printf("ANA  E"); break;
-        case 0xA4: printf("ANA  H"); break;
-        case 0xA5: printf("ANA  L"); break;
-        case 0xA6: printf("ANA  M"); break;
-        case 0xA7: printf("ANA  A"); break;
-        case 0xA8: printf("XRA  B"); break;
-        case 0xA9: printf("XRA  C"); break;
-        case 0xAA: printf("XRA  D"); break;
-        case 0xAB: printf("XRA  E"); break;
-        case 0xAC: printf("XRA  H"); break;
-        case 0xAD: printf("XRA  L"); break;
-        case 0xAE: printf("XRA  M"); break;
-        case 0xAF: printf("XRA  A"); break;
-        case 0xB0: printf("ORA  B"); break;
-        case 0xB1: printf("ORA  C"); break;
-        case 0xB2: printf("ORA  D"); break;
-        case 0xB3: printf("ORA  E"); break;
-        case 0xB4: printf("ORA  H"); break;
-        case 0xB5: printf("ORA  L"); break;
-        case 0xB6: printf("ORA  M"); break;
-        case 0xB7: printf("ORA  A"); break;
-        case 0xB8: printf("CMP  B"); break;
-        case 0xB9: printf("CMP  C"); break;
-        case 0xBA: printf("CMP  D"); break;
-        case 0xBB: printf("CMP  E"); break;
-        case 0xBC: printf("CMP  H"); break;
-        case 0xBD: printf("CMP  L"); break;
-        case 0xBE: printf("CMP  M"); break;
-        case 0xBF: printf("CMP  A"); break;
-        case 0xC0: printf("RNZ"); break;
-        case 0xC1: printf("POP  B"); break;
-        case 0xC2: printf("JNZ  $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0xC3: printf("JMP  $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0xC4: printf("CNZ  $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0xC5: printf("PUSH  B"); break;
-        case 0xC6: printf("ADI  #%02X", buf[pc+1]); op_length = 2; break;
-        case 0xC7: printf("RST  0"); break;
-        case 0xC8: printf("RZ"); break;
-        case 0xC9: printf("RET"); break;
-        case 0xCA: printf("JZ   $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0xCB: printf("NOP"); break;
-        case 0xCC: printf("CZ   $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0xCD: printf("CALL $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0xCE: printf("ACI  #%02X", buf[pc+1]); op_length = 2; break;
-        case 0xCF: printf("RST  1"); break;
-        case 0xD0: printf("RNC"); break;
-        case 0xD1: printf("POP  D"); break;
-        case 0xD2: printf("JNC  $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0xD3: printf("OUT  #%02X", buf[pc+1]); op_length = 2; break;
-        case 0xD4: printf("CNC  $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0xD5: printf("PUSH D"); break;
-        case 0xD6: printf("SUI  D,#%02X", buf[pc+1]); op_length = 3; break;
-        case 0xD7: printf("RST  2"); break;
-        case 0xD8: printf("RC"); break;
-        case 0xD9: printf("NOP"); break;
-        case 0xDA: printf("JC 	$%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;
-        case 0xDB: printf("IN   #%02X", buf[pc+1]); op_length = 2; break;	
-        case 0xDC: printf("CC   $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;	
-        case 0xDD: printf("NOP"); break;		
-        case 0xDE: printf("SBI  #%02X", buf[pc+1]); op_length = 2; break;
-        case 0xDF: printf("RST  3"); break;	
-        case 0xE0: printf("RPO"); break;	
-        case 0xE1: printf("POP  H");
-        case 0xE2: printf("JPO  $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;	
-        case 0xE3: printf("XTHL"); break;
-        case 0xE4: printf("CPO  $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;	
-        case 0xE5: printf("PUSH H"); break;
-        case 0xE6: printf("ANI  #%02X", buf[pc+1]); op_length = 2; break;
-        case 0xE7: printf("RST  4"); break;	
-        case 0xE8: printf("RPE"); break;
-        case 0xE9: printf("PCHL"); break;	
-        case 0xEA: printf("JPE  $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;	
-        case 0xEB: printf("XCHG"); break;	
-        case 0xEC: printf("CPE  $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;	
-        case 0xED: printf("NOP"); break;
-        case 0xEE: printf("XRI  #%02X", buf[pc+1]); op_length = 2; break;
-        case 0xEF: printf("RST  5"); break;
-        case 0xF0: printf("RP"); break;	
-        case 0xF1: printf("POP  PSW"); break;
-        case 0xF2: printf("JP   $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;	
-        case 0xF3: printf("DI"); break;	
-        case 0xF4: printf("CPO  $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;	
-        case 0xF5: printf("PUSH PSW"); break;
-        case 0xF6: printf("ORI  #%02X", buf[pc+1]); op_length = 2; break;
-        case 0xF7: printf("RST  6"); break;
-        case 0xF8: printf("RM"); break;
-        case 0xF9: printf("SPHL"); break;	
-        case 0xFA: printf("JM   $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;	
-        case 0xFB: printf("EI"); break;	
-        case 0xFC: printf("CM   $%02X%02X", buf[pc+2], buf[pc+1]); op_length = 3; break;	
-        case 0xFD: printf("NOP"); break;
-        case 0xFE: printf("CPI  #%02X", buf[pc+1]); op_length = 2; break;
-        case 0xFF: printf("RST  7"); break;
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define DISASSEMBLER_MMAP
+#endif
 
-        default: break;//printf("0x%X", op); break;
+/* Streaming disassembler. The ROM is mapped rather than read, each line is
+   formatted into a large output buffer with the op-code table shared with the
+   emulator, and the buffer goes out with one write per chunk.
 
+   With -f only code reachable from the reset and RST vectors (or the -e
+   entry points) is disassembled, block starts get L_XXXX labels and the rest
+   comes out as DB lines. -m keeps the code map in a file, reused while it
+   matches the ROM, and -j sets the analysis threads (default: by ROM size).
+
+   Usage: disassembler <rom file> [-f] [-e entry (hex)]... [-m code map] [-j threads] */
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define LINE_MAX_SIZE (10 + I8080_DISASM_TEXT_SIZE) //Address, two spaces, text and newline
+#define LABEL_MAX_SIZE (8)                          //L_XXXX:, newline
+#define DATA_BYTES_PER_LINE (8)
+#define DATA_LINE_MAX_SIZE (15 + DATA_BYTES_PER_LINE * 4) //Address, DB, $XX and a comma or newline per byte
+
+/* ROM image, mapped or read into memory */
+typedef struct rom_image_t{
+    const uint8_t *data;
+    size_t size;
+    int mapped;
+}rom_image_t;
+
+static int open_image(const char *filename, rom_image_t *image){
+#ifdef DISASSEMBLER_MMAP
+    struct stat info;
+    int fd = open(filename, O_RDONLY);
+    if(fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0){
+        void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data != MAP_FAILED){
+            close(fd);
+#ifdef MADV_SEQUENTIAL
+            madvise(data, info.st_size, MADV_SEQUENTIAL);
+#endif
+            image->data = data;
+            image->size = info.st_size;
+            image->mapped = 1;
+            return 0;
+        }
+    }
+    if(fd >= 0){
+        close(fd);
     }
-    printf("\n");
-    return op_length;
+#endif
+    //No mmap (or an empty file or pipe): read the whole file
+    FILE *rom_file = fopen(filename, "rb");
+    uint8_t *data = NULL;
+    size_t capacity = 0, size = 0, got;
+    if(rom_file == NULL){
+        return 1;
+    }
+    do{
+        if(size == capacity){
+            uint8_t *grown = realloc(data, capacity ? capacity * 2 : 65536);
+            if(grown == NULL){
+                free(data);
+                fclose(rom_file);
+                return 1;
+            }
+            data = grown;
+            capacity = capacity ? capacity * 2 : 65536;
+        }
+        got = fread(data + size, 1, capacity - size, rom_file);
+        size += got;
+    }while(got > 0);
+    fclose(rom_file);
+    image->data = data;
+    image->size = size;
+    image->mapped = 0;
+    return 0;
+}
+
+static void close_image(rom_image_t *image){
+#ifdef DISASSEMBLER_MMAP
+    if(image->mapped){
+        munmap((void *)image->data, image->size);
+        return;
+    }
+#endif
+    free((void *)image->data);
+}
+
+static int flush_output(const char *buffer, size_t length){
+    return fwrite(buffer, 1, length, stdout) == length ? 0 : 1;
+}
+
+static char *put_hex(char *out, uint32_t value, int digits){
+    static const char hex_digits[] = "0123456789ABCDEF";
+    for(int shift = (digits - 1) * 4; shift >= 0; shift -= 4){
+        *out++ = hex_digits[(value >> shift) & 0x0f];
+    }
+    return out;
+}
+
+/* Load the code map from map_file if it matches the image, otherwise build
+   it and save it there */
+static int build_code_map(const rom_image_t *image, const uint16_t *entries, uint32_t entry_count,
+                          uint32_t threads, const char *map_file, i8080_code_map_t *map){
+    if(image->size > I8080_MAX_MEMORY_SIZE){
+        fprintf(stderr, "ERROR: Flow mode needs a ROM of at most %d bytes\n", I8080_MAX_MEMORY_SIZE);
+        return 1;
+    }
+    if(map_file != NULL && load_code_map(map, image->data, image->size, map_file) == I8080_OK){
+        return 0;
+    }
+    if(analyze_code(image->data, image->size, entry_count ? entries : NULL, entry_count, threads, map) != I8080_OK){
+        return 1;
+    }
+    if(map_file != NULL){
+        save_code_map(map, map_file);
+    }
+    return 0;
 }
 
 int main(int argc, char **argv){
-    
-    const char *filename;
-    FILE *rom_file;
-    unsigned int rom_size;
-    unsigned char *rom_buffer;
-    int program_counter = 0;
+    const char *filename = NULL;
+    const char *map_file = NULL;
+    uint16_t entries[I8080_MAX_ADDRESS + 1];
+    uint32_t entry_count = 0;
+    uint32_t threads = 0;
+    int flow = 0;
+    i8080_code_map_t *map = NULL;
+    rom_image_t image;
+    char *buffer;
+    size_t used = 0;
+    size_t pc = 0;
 
-    /* Get filename from user CLI Arguments*/
-    if(argc > 1){
-        filename = *(argv+1);
-        printf("ROM File: %s\n", filename);
-    }else{
+    /* Get filename and options from user CLI Arguments*/
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-f") == 0){
+            flow = 1;
+        }else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc){
+            flow = 1;
+            if(entry_count <= I8080_MAX_ADDRESS)
+                entries[entry_count++] = strtol(argv[++i], NULL, 16) & I8080_MAX_ADDRESS;
+        }else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc){
+            flow = 1;
+            map_file = argv[++i];
+        }else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc){
+            threads = strtoul(argv[++i], NULL, 0);
+        }else{
+            filename = argv[i];
+        }
+    }
+    if(filename == NULL){
         fprintf(stderr, "ERROR: No input file provided\n");
         return 1;
     }
-
-    /* Open file handle and get file-size */
-    if((rom_file = fopen(filename, "rb")) == NULL){
-        fprintf(stderr, "ERROR: Could not open input file: %s", filename);
+    if(open_image(filename, &image) != 0){
+        fprintf(stderr, "ERROR: Could not open input file: %s\n", filename);
         return 1;
     }
-    
-    fseek(rom_file, 0, SEEK_END);
-    rom_size = ftell(rom_file);
-    rewind(rom_file);
-    printf("ROM Size: %d bytes\n", rom_size);
-
-    /* Read ROM Contents into buffer */
-    rom_buffer = malloc(rom_size);
-    if(fread((void *)rom_buffer, 1, rom_size, rom_file) != rom_size){
-        fprintf(stderr, "ERROR: Could not read ROM contents into memory\n");
-        free((void *)rom_buffer);
+    if(flow){
+        map = malloc(sizeof(i8080_code_map_t));
+        if(map == NULL || build_code_map(&image, entries, entry_count, threads, map_file, map) != 0){
+            free(map);
+            close_image(&image);
+            return 1;
+        }
+    }
+    buffer = malloc(OUTPUT_BUFFER_SIZE);
+    if(buffer == NULL){
+        fprintf(stderr, "ERROR: Could not allocate output buffer\n");
+        free(map);
+        close_image(&image);
         return 1;
     }
-    
+    setvbuf(stdout, NULL, _IONBF, 0); //Chunks are already buffered here
+    used = snprintf(buffer, OUTPUT_BUFFER_SIZE, "ROM File: %s\nROM Size: %zu bytes\n", filename, image.size);
+    if(map != NULL){
+        used += snprintf(buffer + used, OUTPUT_BUFFER_SIZE - used, "Code Map: %u instructions in %u blocks\n",
+                         map->instructions, map->blocks);
+    }
+
     /* Parse each op-code in file */
-    while(program_counter < rom_size){
-        //Print first part of output line
-        printf("%08X  ", program_counter);
-        program_counter += parse_opcode(program_counter, rom_buffer);
+    while(pc < image.size){
+        char *line;
+        int length;
+        if(OUTPUT_BUFFER_SIZE - used < LABEL_MAX_SIZE + LINE_MAX_SIZE + DATA_LINE_MAX_SIZE){
+            if(flush_output(buffer, used) != 0){
+                fprintf(stderr, "ERROR: Could not write output\n");
+                break;
+            }
+            used = 0;
+        }
+        line = buffer + used;
+        if(map != NULL && CODE_MAP_TEST(map->block, pc) && CODE_MAP_TEST(map->insn, pc)){
+            *line++ = 'L';
+            *line++ = '_';
+            line = put_hex(line, pc, 4);
+            *line++ = ':';
+            *line++ = '\n';
+        }
+        line = put_hex(line, pc, 8);
+        *line++ = ' ';
+        *line++ = ' ';
+        if(map != NULL && !CODE_MAP_TEST(map->insn, pc)){
+            //Unreached bytes, up to the next instruction
+            memcpy(line, "DB   ", 5);
+            line += 5;
+            length = 0;
+            do{
+                if(length > 0)
+                    *line++ = ',';
+                *line++ = '$';
+                line = put_hex(line, image.data[pc + length], 2);
+                length++;
+            }while(length < DATA_BYTES_PER_LINE && pc + length < image.size && !CODE_MAP_TEST(map->insn, pc + length));
+        }else{
+            length = disassemble_instruction(image.data + pc, image.size - pc, line, I8080_DISASM_TEXT_SIZE);
+            line += strlen(line);
+        }
+        *line++ = '\n';
+        used = line - buffer;
+        pc += length;
+    }
+    if(used > 0 && flush_output(buffer, used) != 0){
+        fprintf(stderr, "ERROR: Could not write output\n");
     }
 
+    free(buffer);
+    free(map);
+    close_image(&image);
     return 0;
-}
\ No newline at end of file
+}
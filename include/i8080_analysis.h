@@ -0,0 +1,40 @@
+#ifndef I8080_ANALYSIS_H
+#define I8080_ANALYSIS_H
+
+/* Control-flow analysis of a ROM image. Code is followed from entry points
+   (by default the reset and RST vectors) through JMP/CALL/Jcc/Ccc/RST, and
+   the result is a code/data bitmap plus the basic block starts. A map can be
+   saved next to the ROM and reloaded, it is tied to the image by size and
+   hash, and used to seed the decode cache, the JIT and the recompiler */
+
+#define I8080_CODE_MAP_MAGIC "I8080MAP"
+#define I8080_CODE_MAP_VERSION (1)
+#define I8080_CODE_MAP_BYTES ((I8080_MAX_ADDRESS + 1) / 8)
+#define I8080_ANALYSIS_MAX_THREADS (64)
+#define I8080_ANALYSIS_PARALLEL_SIZE (16 * 1024) //Smaller images are walked on the calling thread
+
+typedef struct i8080_code_map_t{
+    uint32_t size;    //Image size in bytes
+    uint32_t hash;    //FNV-1a of the image
+    uint32_t instructions;
+    uint32_t blocks;
+    uint8_t code[I8080_CODE_MAP_BYTES];  //Bit set for every byte of a reachable instruction
+    uint8_t insn[I8080_CODE_MAP_BYTES];  //Bit set for every instruction start
+    uint8_t block[I8080_CODE_MAP_BYTES]; //Bit set for every basic block start
+}i8080_code_map_t;
+
+#define CODE_MAP_TEST(bits, addr) ((bits)[(uint16_t)(addr) >> 3] & (1 << ((addr) & 7)))
+
+uint32_t image_hash(const uint8_t *image, uint32_t size);
+int analyze_code(const uint8_t *image, uint32_t size, const uint16_t *entries, uint32_t entry_count,
+                 uint32_t threads, i8080_code_map_t *map);
+int save_code_map(const i8080_code_map_t *map, const char *filename);
+int load_code_map(i8080_code_map_t *map, const uint8_t *image, uint32_t size, const char *filename);
+#ifdef I8080_DECODE_CACHE
+void seed_predecode(i8080_state_t *cpu, const i8080_code_map_t *map);
+#endif
+#ifdef I8080_JIT
+void seed_jit(i8080_state_t *cpu, const i8080_code_map_t *map);
+#endif
+
+#endif
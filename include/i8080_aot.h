@@ -0,0 +1,21 @@
+#ifndef I8080_AOT_H
+#define I8080_AOT_H
+
+/* Ahead-of-time recompiled ROM modules. The recompiler tool turns a ROM image
+   into C source with one function per basic block and a table indexed by
+   address; link the compiled module in and run it with run_cycles_aot().
+   The module assumes the ROM area is never written */
+
+/* Runs one block, and keeps looping it while it branches to itself and
+   cpu->cycles is below target. Leaves cpu->pc at the next address */
+typedef void (*i8080_aot_block_t)(i8080_state_t *cpu, uint64_t target);
+
+/* Recompiled ROM */
+typedef struct i8080_aot_module_t{
+    uint32_t size;                   //ROM size in bytes, blocks has this many entries
+    const i8080_aot_block_t *blocks; //Block starting at each address, NULL if none
+}i8080_aot_module_t;
+
+int run_cycles_aot(i8080_state_t *cpu, const i8080_aot_module_t *module, uint32_t budget);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef I8080_JIT_H
+#define I8080_JIT_H
+
+/* Basic-block dynamic recompiler from 8080 to x86-64. Build with -DI8080_JIT,
+   then switch it on per CPU with jit_init()/jit_enable() and run through
+   run_cycles_jit(). On other hosts jit_init() fails and the interpreter is used */
+
+#define I8080_JIT_CODE_SIZE (16 * 1024 * 1024) //Executable buffer for translated blocks
+#define I8080_JIT_MAX_BLOCK_OPS (32)           //Instructions per translated block
+
+/* JIT state attached to a CPU */
+typedef struct i8080_jit_t{
+    uint8_t *code;        //mmap'd executable buffer, starts with the enter/exit stubs
+    uint8_t *code_ptr;    //Next free byte in the buffer
+    uint8_t *code_start;  //First byte after the stubs, the buffer is reset to here on flush
+    uint8_t *block[I8080_MAX_ADDRESS + 1];           //Translated block for each 8080 address
+    uint16_t block_list[I8080_MAX_ADDRESS + 1];      //Start addresses of translated blocks
+    uint32_t block_count;
+    uint8_t code_map[(I8080_MAX_ADDRESS + 1) / 8];   //Bit set for every byte covered by a block
+    uint8_t dirty;        //Set when a store invalidated translated code, blocks exit on it
+    uint8_t enabled;      //Runtime switch, run_cycles_jit() interprets when clear
+    uint8_t verify;       //Re-run every block on the interpreter and compare
+    uint32_t generation;  //Bumped on each flush so stale chain sites are not patched
+    uint64_t blocks_translated;
+    uint64_t chains;      //Block exits patched to jump straight to their successor
+    uint64_t flushes;
+    i8080_state_t *shadow; //Interpreter copy used by verify mode
+}i8080_jit_t;
+
+int jit_init(i8080_state_t *cpu);
+void jit_free(i8080_state_t *cpu);
+void jit_enable(i8080_state_t *cpu, uint8_t enable);
+void jit_flush(i8080_jit_t *jit);
+void jit_invalidate(i8080_state_t *cpu, uint16_t addr);
+int jit_translate(i8080_state_t *cpu, uint16_t addr);
+int run_cycles_jit(i8080_state_t *cpu, uint32_t budget);
+
+/* True if addr is part of a translated block */
+#define JIT_IS_CODE(jit, addr) ((jit)->code_map[(addr) >> 3] & (1 << ((addr) & 7)))
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef I8080_LOCKSTEP_H
+#define I8080_LOCKSTEP_H
+
+/* Experimental lockstep core: up to I8080_LOCKSTEP_LANES CPU instances run
+   the same program with their registers and flags held structure-of-arrays,
+   one vector lane per instance, so every instruction is decoded once and
+   executed for all lanes with GCC vector extensions (SSE/AVX2 with -msse2/
+   -mavx2). Each step issues the lowest PC among the lanes that still have
+   cycles to run, masked to the lanes sitting at that PC with the same op-code,
+   so lanes that branch apart stop issuing until the others reach them again.
+   regroup_lockstep() re-deals instances across groups by PC between runs.
+
+   i8080_state_t stays the real state: run_lockstep() loads the lanes from it
+   and stores them back, and the same scheduler events fire at the same
+   cycles as under run_cycles(). IN/OUT, EI/DI/HLT, RST and DAA are run on
+   the interpreter lane by lane with run_instruction(). Idle skipping and the
+   PROFILE/TRACE/CALL_PROFILE hooks only see those interpreted instructions */
+
+/* Lanes per group. 8 keep PCs and registers in SSE registers, 16 and 32 fill
+   AVX2 ones (build with -mavx2, gcc notes an ABI change otherwise) but the
+   per lane op-code and operand fetches grow with the width */
+#ifndef I8080_LOCKSTEP_LANES
+#define I8080_LOCKSTEP_LANES (8)
+#endif
+#if I8080_LOCKSTEP_LANES != 8 && I8080_LOCKSTEP_LANES != 16 && I8080_LOCKSTEP_LANES != 32
+#error "I8080_LOCKSTEP_LANES must be 8, 16 or 32"
+#endif
+
+typedef uint8_t i8080_lane8_t __attribute__((vector_size(I8080_LOCKSTEP_LANES)));
+typedef uint16_t i8080_lane16_t __attribute__((vector_size(I8080_LOCKSTEP_LANES * 2)));
+typedef uint64_t i8080_lane64_t __attribute__((vector_size(I8080_LOCKSTEP_LANES * 8)));
+
+/* A group of instances run in lockstep */
+typedef struct i8080_lockstep_t{
+    i8080_lane8_t reg[8];   //B C D E H L - A, indexed by the op-code register field (M unused)
+    i8080_lane8_t flags;
+    i8080_lane16_t sp;
+    i8080_lane16_t pc;
+    i8080_lane64_t cycles;
+    i8080_lane64_t target;  //Cycle count each lane may run to before the scheduler is called
+    i8080_state_t *cpu[I8080_LOCKSTEP_LANES]; //NULL for unused lanes
+    uint32_t lanes;         //Lanes in use
+    uint64_t steps;         //Vector steps issued
+    uint64_t lane_steps;    //Lanes that ran an instruction, summed over the steps
+    uint64_t live_steps;    //Lanes that had cycles left to run, summed over the steps
+    uint64_t scalar_steps;  //Steps run on the interpreter lane by lane
+    uint64_t divergent_steps; //Steps that left out a lane with cycles left to run
+}i8080_lockstep_t;
+
+int init_lockstep(i8080_lockstep_t *group, i8080_state_t **cpus, uint32_t count);
+int run_lockstep(i8080_lockstep_t *group, uint32_t budget);
+void regroup_lockstep(i8080_lockstep_t *groups, uint32_t count);
+void display_lockstep_stats(i8080_lockstep_t *group);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef I8080_RUNNER_H
+#define I8080_RUNNER_H
+
+/* Runs every instance of an arena on a pool of worker threads, one per core
+   by default. Each worker starts with a contiguous range of instances and
+   takes them from the front; once it runs out it steals the back half of
+   another worker's range. An instance is stepped in slices until it has run
+   the requested cycles or the slice callback stops it. Results and worker
+   stats are only written by the thread running the instance, so nothing is
+   locked while the CPUs run */
+
+#define I8080_RUNNER_MAX_THREADS (256)
+#define I8080_RUNNER_SLICE (33333) //Default cycles per slice, a 60 Hz frame at 2 MHz
+#define I8080_RUNNER_CACHE_LINE (64)
+
+/* Called after every slice of an instance, non-zero stops it */
+typedef int (*i8080_slice_fn_t)(i8080_state_t *cpu, uint32_t index, void *ctx);
+
+/* Outcome of the last run_instances() for one instance */
+typedef struct i8080_instance_result_t{
+    uint64_t cycles;  //Cycles run
+    uint64_t slices;  //Slices run
+    uint64_t ns;      //Wall time spent running it
+    int status;       //I8080_OK, or I8080_ERROR if the core failed
+    uint32_t worker;  //Worker that ran it
+    uint8_t stopped;  //Stopped by the slice callback before the cycle target
+}i8080_instance_result_t;
+
+/* Per worker state, a cache line of its own so workers never share one */
+typedef struct __attribute__((aligned(I8080_RUNNER_CACHE_LINE))) i8080_runner_worker_t{
+    uint64_t range;      //Instances left to this worker, next in the low and end in the high 32 bits
+    uint64_t instances;  //Instances run in the last run_instances()
+    uint64_t steals;     //Ranges taken from other workers
+    uint64_t cycles;
+    uint64_t ns;         //Time spent running instances
+}i8080_runner_worker_t;
+
+typedef struct i8080_runner_t{
+    i8080_arena_t *arena;
+    uint32_t count;    //Instances, all of the arena
+    uint32_t threads;  //Workers, the calling thread included
+    i8080_runner_worker_t *workers;
+    i8080_instance_result_t *results; //One per instance
+    uint64_t cycles;   //Cycles each instance runs per run_instances()
+    uint32_t slice;
+    i8080_slice_fn_t slice_fn;
+    void *ctx;
+    uint64_t ns;       //Wall time of the last run_instances()
+}i8080_runner_t;
+
+i8080_runner_t *create_runner(i8080_arena_t *arena, uint32_t threads);
+void destroy_runner(i8080_runner_t *runner);
+int run_instances(i8080_runner_t *runner, uint64_t cycles, uint32_t slice, i8080_slice_fn_t slice_fn, void *ctx);
+void display_runner_stats(i8080_runner_t *runner);
+
+#endif
@@ -3,45 +3,379 @@
 
 #define I8080_ADDRESS_BUS_SIZE (16)
 #define I8080_MAX_ADDRESS (0xFFFF)
-#define I8080_MAX_MEMORY_SIZE (I8080_MAX_ADDRESS) 
+#define I8080_MAX_MEMORY_SIZE (I8080_MAX_ADDRESS + 1) //Full 64 KiB address space
+#define I8080_MEMORY_GUARD (64) //Zeroed bytes after memory, operand reads at 0xFFFF stay in bounds
+
+#define I8080_CLOCK_HZ (2000000)
+#define I8080_CYCLES_PER_FRAME (I8080_CLOCK_HZ / 60) //One 60Hz video frame
+#define I8080_COND_TAKEN_CYCLES (6) //Extra cycles of a conditional CALL/RET that branches
 
 #define I8080_OK (0)
 #define I8080_ERROR (1)
 
+/* Condition bit positions within the packed PSW flags byte: S Z 0 AC 0 P 1 C */
+enum{
+    FLAG_C =  0x01, //Carry
+    FLAG_P =  0x04, //Parity
+    FLAG_AC = 0x10, //Auxillary Carry
+    FLAG_Z =  0x40, //Zero
+    FLAG_S =  0x80, //Sign
+    FLAG_ALL = 0xd5
+};
+
+#define I8080_FLAGS_DEFAULT (0x02) //Bit 1 of the PSW always reads as 1
+
+#ifdef I8080_LAZY_FLAGS
+/* Kinds of ALU op whose flags are still pending in lazy flag mode */
+enum{
+    LAZY_NONE = 0, //flags byte is up to date
+    LAZY_ADD,
+    LAZY_SUB,
+    LAZY_AND,
+    LAZY_LOGIC, //XOR/OR, AC and CY are cleared
+    LAZY_INR,
+    LAZY_DCR
+};
+
+/* Last ALU op, flags are only computed from it when they are read */
+typedef struct i8080_lazy_flags_t{
+    uint8_t op;      //LAZY_ kind
+    uint8_t a;       //First operand
+    uint8_t b;       //Second operand
+    uint16_t result; //Bit 8 holds the carry out
+}i8080_lazy_flags_t;
+#endif
+
+#if defined(I8080_FUSION) && !defined(I8080_DECODE_CACHE)
+#error "I8080_FUSION works on the decode cache, build with I8080_DECODE_CACHE"
+#endif
+
+#ifdef I8080_FUSION
+/* Instruction pairs run by a single handler. The core dispatches fused pair
+   [kind] as op-code I8080_FUSE_BASE + kind */
 enum{
-    FLAG_C =  0x1,
-    FLAG_AC = 0x2,
-    FLAG_S =  0x4,
-    FLAG_P =  0x8,
-    FLAG_Z =  0x10,
-    FLAG_ALL = 0xff
+    FUSE_NONE = 0,
+    FUSE_DCR_B_JNZ, //DCR r + JNZ addr
+    FUSE_DCR_C_JNZ,
+    FUSE_DCR_D_JNZ,
+    FUSE_DCR_E_JNZ,
+    FUSE_DCR_H_JNZ,
+    FUSE_DCR_L_JNZ,
+    FUSE_DCR_A_JNZ,
+    FUSE_INX_H_MOV_B_M, //INX H + MOV r,M
+    FUSE_INX_H_MOV_C_M,
+    FUSE_INX_H_MOV_D_M,
+    FUSE_INX_H_MOV_E_M,
+    FUSE_INX_H_MOV_H_M,
+    FUSE_INX_H_MOV_L_M,
+    FUSE_INX_H_MOV_A_M,
+    FUSE_LDAX_B_MOV_M_A, //LDAX rp + MOV M,A
+    FUSE_LDAX_D_MOV_M_A,
+    FUSE_CPI_JZ, //CPI D8 + JZ/JNZ addr
+    FUSE_CPI_JNZ,
+    I8080_FUSE_COUNT
 };
 
-/* Bitfield struct to represent CPU condition bits */
-typedef struct i8080_flags_t{
-    uint8_t c:1;    //Carry
-    uint8_t ac:1;   //Auxillary Carry
-    uint8_t s:1;    //Sign
-    uint8_t p:1;    //Parity
-    uint8_t z:1;    //Zero
-    uint8_t  :3;    //--- Padding to 8-bits ---
-}i8080_flags_t;
+#define I8080_FUSE_BASE (0xFF)
+#define I8080_FUSE_MAX_BYTES (5) //Longest fused pair, CPI + JZ
+
+extern const char *const i8080_fuse_names[I8080_FUSE_COUNT];
+#endif
+
+#ifdef I8080_DECODE_CACHE
+/* Pre-decoded instruction, one entry per address */
+typedef struct i8080_decoded_t{
+    uint8_t op;     //Op-code, selects the handler
+    uint8_t length; //Instruction length in bytes, 0 if the entry must be decoded again
+    uint16_t imm;   //Operand bytes merged as (byte 3 << 8 | byte 2)
+#ifdef I8080_FUSION
+    uint8_t fused;      //FUSE_ kind of this instruction and the next one
+    uint16_t fused_imm; //Operand of the second instruction of the pair
+#endif
+}i8080_decoded_t;
+#endif
+
+struct i8080_jit_t;
+
+/* Memory bus: the address space is split into 256 pages of 256 bytes. RAM and
+   ROM pages point straight at host memory, MMIO pages call handlers */
+#define I8080_PAGE_SHIFT (8)
+#define I8080_PAGE_SIZE (1 << I8080_PAGE_SHIFT)
+#define I8080_PAGE_COUNT (I8080_MAX_MEMORY_SIZE / I8080_PAGE_SIZE)
+
+enum{
+    I8080_PAGE_RAM = 0, //Read and written directly
+    I8080_PAGE_ROM,     //Read directly, stores are dropped
+    I8080_PAGE_MIRROR,  //Reads and writes another page's bytes
+    I8080_PAGE_MMIO     //Every access calls the page's handlers
+};
+
+typedef uint8_t (*i8080_mmio_read_t)(void *ctx, uint16_t addr);
+typedef void (*i8080_mmio_write_t)(void *ctx, uint16_t addr, uint8_t value);
+
+/* Page table, indexed by address >> I8080_PAGE_SHIFT */
+typedef struct i8080_memory_map_t{
+    uint8_t *read[I8080_PAGE_COUNT];  //Host bytes backing the page, NULL for MMIO
+    uint8_t *write[I8080_PAGE_COUNT]; //Host bytes stores go to, NULL where a store needs the slow path
+    uint8_t kind[I8080_PAGE_COUNT];   //I8080_PAGE_ kind
+    uint8_t alias[I8080_PAGE_COUNT];  //Page a mirror reflects
+    i8080_mmio_read_t mmio_read[I8080_PAGE_COUNT];
+    i8080_mmio_write_t mmio_write[I8080_PAGE_COUNT];
+    void *mmio_ctx[I8080_PAGE_COUNT];
+}i8080_memory_map_t;
+
+/* I/O ports: IN and OUT dispatch through a 256 entry table of handlers */
+#define I8080_PORT_COUNT (256)
+#define I8080_PORT_LOG_SIZE (1024) //Buffered OUTs held per frame before an early flush
+
+#define I8080_PORT_BUFFERED (0x01) //OUTs are logged and replayed by flush_port_log()
+
+typedef uint8_t (*i8080_port_read_t)(void *ctx, uint8_t port);
+typedef void (*i8080_port_write_t)(void *ctx, uint8_t port, uint8_t value);
+
+typedef struct i8080_port_t{
+    i8080_port_read_t read;   //NULL reads 0xFF
+    i8080_port_write_t write; //NULL drops the OUT
+    void *ctx;
+    uint32_t flags;           //I8080_PORT_ flags
+}i8080_port_t;
+
+/* One buffered OUT */
+typedef struct i8080_port_write_entry_t{
+    uint64_t cycles; //CPU cycle count when the OUT ran
+    uint8_t port;
+    uint8_t value;
+}i8080_port_write_entry_t;
+
+typedef struct i8080_io_t{
+    i8080_port_t ports[I8080_PORT_COUNT];
+    i8080_port_write_entry_t log[I8080_PORT_LOG_SIZE]; //Buffered OUTs in execution order
+    uint32_t log_count;
+    uint64_t log_overflows; //Early flushes because the log filled up within a frame
+}i8080_io_t;
+
+/* Event scheduler: a min-heap of events keyed on cpu->cycles. run_cycles()
+   stops at the next deadline, raises the event's interrupt and/or calls its
+   handler, and skips straight there while the CPU is halted */
+#define I8080_MAX_EVENTS (16)
+#define I8080_NO_RST (0xFF) //Event raises no interrupt
+#define I8080_RST_CYCLES (11) //Cost of an RST, also charged for an accepted interrupt
+
+struct i8080_state_t;
+typedef void (*i8080_event_fn_t)(struct i8080_state_t *cpu, void *ctx);
+
+typedef struct i8080_event_t{
+    uint64_t deadline;   //cpu->cycles value the event fires at
+    uint32_t period;     //Re-armed this many cycles after its deadline, 0 fires once
+    uint32_t id;         //Handle for cancel_event(), also orders events with equal deadlines
+    uint8_t rst;         //RST number (0-7) to raise, or I8080_NO_RST
+    i8080_event_fn_t fn; //Called when the event fires, may be NULL
+    void *ctx;
+}i8080_event_t;
+
+typedef struct i8080_scheduler_t{
+    i8080_event_t heap[I8080_MAX_EVENTS];
+    uint32_t count;
+    uint32_t next_id;
+    uint64_t fired;         //Events fired
+    uint64_t halted_cycles; //Cycles skipped while halted
+}i8080_scheduler_t;
+
+/* Idle-loop skipping: a short backward jump whose loop cannot store, OUT or
+   touch the stack, and which comes back round to the exact same registers,
+   flags and SP, will spin identically until an event fires. run_cycles()
+   adds whole iterations' worth of cycles instead of running them */
+#define I8080_IDLE_MAX_LOOP (16)  //Longest loop considered, head to end of the jump, in bytes
+#define I8080_IDLE_CACHE_SIZE (64) //Loops remembered as not idle
+#define I8080_IDLE_MAX_MISSES (2)  //Iterations with changing state before a loop is ignored
+
+typedef struct i8080_idle_t{
+    uint8_t enabled;   //Runtime switch, on by default, off to step every iteration
+    uint8_t valid;     //A snapshot of the loop at head is held
+    uint16_t head;     //Loop head the snapshot was taken at
+    uint16_t from;     //Address after the jump that closed the loop
+    uint16_t bc, de, hl, sp;
+    uint8_t a, flags;
+    uint64_t cycles;   //cpu->cycles at the snapshot
+    uint16_t miss_from[I8080_IDLE_CACHE_SIZE]; //Direct mapped by the closing jump
+    uint8_t misses[I8080_IDLE_CACHE_SIZE];
+    uint64_t fast_forwards; //Times a loop was skipped
+    uint64_t skipped_cycles;
+}i8080_idle_t;
+
+#ifdef I8080_PROFILE
+/* Instrumentation build: every interpreted instruction bumps its op-code and
+   PC counters unconditionally. Taken conditional CALL/RET extra cycles are
+   charged to the op-code that was fetched last. The JIT and AOT paths are not
+   counted */
+typedef struct i8080_profile_t{
+    uint64_t op_count[256];  //Executions per op-code
+    uint64_t op_cycles[256]; //Cycles charged per op-code
+    uint64_t pc_count[I8080_MAX_MEMORY_SIZE]; //Instructions fetched per address
+    uint8_t last_op;         //Op-code fetched last
+}i8080_profile_t;
+#endif
+
+#ifdef I8080_CALL_PROFILE
+/* Guest call-stack profiler: CALL/Ccc/RST push a frame on a shadow stack and
+   RET/Rcc pop frames by SP, so stacks reset or unwound by hand resync. Cycles
+   go to the node of the current call path, written as collapsed stacks for
+   flamegraph tools */
+#define I8080_CALL_MAX_DEPTH (256)    //Deeper calls are charged to the deepest frame
+#define I8080_CALL_MAX_NODES (1 << 16) //Default size of the call path tree
+
+typedef struct i8080_call_node_t{
+    uint16_t addr;    //Subroutine entry point
+    uint32_t parent;  //Node of the caller, the root is its own parent
+    uint32_t child;   //First callee, 0 if none
+    uint32_t sibling; //Next callee of the same parent, 0 if none
+    uint64_t calls;   //Times the path was entered
+    uint64_t cycles;  //Cycles spent in the subroutine itself on this path
+}i8080_call_node_t;
+
+typedef struct i8080_call_frame_t{
+    uint32_t node;
+    uint16_t sp; //SP after the return address was pushed
+}i8080_call_frame_t;
+
+typedef struct i8080_call_profile_t{
+    i8080_call_node_t *nodes; //Node 0 is the root, the code running when profiling started
+    uint32_t node_count;
+    uint32_t max_nodes;
+    i8080_call_frame_t stack[I8080_CALL_MAX_DEPTH];
+    uint32_t depth;
+    uint32_t current;         //Node cycles are charged to
+    uint64_t last_cycles;     //cpu->cycles when current was last charged
+    uint64_t dropped;         //Calls not tracked because the tree or stack was full
+    char **symbols;           //Names by address, NULL until load_symbols()
+}i8080_call_profile_t;
+#endif
+
+#ifdef I8080_TRACE
+/* Execution trace: one fixed-size record per interpreted instruction, taken
+   before it runs, into a ring that keeps the most recent ones. Dumped with
+   write_trace() and turned into text by trace_decoder */
+#define I8080_TRACE_SIZE (1 << 16)  //Default ring size in records, a power of two
+#define I8080_TRACE_MAGIC "I8080TRC"
+#define I8080_TRACE_VERSION (1)
+
+typedef struct i8080_trace_record_t{
+    uint64_t cycles; //cpu->cycles with the instruction's cycles charged
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t bc, de, hl;
+    uint16_t psw;    //A << 8 | flags
+    uint16_t imm;    //Operand bytes 2 and 3
+    uint8_t op;
+    uint8_t pad;
+}i8080_trace_record_t;
+
+typedef struct i8080_trace_t{
+    i8080_trace_record_t *records;
+    uint32_t mask;  //Ring size - 1
+    uint64_t count; //Records written since start_trace(), the ring holds the last mask + 1
+}i8080_trace_t;
+
+/* Header of a trace file, records follow oldest first */
+typedef struct i8080_trace_header_t{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t records; //Records in the file
+    uint64_t total;   //Instructions traced, earlier ones were overwritten in the ring
+}i8080_trace_header_t;
+#endif
+
+/* Snapshots: registers, interrupt state, pending events and a copy of the
+   64 KiB memory. Every store sets its page's bit in cpu->dirty, so taking or
+   restoring a snapshot that was last synced with the same CPU only copies
+   the pages written since. Any other pairing copies the whole memory */
+#define I8080_DIRTY_WORDS (I8080_PAGE_COUNT / 64)
+
+typedef struct i8080_snapshot_t{
+    uint16_t bc, de, hl, psw, sp, pc;
+    uint8_t int_enable;
+    uint8_t int_request;
+    uint8_t halted;
+    uint64_t cycles;
+    i8080_scheduler_t sched;
+    const struct i8080_state_t *cpu; //Instance the memory copy was last synced with, NULL before the first
+    uint64_t sync;                   //That instance's sync count at the time
+    uint32_t pages_copied;           //Pages copied by the last take or restore
+    uint8_t memory[I8080_MAX_MEMORY_SIZE];
+}i8080_snapshot_t;
+
+/* Save state files: a header naming the ROM they were made against, then
+   tagged sections (registers, events, host device state, memory) and a hash
+   of everything before it. Memory is XORed with the loaded ROM image (zeros
+   past its end) and run-length coded, so it costs little beyond the bytes
+   that differ. Sections a reader does not know are skipped */
+#define I8080_STATE_MAGIC "I8080SAV"
+#define I8080_STATE_VERSION (1)
+
+#define I8080_ARENA_HUGE_PAGES (0x01) //Back the arena with huge pages when the host allows it
+
+/* One mapping holding [count] CPU instances. Each slot is page aligned and
+   holds the 64 KiB address space, the guard bytes and then the CPU state */
+typedef struct i8080_arena_t{
+    uint8_t *base;     //Start of the mapping
+    size_t size;       //Bytes mapped
+    size_t slot_size;  //Bytes per instance, a multiple of the page size
+    uint32_t count;    //Instances in the arena
+    uint8_t huge;      //Mapped with huge pages
+}i8080_arena_t;
+
+/* Register pair [hi][lo] overlaid on a 16-bit value in host byte order, so
+   both the single registers and the pair can be used directly */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define I8080_PAIR(hi, lo, pair) union{ struct{ uint8_t hi; uint8_t lo; }; uint16_t pair; }
+#else
+#define I8080_PAIR(hi, lo, pair) union{ struct{ uint8_t lo; uint8_t hi; }; uint16_t pair; }
+#endif
 
 /* High-level CPU state struct */
 typedef struct i8080_state_t{
-    uint8_t a; //Registers
-    uint8_t b;
-    uint8_t c;
-    uint8_t d;
-    uint8_t e;
-    uint8_t h;
-    uint8_t l;
+    I8080_PAIR(b, c, bc); //Registers, each pair also readable as one 16-bit value
+    I8080_PAIR(d, e, de);
+    I8080_PAIR(h, l, hl);
+    I8080_PAIR(a, flags, psw); //flags is the state/condition flags, packed as the PSW byte
     uint16_t sp; //Stack pointer
     uint16_t pc; //Program counter
-    uint8_t *memory; //CPU memory (RAM)
-    uint16_t loaded_rom_size;
+    uint8_t *memory; //CPU memory (RAM), pages map onto it unless remapped
+    i8080_memory_map_t map; //Page table all CPU accesses go through
+    i8080_io_t io; //I/O port handlers and the buffered OUT log
+    uint32_t loaded_rom_size;
+    uint8_t *rom_image; //Copy of what load_rom() put at 0, the base save states are stored against
     uint8_t int_enable; //Interrupt enable
-    i8080_flags_t flags; //State/Condition flags
+    uint8_t int_request; //RST op-code of an interrupt waiting for EI, 0 when none
+    uint8_t halted; //Set by HLT until an interrupt is accepted
+    i8080_scheduler_t sched; //Pending timed events
+    i8080_idle_t idle; //Idle-loop detection state and stats
+    uint64_t dirty[I8080_DIRTY_WORDS]; //Pages stored to since the last snapshot sync, a bit each
+    uint64_t sync; //Snapshot syncs so far, pairs dirty with the snapshot it is relative to
+#ifdef I8080_PROFILE
+    i8080_profile_t profile; //Execution counters of the instrumentation build
+#endif
+#ifdef I8080_TRACE
+    i8080_trace_t *trace; //Execution trace ring, NULL when not tracing
+#endif
+#ifdef I8080_CALL_PROFILE
+    i8080_call_profile_t *call_profile; //Shadow call stack, NULL when not profiling
+#endif
+#ifdef I8080_LAZY_FLAGS
+    i8080_lazy_flags_t lazy; //Pending flags, cpu->flags is stale unless lazy.op == LAZY_NONE
+#endif
+    uint64_t cycles; //Clock cycles executed since reset
+#ifdef I8080_DECODE_CACHE
+    i8080_decoded_t *decode_cache; //Indexed by address, invalidated by stores
+#endif
+#ifdef I8080_FUSION
+    uint64_t fusion_hits[I8080_FUSE_COUNT]; //Times each fused pair ran
+#endif
+#ifdef I8080_JIT
+    struct i8080_jit_t *jit; //Translated code, NULL when the JIT is not in use
+#endif
+    i8080_arena_t *arena; //Arena this instance lives in
 }i8080_state_t;
 
 // /* ROM data */
@@ -51,18 +385,108 @@ typedef struct i8080_state_t{
 //     unsigned char *data;
 // }i8080_rom_t;
 
+/* Offset in i8080_state_t of each register by its 3-bit op-code field:
+   B C D E H L M A. M (6) is the memory at HL and its entry is unused */
+extern const uint8_t i8080_reg_offset[8];
+#define I8080_REG(cpu, index) (((uint8_t *)(cpu))[i8080_reg_offset[index]])
+
+/* Op-code tables */
+enum{
+    I8080_OPERAND_NONE,
+    I8080_OPERAND_D8,  //Immediate byte or port, printed #$12
+    I8080_OPERAND_D16, //Immediate word, printed #$1234
+    I8080_OPERAND_A16  //Address, printed $1234
+};
+
+typedef struct i8080_opcode_t{
+    const char *name;  //Mnemonic, e.g. "MOV"
+    const char *args;  //Fixed arguments before any operand, e.g. "B,C", or ""
+    uint8_t operand;   //I8080_OPERAND_ kind of the bytes after the op-code
+}i8080_opcode_t;
+
+#define I8080_DISASM_TEXT_SIZE (32) //Room disassemble_instruction() needs, NUL included
+
+extern const uint8_t i8080_cycle_table[256];  //Cycles, not-taken cost for conditional CALL/RET
+extern const uint8_t i8080_length_table[256]; //Instruction length in bytes
+extern const i8080_opcode_t i8080_opcode_table[256];
+
+int disassemble_instruction(const uint8_t *code, size_t available, char *text, size_t text_size);
+
 /* System Function Prototypes */ 
+i8080_state_t *create_cpu(uint32_t flags);
+void destroy_cpu(i8080_state_t *cpu);
+i8080_arena_t *create_arena(uint32_t count, uint32_t flags);
+i8080_state_t *arena_cpu(i8080_arena_t *arena, uint32_t index);
+void destroy_arena(i8080_arena_t *arena);
 int load_rom(i8080_state_t *cpu, char *rom_filename);
 int run_instruction(i8080_state_t *cpu);
-void check_flags(i8080_state_t *cpu, uint16_t result, uint8_t mask);
+int run_cycles(i8080_state_t *cpu, uint32_t budget);
+void write_memory(i8080_state_t *cpu, uint16_t addr, uint8_t value);
+uint8_t read_memory(i8080_state_t *cpu, uint16_t addr);
+void reset_memory_map(i8080_state_t *cpu);
+void clone_memory_map(i8080_state_t *dst, const i8080_state_t *src);
+int map_ram(i8080_state_t *cpu, uint16_t start, uint32_t length);
+int map_rom(i8080_state_t *cpu, uint16_t start, uint32_t length);
+int map_mirror(i8080_state_t *cpu, uint16_t start, uint32_t length, uint16_t source);
+int map_mmio(i8080_state_t *cpu, uint16_t start, uint32_t length,
+             i8080_mmio_read_t read, i8080_mmio_write_t write, void *ctx);
+int map_port(i8080_state_t *cpu, uint8_t port, i8080_port_read_t read, i8080_port_write_t write,
+             void *ctx, uint32_t flags);
+void reset_ports(i8080_state_t *cpu);
+void flush_port_log(i8080_state_t *cpu);
+uint8_t port_in(i8080_state_t *cpu, uint8_t port);
+void port_out(i8080_state_t *cpu, uint8_t port, uint8_t value);
+int schedule_event(i8080_state_t *cpu, uint64_t deadline, uint32_t period, uint8_t rst,
+                   i8080_event_fn_t fn, void *ctx);
+int cancel_event(i8080_state_t *cpu, int id);
+void clear_events(i8080_state_t *cpu);
+uint64_t schedule_slice(i8080_state_t *cpu, uint64_t end);
+void interrupt(i8080_state_t *cpu, uint8_t rst);
+void enable_idle_skip(i8080_state_t *cpu, uint8_t enable);
+void idle_check(i8080_state_t *cpu, uint16_t from, uint64_t target);
+void display_idle_stats(i8080_state_t *cpu);
 void display_flags(i8080_state_t *cpu);
+uint8_t get_flags(i8080_state_t *cpu);
+void invalidate_range(i8080_state_t *cpu, uint16_t start, uint32_t length);
+i8080_snapshot_t *create_snapshot(void);
+void destroy_snapshot(i8080_snapshot_t *snapshot);
+void take_snapshot(i8080_state_t *cpu, i8080_snapshot_t *snapshot);
+int restore_snapshot(i8080_state_t *cpu, i8080_snapshot_t *snapshot);
+int save_state(i8080_state_t *cpu, const char *filename, const void *device, uint32_t device_size);
+int load_state(i8080_state_t *cpu, const char *filename, void *device, uint32_t *device_size);
+#ifdef I8080_DECODE_CACHE
+int init_decode_cache(i8080_state_t *cpu);
+void free_decode_cache(i8080_state_t *cpu);
+void predecode_range(i8080_state_t *cpu, uint16_t start, uint32_t length);
+#endif
+#ifdef I8080_FUSION
+void display_fusion_stats(i8080_state_t *cpu);
+#endif
+#ifdef I8080_PROFILE
+void reset_profile(i8080_state_t *cpu);
+void display_profile(i8080_state_t *cpu, uint32_t top);
+#endif
+#ifdef I8080_TRACE
+int start_trace(i8080_state_t *cpu, uint32_t size);
+void stop_trace(i8080_state_t *cpu);
+int write_trace(i8080_state_t *cpu, const char *filename);
+#endif
+#ifdef I8080_CALL_PROFILE
+int start_call_profile(i8080_state_t *cpu, uint32_t max_nodes);
+void stop_call_profile(i8080_state_t *cpu);
+int load_symbols(i8080_state_t *cpu, const char *filename);
+int write_call_profile(i8080_state_t *cpu, const char *filename);
+void call_profile_enter(i8080_state_t *cpu);
+void call_profile_leave(i8080_state_t *cpu);
+#endif
+#ifdef I8080_LAZY_FLAGS
+void materialize_flags(i8080_state_t *cpu);
+#endif
 void clear_flags(i8080_state_t *cpu);
 
 /* Generic CPU Instruction functions */
 void inr(i8080_state_t *cpu, uint8_t *reg);
-void inx(uint8_t *reg_hi, uint8_t *reg_lo);
 void dcr(i8080_state_t *cpu, uint8_t *reg);
-void dcx(uint8_t *reg_hi, uint8_t *reg_lo);
 void mvi(uint8_t *reg, uint8_t value);
 void ldax(i8080_state_t *cpu, uint8_t *reg, uint16_t addr);
 void add(i8080_state_t *cpu, uint8_t *reg);
@@ -73,11 +497,15 @@ void ana(i8080_state_t *cpu, uint8_t *reg);
 void xra(i8080_state_t *cpu, uint8_t *reg);
 void ora(i8080_state_t *cpu, uint8_t *reg);
 void cmp(i8080_state_t *cpu, uint8_t *reg);
+void daa(i8080_state_t *cpu);
 void ret(i8080_state_t *cpu);
-void pop(i8080_state_t *cpu, uint8_t *reg_hi, uint8_t *reg_lo);
+uint16_t pop(i8080_state_t *cpu);
 void jmp(i8080_state_t *cpu, uint16_t addr);
 void call(i8080_state_t *cpu, uint16_t addr);
-void push(i8080_state_t *cpu, uint8_t *reg_hi, uint8_t *reg_lo);
+void cond_ret(i8080_state_t *cpu, uint8_t condition);
+void cond_call(i8080_state_t *cpu, uint8_t condition, uint16_t addr);
+void push(i8080_state_t *cpu, uint16_t value);
+void rst(i8080_state_t *cpu, uint8_t n);
 
 void not_implemented(uint8_t op);
 
@@ -0,0 +1,279 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "include/intel8080.h"
+#include "include/i8080_analysis.h"
+
+/* Static recompiler: walks the code reachable from the reset and RST vectors
+   of a ROM image and writes one C function per basic block. Compile the output
+   with gcc -O2 and run it with run_cycles_aot() (see include/i8080_aot.h).
+   Anything that cannot be followed statically (RET, PCHL, code outside the
+   ROM) is left to the interpreter at run time.
+
+   Usage: recompiler <rom file> <output.c> [-m code map] [extra entry point (hex)]...
+
+   With -m the code map is loaded from the file if it was made for this ROM,
+   otherwise the ROM is analyzed and the map saved there for next time */
+
+#define MAX_ROM_SIZE (I8080_MAX_ADDRESS + 1)
+
+static const char *reg_name[8] = {"cpu->b", "cpu->c", "cpu->d", "cpu->e", "cpu->h", "cpu->l", NULL, "cpu->a"};
+
+/* Condition for each 3-bit condition code: NZ Z NC C PO PE P M */
+static const char *cond_expr[8] = {
+    "!(get_flags(cpu) & FLAG_Z)", "(get_flags(cpu) & FLAG_Z)",
+    "!(get_flags(cpu) & FLAG_C)", "(get_flags(cpu) & FLAG_C)",
+    "!(get_flags(cpu) & FLAG_P)", "(get_flags(cpu) & FLAG_P)",
+    "!(get_flags(cpu) & FLAG_S)", "(get_flags(cpu) & FLAG_S)"
+};
+
+static const char *pair_name[4] = {"cpu->bc", "cpu->de", "cpu->hl", "cpu->sp"};
+
+static const char *alu_name[8] = {"add", "adc", "sub", "sbb", "ana", "xra", "ora", "cmp"};
+
+#define HL "cpu->hl"
+
+static uint8_t *rom;
+static int rom_size;
+static i8080_code_map_t code_map; //Instruction and basic block starts reachable from the entries
+
+/* Op-codes that stop a block and are always left to the interpreter */
+static int is_barrier(uint8_t op){
+    return op == 0xD3 || op == 0xDB || op == 0xF3 || op == 0xFB || op == 0x76 || (op & 0xC7) == 0xC7;
+}
+
+static int fits(int addr){
+    return addr < rom_size && addr + i8080_length_table[rom[addr]] <= rom_size;
+}
+
+static int is_leader(int addr){
+    return addr < rom_size && CODE_MAP_TEST(code_map.block, addr);
+}
+
+static uint16_t operand16(int addr){
+    return (rom[addr + 2] << 8) | rom[addr + 1];
+}
+
+/* Leave the block for a known address, looping in place while budget remains */
+static void emit_exit(FILE *out, int start, uint16_t target){
+    if(target == start){
+        fprintf(out, "    if(cpu->cycles < target) goto top;\n");
+    }
+    fprintf(out, "    cpu->pc = 0x%04X; return;\n", target);
+}
+
+static void emit_cycles(FILE *out, uint32_t *cycles){
+    if(*cycles){
+        fprintf(out, "    cpu->cycles += %u;\n", *cycles);
+        *cycles = 0;
+    }
+}
+
+/* Emit the block starting at [start] as blk_XXXX() */
+static void emit_block(FILE *out, int start){
+    int addr = start;
+    uint32_t cycles = 0; //Cycles not yet added to cpu->cycles
+
+    fprintf(out, "static void blk_%04X(i8080_state_t *cpu, uint64_t target){\n", start);
+    fprintf(out, "    (void)target;\ntop: __attribute__((unused));\n");
+    for(;;){
+        uint8_t op, d8, dst, src;
+        uint16_t d16;
+        int next;
+
+        if(addr != start && (is_leader(addr) || !fits(addr))){
+            emit_cycles(out, &cycles);
+            emit_exit(out, start, addr);
+            break;
+        }
+        op = rom[addr];
+        d8 = rom[addr + 1 < rom_size ? addr + 1 : addr];
+        d16 = addr + 2 < rom_size ? operand16(addr) : 0;
+        next = addr + i8080_length_table[op];
+        dst = (op >> 3) & 7;
+        src = op & 7;
+        cycles += i8080_cycle_table[op];
+
+        if(op >= 0x40 && op <= 0x7F && op != 0x76){ // MOV
+            if(src == 6)
+                fprintf(out, "    %s = read_memory(cpu, " HL ");\n", reg_name[dst]);
+            else if(dst == 6)
+                fprintf(out, "    write_memory(cpu, " HL ", %s);\n", reg_name[src]);
+            else if(dst != src)
+                fprintf(out, "    %s = %s;\n", reg_name[dst], reg_name[src]);
+        }else if(op >= 0x80 && op <= 0xBF){ // ALU A,src
+            if(src == 6)
+                fprintf(out, "    { uint8_t m = read_memory(cpu, " HL "); %s(cpu, &m); }\n", alu_name[dst]);
+            else
+                fprintf(out, "    %s(cpu, &%s);\n", alu_name[dst], reg_name[src]);
+        }else if((op & 0xC7) == 0xC6){ // ALU A,D8
+            fprintf(out, "    { uint8_t d8 = 0x%02X; %s(cpu, &d8); }\n", d8, alu_name[dst]);
+        }else if((op & 0xC7) == 0x06){ // MVI
+            if(dst == 6)
+                fprintf(out, "    write_memory(cpu, " HL ", 0x%02X);\n", d8);
+            else
+                fprintf(out, "    %s = 0x%02X;\n", reg_name[dst], d8);
+        }else if((op & 0xC6) == 0x04 && dst != 6){ // INR/DCR r
+            fprintf(out, "    %s(cpu, &%s);\n", (op & 1) ? "dcr" : "inr", reg_name[dst]);
+        }else if((op & 0xCF) == 0x01){ // LXI
+            fprintf(out, "    %s = 0x%04X;\n", pair_name[op >> 4], d16);
+        }else if((op & 0xC7) == 0x03){ // INX/DCX
+            fprintf(out, "    %s%s;\n", pair_name[op >> 4], (op & 0x08) ? "--" : "++");
+        }else if(op == 0x02 || op == 0x12){ // STAX
+            fprintf(out, "    write_memory(cpu, %s, cpu->a);\n", pair_name[op >> 4]);
+        }else if(op == 0x0A || op == 0x1A){ // LDAX
+            fprintf(out, "    cpu->a = read_memory(cpu, %s);\n", pair_name[op >> 4]);
+        }else if(op == 0x32){ // STA
+            fprintf(out, "    write_memory(cpu, 0x%04X, cpu->a);\n", d16);
+        }else if(op == 0x3A){ // LDA
+            fprintf(out, "    cpu->a = read_memory(cpu, 0x%04X);\n", d16);
+        }else if(op == 0x22){ // SHLD
+            fprintf(out, "    write_memory(cpu, 0x%04X, cpu->l); write_memory(cpu, 0x%04X, cpu->h);\n", d16, (uint16_t)(d16 + 1));
+        }else if(op == 0x2A){ // LHLD
+            fprintf(out, "    cpu->hl = (read_memory(cpu, 0x%04X) << 8) | read_memory(cpu, 0x%04X);\n", (uint16_t)(d16 + 1), d16);
+        }else if(op == 0x2F){ // CMA
+            fprintf(out, "    cpu->a = ~cpu->a;\n");
+        }else if(op == 0xC5 || op == 0xD5 || op == 0xE5){ // PUSH rp
+            fprintf(out, "    push(cpu, %s);\n", pair_name[(op >> 4) & 3]);
+        }else if(op == 0xC1 || op == 0xD1 || op == 0xE1){ // POP rp
+            fprintf(out, "    %s = pop(cpu);\n", pair_name[(op >> 4) & 3]);
+        }else if(op == 0xEB){ // XCHG
+            fprintf(out, "    { uint16_t de = cpu->de; cpu->de = cpu->hl; cpu->hl = de; }\n");
+        }else if(op == 0xC3){ // JMP
+            emit_cycles(out, &cycles);
+            emit_exit(out, start, d16);
+            break;
+        }else if((op & 0xC7) == 0xC2){ // Jcc
+            emit_cycles(out, &cycles);
+            fprintf(out, "    if(%s){\n", cond_expr[dst]);
+            emit_exit(out, start, d16);
+            fprintf(out, "    }\n");
+            emit_exit(out, start, next);
+            break;
+        }else if(op == 0xCD){ // CALL
+            emit_cycles(out, &cycles);
+            fprintf(out, "    cpu->pc = 0x%04X; call(cpu, 0x%04X); return;\n", addr + 1, d16);
+            break;
+        }else if((op & 0xC7) == 0xC4){ // Ccc
+            emit_cycles(out, &cycles);
+            fprintf(out, "    if(%s){\n", cond_expr[dst]);
+            fprintf(out, "        cpu->cycles += I8080_COND_TAKEN_CYCLES;\n");
+            fprintf(out, "        cpu->pc = 0x%04X; call(cpu, 0x%04X); return;\n", addr + 1, d16);
+            fprintf(out, "    }\n");
+            emit_exit(out, start, next);
+            break;
+        }else if(op == 0xC9){ // RET
+            emit_cycles(out, &cycles);
+            fprintf(out, "    ret(cpu); return;\n");
+            break;
+        }else if((op & 0xC7) == 0xC0){ // Rcc
+            emit_cycles(out, &cycles);
+            fprintf(out, "    if(%s){ cpu->cycles += I8080_COND_TAKEN_CYCLES; ret(cpu); return; }\n", cond_expr[dst]);
+            emit_exit(out, start, next);
+            break;
+        }else if(op == 0xE9){ // PCHL
+            emit_cycles(out, &cycles);
+            fprintf(out, "    cpu->pc = " HL "; return;\n");
+            break;
+        }else if((op & 0xC7) == 0x00){
+            // NOP
+        }else{
+            // Everything else runs on the interpreter, which counts its own cycles
+            cycles -= i8080_cycle_table[op];
+            emit_cycles(out, &cycles);
+            fprintf(out, "    cpu->pc = 0x%04X; run_instruction(cpu);\n", addr);
+            if(is_barrier(op)){
+                fprintf(out, "    return;\n");
+                break;
+            }
+        }
+        addr = next;
+    }
+    fprintf(out, "}\n\n");
+}
+
+int main(int argc, char **argv){
+    char *filename;
+    FILE *rom_file;
+    FILE *out;
+    char *map_file = NULL;
+    uint16_t entries[I8080_MAX_ADDRESS + 1];
+    uint32_t entry_count = 0;
+    int blocks = 0;
+
+    if(argc < 3){
+        fprintf(stderr, "ERROR: Usage: %s <rom file> <output.c> [-m code map] [entry point (hex)]...\n", argv[0]);
+        return 1;
+    }
+    filename = argv[1];
+    printf("ROM File: %s\n", filename);
+
+    if((rom_file = fopen(filename, "rb")) == NULL){
+        fprintf(stderr, "ERROR: Could not open input file: %s\n", filename);
+        return 1;
+    }
+    fseek(rom_file, 0, SEEK_END);
+    rom_size = ftell(rom_file);
+    rewind(rom_file);
+    if(rom_size <= 0 || rom_size > MAX_ROM_SIZE){
+        fprintf(stderr, "ERROR: ROM size %d is not supported\n", rom_size);
+        return 1;
+    }
+    printf("ROM Size: %d bytes\n", rom_size);
+
+    rom = malloc(rom_size);
+    if(fread((void *)rom, 1, rom_size, rom_file) != (size_t)rom_size){
+        fprintf(stderr, "ERROR: Could not read ROM contents into memory\n");
+        free((void *)rom);
+        return 1;
+    }
+    fclose(rom_file);
+
+    /* Reset vector, interrupt vectors and anything given on the command line */
+    for(int vector = 0; vector < 0x40; vector += 8){
+        entries[entry_count++] = vector;
+    }
+    for(int i = 3; i < argc; i++){
+        if(strcmp(argv[i], "-m") == 0 && i + 1 < argc){
+            map_file = argv[++i];
+        }else if(entry_count <= I8080_MAX_ADDRESS){
+            entries[entry_count++] = strtol(argv[i], NULL, 16) & I8080_MAX_ADDRESS;
+        }
+    }
+    if(map_file == NULL || load_code_map(&code_map, rom, rom_size, map_file) != I8080_OK){
+        if(analyze_code(rom, rom_size, entries, entry_count, 0, &code_map) != I8080_OK){
+            free((void *)rom);
+            return 1;
+        }
+        if(map_file != NULL){
+            save_code_map(&code_map, map_file);
+        }
+    }
+
+    if((out = fopen(argv[2], "w")) == NULL){
+        fprintf(stderr, "ERROR: Could not open output file: %s\n", argv[2]);
+        return 1;
+    }
+    fprintf(out, "/* Generated by recompiler from %s, do not edit */\n", filename);
+    fprintf(out, "#include <stdint.h>\n#include <stddef.h>\n#include \"intel8080.h\"\n#include \"i8080_aot.h\"\n\n");
+    for(int addr = 0; addr < rom_size; addr++){
+        if(is_leader(addr) && fits(addr)){
+            emit_block(out, addr);
+            blocks++;
+        }
+    }
+    fprintf(out, "static const i8080_aot_block_t blocks[%d] = {\n", rom_size);
+    for(int addr = 0; addr < rom_size; addr++){
+        if(is_leader(addr) && fits(addr)){
+            fprintf(out, "    [0x%04X] = blk_%04X,\n", addr, addr);
+        }
+    }
+    fprintf(out, "};\n\nconst i8080_aot_module_t rom_module = {%d, blocks};\n", rom_size);
+    fclose(out);
+
+    printf("Blocks: %d\n", blocks);
+    free((void *)rom);
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "../include/intel8080.h"
+#include "../include/i8080_analysis.h"
+#ifdef I8080_JIT
+#include "../include/i8080_jit.h"
+#endif
+
+/* Shared by the analysis workers. Block starts wait on a stack, every
+   address is queued at most once and every instruction start is claimed by
+   exactly one worker, so the result does not depend on the thread count */
+typedef struct analysis_t{
+    const uint8_t *image;
+    uint32_t size;
+    i8080_code_map_t *map;
+    uint8_t queued[I8080_CODE_MAP_BYTES];
+    uint16_t pending[I8080_MAX_ADDRESS + 1];
+    uint32_t pending_count;
+    uint32_t busy; //Workers walking a block, they may still queue more
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+}analysis_t;
+
+/* Set addr's bit, true if this call was the one that set it */
+static int claim(uint8_t *bits, uint32_t addr){
+    uint8_t mask = 1 << (addr & 7);
+    return !(__atomic_fetch_or(&bits[addr >> 3], mask, __ATOMIC_RELAXED) & mask);
+}
+
+uint32_t image_hash(const uint8_t *image, uint32_t size){
+    uint32_t hash = 2166136261u;
+    for(uint32_t i = 0; i < size; i++){
+        hash = (hash ^ image[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* Mark a basic block start and queue it for walking */
+static void add_block(analysis_t *analysis, uint32_t addr){
+    if(addr >= analysis->size)
+        return; //Outside the image, e.g. RAM
+    claim(analysis->map->block, addr);
+    if(claim(analysis->queued, addr)){
+        pthread_mutex_lock(&analysis->lock);
+        analysis->pending[analysis->pending_count++] = addr;
+        pthread_cond_signal(&analysis->wake);
+        pthread_mutex_unlock(&analysis->lock);
+    }
+}
+
+/* Follow straight-line code from a block start until it leaves or runs into
+   code already walked. Branch targets and the code after a conditional
+   branch, call or restart are queued as blocks of their own */
+static void walk(analysis_t *analysis, uint32_t addr){
+    const uint8_t *image = analysis->image;
+    i8080_code_map_t *map = analysis->map;
+
+    while(addr < analysis->size){
+        uint8_t op = image[addr];
+        uint32_t next = addr + i8080_length_table[op];
+
+        if(next > analysis->size || !claim(map->insn, addr)){
+            return; //Cut short by the end of the image, or walked already
+        }
+        for(uint32_t i = addr; i < next; i++){
+            claim(map->code, i);
+        }
+
+        if(op == 0xC3){ // JMP
+            add_block(analysis, image[addr + 2] << 8 | image[addr + 1]);
+            return;
+        }else if(op == 0xCD || (op & 0xC7) == 0xC2 || (op & 0xC7) == 0xC4){ // CALL, Jcc, Ccc
+            add_block(analysis, image[addr + 2] << 8 | image[addr + 1]);
+            add_block(analysis, next);
+            return;
+        }else if((op & 0xC7) == 0xC7){ // RST n
+            add_block(analysis, op & 0x38);
+            add_block(analysis, next);
+            return;
+        }else if((op & 0xC7) == 0xC0){ // Rcc
+            add_block(analysis, next);
+            return;
+        }else if(op == 0xC9 || op == 0xE9){ // RET, PCHL
+            return;
+        }else if(op == 0xD3 || op == 0xDB || op == 0xF3 || op == 0xFB || op == 0x76){ // OUT, IN, DI, EI, HLT
+            add_block(analysis, next); //The JIT and recompiler hand these to the interpreter
+            return;
+        }
+        addr = next;
+    }
+}
+
+static void *analysis_worker(void *arg){
+    analysis_t *analysis = arg;
+
+    pthread_mutex_lock(&analysis->lock);
+    for(;;){
+        uint16_t addr;
+        while(analysis->pending_count == 0 && analysis->busy > 0){
+            pthread_cond_wait(&analysis->wake, &analysis->lock);
+        }
+        if(analysis->pending_count == 0){
+            break; //Nothing queued and nobody left to queue more
+        }
+        addr = analysis->pending[--analysis->pending_count];
+        analysis->busy++;
+        pthread_mutex_unlock(&analysis->lock);
+
+        walk(analysis, addr);
+
+        pthread_mutex_lock(&analysis->lock);
+        analysis->busy--;
+    }
+    pthread_cond_broadcast(&analysis->wake);
+    pthread_mutex_unlock(&analysis->lock);
+    return NULL;
+}
+
+static uint32_t count_bits(const uint8_t *bits){
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < I8080_CODE_MAP_BYTES; i++){
+        count += __builtin_popcount(bits[i]);
+    }
+    return count;
+}
+
+/* Map the code reachable from entries, or from the reset and RST vectors if
+   entries is NULL, using up to [threads] workers. 0 picks one per core for
+   images of I8080_ANALYSIS_PARALLEL_SIZE and up, and one below that */
+int analyze_code(const uint8_t *image, uint32_t size, const uint16_t *entries, uint32_t entry_count,
+                 uint32_t threads, i8080_code_map_t *map){
+    analysis_t *analysis;
+    pthread_t workers[I8080_ANALYSIS_MAX_THREADS];
+    uint32_t started = 0;
+
+    if(size > I8080_MAX_MEMORY_SIZE){
+        fprintf(stderr, "[ERROR]: Image of %u bytes is larger than the address space\n", size);
+        return I8080_ERROR;
+    }
+    analysis = calloc(1, sizeof(analysis_t));
+    if(analysis == NULL){
+        return I8080_ERROR;
+    }
+    memset(map, 0, sizeof(*map));
+    map->size = size;
+    map->hash = image_hash(image, size);
+    analysis->image = image;
+    analysis->size = size;
+    analysis->map = map;
+    pthread_mutex_init(&analysis->lock, NULL);
+    pthread_cond_init(&analysis->wake, NULL);
+
+    if(entries == NULL){
+        for(uint32_t vector = 0; vector < 0x40; vector += 8)
+            add_block(analysis, vector);
+    }else{
+        for(uint32_t i = 0; i < entry_count; i++)
+            add_block(analysis, entries[i]);
+    }
+
+    if(threads == 0){
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = size >= I8080_ANALYSIS_PARALLEL_SIZE && cores > 1 ? (uint32_t)cores : 1;
+    }
+    if(threads > I8080_ANALYSIS_MAX_THREADS){
+        threads = I8080_ANALYSIS_MAX_THREADS;
+    }
+    for(; started + 1 < threads; started++){
+        if(pthread_create(&workers[started], NULL, analysis_worker, analysis) != 0){
+            break; //Carry on with the workers we have
+        }
+    }
+    analysis_worker(analysis);
+    for(uint32_t i = 0; i < started; i++){
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&analysis->wake);
+    pthread_mutex_destroy(&analysis->lock);
+    free(analysis);
+    map->instructions = count_bits(map->insn);
+    map->blocks = count_bits(map->block);
+    return I8080_OK;
+}
+
+int save_code_map(const i8080_code_map_t *map, const char *filename){
+    FILE *out = fopen(filename, "wb");
+    uint32_t version = I8080_CODE_MAP_VERSION;
+
+    if(out == NULL){
+        fprintf(stderr, "[ERROR]: Could not open %s\n", filename);
+        return I8080_ERROR;
+    }
+    fwrite(I8080_CODE_MAP_MAGIC, 1, 8, out);
+    fwrite(&version, sizeof(version), 1, out);
+    fwrite(map, sizeof(*map), 1, out);
+    if(fclose(out) != 0){
+        fprintf(stderr, "[ERROR]: Could not write %s\n", filename);
+        return I8080_ERROR;
+    }
+    return I8080_OK;
+}
+
+/* Load a map saved for this exact image. Fails quietly if the file is
+   missing or was made for another image, so callers can fall back to
+   analyze_code() */
+int load_code_map(i8080_code_map_t *map, const uint8_t *image, uint32_t size, const char *filename){
+    FILE *in = fopen(filename, "rb");
+    char magic[8];
+    uint32_t version;
+    int ok;
+
+    if(in == NULL){
+        return I8080_ERROR;
+    }
+    ok = fread(magic, 1, 8, in) == 8 && memcmp(magic, I8080_CODE_MAP_MAGIC, 8) == 0 &&
+         fread(&version, sizeof(version), 1, in) == 1 && version == I8080_CODE_MAP_VERSION &&
+         fread(map, sizeof(*map), 1, in) == 1;
+    fclose(in);
+    if(!ok){
+        fprintf(stderr, "[ERROR]: %s is not a code map\n", filename);
+        return I8080_ERROR;
+    }
+    return map->size == size && map->hash == image_hash(image, size) ? I8080_OK : I8080_ERROR;
+}
+
+#ifdef I8080_DECODE_CACHE
+/* Decode every known instruction start up front */
+void seed_predecode(i8080_state_t *cpu, const i8080_code_map_t *map){
+    if(cpu->decode_cache == NULL)
+        return;
+    for(uint32_t addr = 0; addr < map->size; addr++){
+        if(CODE_MAP_TEST(map->insn, addr))
+            predecode_range(cpu, addr, 1);
+    }
+}
+#endif
+
+#ifdef I8080_JIT
+/* Translate every known block start up front */
+void seed_jit(i8080_state_t *cpu, const i8080_code_map_t *map){
+    for(uint32_t addr = 0; addr < map->size; addr++){
+        if(CODE_MAP_TEST(map->block, addr) && CODE_MAP_TEST(map->insn, addr))
+            jit_translate(cpu, addr);
+    }
+}
+#endif
@@ -0,0 +1,34 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "../include/intel8080.h"
+#include "../include/i8080_aot.h"
+
+/* Run until cpu->cycles reaches target, or the CPU halts */
+static void run_blocks(i8080_state_t *cpu, const i8080_aot_module_t *module, uint64_t target){
+    while(cpu->cycles < target && !cpu->halted){
+        i8080_aot_block_t block = cpu->pc < module->size ? module->blocks[cpu->pc] : NULL;
+        if(block != NULL){
+            block(cpu, target);
+        }else{
+            run_instruction(cpu);
+            if(cpu->int_request && cpu->int_enable){
+                run_instruction(cpu); //EI: the scheduler takes the interrupt after the next instruction
+                return;
+            }
+        }
+    }
+}
+
+/* Execute at least [budget] cycles, running recompiled blocks where the module
+   has one and the interpreter everywhere else (RAM, indirect jump targets the
+   recompiler never saw). A block always runs to its end, so the overshoot can
+   be up to one block. Scheduled events fire between blocks */
+int run_cycles_aot(i8080_state_t *cpu, const i8080_aot_module_t *module, uint32_t budget){
+    uint64_t end = cpu->cycles + budget;
+
+    while(cpu->cycles < end){
+        run_blocks(cpu, module, schedule_slice(cpu, end));
+    }
+    return I8080_OK;
+}
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define I8080_ARENA_MMAP
+#endif
+
+#define I8080_CACHE_LINE (64)
+#define I8080_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/* CPU state follows the guard bytes, on its own cache line */
+#define STATE_OFFSET ((I8080_MAX_MEMORY_SIZE + I8080_MEMORY_GUARD + I8080_CACHE_LINE - 1) & ~(size_t)(I8080_CACHE_LINE - 1))
+
+static size_t round_up(size_t value, size_t align){
+    return (value + align - 1) / align * align;
+}
+
+static size_t page_size(void){
+#ifdef I8080_ARENA_MMAP
+    long size = sysconf(_SC_PAGESIZE);
+    if(size > 0){
+        return (size_t)size;
+    }
+#endif
+    return 4096;
+}
+
+/* Map zeroed memory for the arena, trying huge pages first if asked to */
+static int map_arena(i8080_arena_t *arena, uint32_t flags){
+#ifdef I8080_ARENA_MMAP
+    void *base;
+#ifdef MAP_HUGETLB
+    if(flags & I8080_ARENA_HUGE_PAGES){
+        size_t size = round_up(arena->size, I8080_HUGE_PAGE_SIZE);
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(base != MAP_FAILED){
+            arena->base = base;
+            arena->size = size;
+            arena->huge = 1;
+            return I8080_OK;
+        }
+    }
+#endif
+    base = mmap(NULL, arena->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED){
+        return I8080_ERROR;
+    }
+#ifdef MADV_HUGEPAGE
+    if(flags & I8080_ARENA_HUGE_PAGES){
+        madvise(base, arena->size, MADV_HUGEPAGE); //Transparent huge pages, best effort
+    }
+#endif
+    arena->base = base;
+    return I8080_OK;
+#else
+    (void)flags;
+    arena->size = round_up(arena->size, page_size());
+    arena->base = aligned_alloc(page_size(), arena->size);
+    if(arena->base == NULL){
+        return I8080_ERROR;
+    }
+    memset(arena->base, 0, arena->size);
+    return I8080_OK;
+#endif
+}
+
+/* Allocate [count] CPU instances from a single mapping. Every instance starts
+   zeroed with its memory attached and default flags, and its own decode cache
+   in decode cache builds */
+i8080_arena_t *create_arena(uint32_t count, uint32_t flags){
+    i8080_arena_t *arena;
+
+    if(count == 0 || (arena = calloc(1, sizeof(*arena))) == NULL){
+        return NULL;
+    }
+    arena->count = count;
+    arena->slot_size = round_up(STATE_OFFSET + sizeof(i8080_state_t), page_size());
+    arena->size = arena->slot_size * count;
+    if(map_arena(arena, flags) != I8080_OK){
+        fprintf(stderr, "[ERROR]: Could not map memory for %u CPU instances\n", count);
+        free(arena);
+        return NULL;
+    }
+
+    for(uint32_t i = 0; i < count; i++){
+        i8080_state_t *cpu = arena_cpu(arena, i);
+        cpu->memory = arena->base + arena->slot_size * i;
+        cpu->arena = arena;
+        reset_memory_map(cpu);
+        reset_ports(cpu);
+        enable_idle_skip(cpu, 1);
+        clear_flags(cpu);
+#ifdef I8080_DECODE_CACHE
+        if(init_decode_cache(cpu) != I8080_OK){
+            fprintf(stderr, "[ERROR]: Could not allocate the decode cache for CPU instance %u\n", i);
+            destroy_arena(arena);
+            return NULL;
+        }
+#endif
+    }
+    return arena;
+}
+
+/* Instance [index] of the arena */
+i8080_state_t *arena_cpu(i8080_arena_t *arena, uint32_t index){
+    return (i8080_state_t *)(arena->base + arena->slot_size * index + STATE_OFFSET);
+}
+
+/* Release the arena and every instance in it */
+void destroy_arena(i8080_arena_t *arena){
+    if(arena == NULL)
+        return;
+    for(uint32_t i = 0; i < arena->count; i++){
+        free(arena_cpu(arena, i)->rom_image);
+#ifdef I8080_DECODE_CACHE
+        free_decode_cache(arena_cpu(arena, i));
+#endif
+    }
+#ifdef I8080_ARENA_MMAP
+    munmap(arena->base, arena->size);
+#else
+    free(arena->base);
+#endif
+    free(arena);
+}
+
+/* Single CPU instance, an arena of one */
+i8080_state_t *create_cpu(uint32_t flags){
+    i8080_arena_t *arena = create_arena(1, flags);
+    if(arena == NULL){
+        return NULL;
+    }
+    return arena_cpu(arena, 0);
+}
+
+/* Release an instance from create_cpu(). Pooled instances go with destroy_arena() */
+void destroy_cpu(i8080_state_t *cpu){
+    if(cpu == NULL)
+        return;
+    if(cpu->arena->count != 1){
+        fprintf(stderr, "[ERROR]: CPU belongs to a shared arena, release it with destroy_arena()\n");
+        return;
+    }
+    destroy_arena(cpu->arena);
+}
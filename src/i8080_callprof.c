@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+
+#ifdef I8080_CALL_PROFILE
+
+#define SYMBOL_LINE_SIZE (256)
+#define NAME_SIZE (64)
+
+/* Begin recording call paths from the code running now. max_nodes bounds the
+   call path tree, 0 for I8080_CALL_MAX_NODES */
+int start_call_profile(i8080_state_t *cpu, uint32_t max_nodes){
+    i8080_call_profile_t *profile;
+
+    stop_call_profile(cpu);
+    if(max_nodes == 0){
+        max_nodes = I8080_CALL_MAX_NODES;
+    }
+    profile = calloc(1, sizeof(i8080_call_profile_t));
+    if(profile == NULL){
+        return I8080_ERROR;
+    }
+    profile->nodes = calloc(max_nodes, sizeof(i8080_call_node_t));
+    if(profile->nodes == NULL){
+        free(profile);
+        return I8080_ERROR;
+    }
+    profile->max_nodes = max_nodes;
+    profile->node_count = 1;
+    profile->nodes[0].addr = cpu->pc;
+    profile->nodes[0].calls = 1;
+    profile->last_cycles = cpu->cycles;
+    cpu->call_profile = profile;
+    return I8080_OK;
+}
+
+void stop_call_profile(i8080_state_t *cpu){
+    i8080_call_profile_t *profile = cpu->call_profile;
+
+    if(profile == NULL)
+        return;
+    if(profile->symbols != NULL){
+        for(uint32_t addr = 0; addr < I8080_MAX_MEMORY_SIZE; addr++)
+            free(profile->symbols[addr]);
+        free(profile->symbols);
+    }
+    free(profile->nodes);
+    free(profile);
+    cpu->call_profile = NULL;
+}
+
+/* Read "ADDR name" lines, ADDR in hex with an optional 0x or $ prefix.
+   Blank lines and lines starting with ; or # are skipped */
+int load_symbols(i8080_state_t *cpu, const char *filename){
+    i8080_call_profile_t *profile = cpu->call_profile;
+    char line[SYMBOL_LINE_SIZE];
+    FILE *symbol_file;
+    int line_number = 0;
+
+    if(profile == NULL){
+        fprintf(stderr, "[ERROR]: Start the call profile before loading symbols\n");
+        return I8080_ERROR;
+    }
+    symbol_file = fopen(filename, "r");
+    if(symbol_file == NULL){
+        fprintf(stderr, "[ERROR]: Could not open symbol file %s\n", filename);
+        return I8080_ERROR;
+    }
+    if(profile->symbols == NULL){
+        profile->symbols = calloc(I8080_MAX_MEMORY_SIZE, sizeof(char *));
+        if(profile->symbols == NULL){
+            fclose(symbol_file);
+            return I8080_ERROR;
+        }
+    }
+
+    while(fgets(line, sizeof(line), symbol_file) != NULL){
+        char *text = line;
+        char name[NAME_SIZE];
+        unsigned addr;
+
+        line_number++;
+        text += strspn(text, " \t");
+        if(*text == '\0' || *text == '\n' || *text == ';' || *text == '#'){
+            continue;
+        }
+        if(*text == '$'){
+            text++;
+        }
+        if(sscanf(text, "%x %63s", &addr, name) != 2 || addr > I8080_MAX_ADDRESS){
+            fprintf(stderr, "[ERROR]: %s:%d: expected \"ADDR name\"\n", filename, line_number);
+            continue;
+        }
+        free(profile->symbols[addr]);
+        profile->symbols[addr] = strdup(name);
+    }
+    fclose(symbol_file);
+    return I8080_OK;
+}
+
+/* Charge the cycles since the last call or return to the current path */
+static void charge(i8080_state_t *cpu, i8080_call_profile_t *profile){
+    profile->nodes[profile->current].cycles += cpu->cycles - profile->last_cycles;
+    profile->last_cycles = cpu->cycles;
+}
+
+/* Frames whose return address slot is at or below sp are gone, e.g. after a
+   RET, POPs or a reloaded SP */
+static void unwind(i8080_call_profile_t *profile, uint16_t sp, int inclusive){
+    while(profile->depth > 0){
+        int16_t above = (int16_t)(sp - profile->stack[profile->depth - 1].sp);
+        if(above < 0 || (above == 0 && !inclusive))
+            break;
+        profile->depth--;
+    }
+    profile->current = profile->depth > 0 ? profile->stack[profile->depth - 1].node : 0;
+}
+
+/* Called after CALL/Ccc/RST/interrupts have pushed the return address and
+   moved PC to the subroutine */
+void call_profile_enter(i8080_state_t *cpu){
+    i8080_call_profile_t *profile = cpu->call_profile;
+    uint32_t node;
+
+    charge(cpu, profile);
+    unwind(profile, cpu->sp, 1);
+
+    //Callees are few per path, a linear walk of the siblings is enough
+    for(node = profile->nodes[profile->current].child; node != 0; node = profile->nodes[node].sibling){
+        if(profile->nodes[node].addr == cpu->pc)
+            break;
+    }
+    if(node == 0){
+        if(profile->node_count == profile->max_nodes || profile->depth == I8080_CALL_MAX_DEPTH){
+            profile->dropped++;
+            return;
+        }
+        node = profile->node_count++;
+        profile->nodes[node].addr = cpu->pc;
+        profile->nodes[node].parent = profile->current;
+        profile->nodes[node].sibling = profile->nodes[profile->current].child;
+        profile->nodes[profile->current].child = node;
+    }
+    if(profile->depth == I8080_CALL_MAX_DEPTH){
+        profile->dropped++;
+        return;
+    }
+    profile->nodes[node].calls++;
+    profile->stack[profile->depth].node = node;
+    profile->stack[profile->depth].sp = cpu->sp;
+    profile->depth++;
+    profile->current = node;
+}
+
+/* Called after RET/Rcc has popped the return address */
+void call_profile_leave(i8080_state_t *cpu){
+    i8080_call_profile_t *profile = cpu->call_profile;
+
+    charge(cpu, profile);
+    unwind(profile, cpu->sp, 0);
+}
+
+static const char *node_name(i8080_call_profile_t *profile, uint32_t node, char *buffer){
+    uint16_t addr = profile->nodes[node].addr;
+
+    if(profile->symbols != NULL && profile->symbols[addr] != NULL){
+        return profile->symbols[addr];
+    }
+    if(node != 0 && (addr & ~0x38) == 0){
+        sprintf(buffer, "rst_%d", addr >> 3); //Restart vector or interrupt
+    }else{
+        sprintf(buffer, "sub_%04X", addr);
+    }
+    return buffer;
+}
+
+/* Write one "root;caller;callee cycles" line per call path with cycles of its
+   own, the collapsed stack format flamegraph.pl and speedscope read */
+int write_call_profile(i8080_state_t *cpu, const char *filename){
+    i8080_call_profile_t *profile = cpu->call_profile;
+    uint32_t path[I8080_CALL_MAX_DEPTH + 1];
+    FILE *out;
+
+    if(profile == NULL){
+        fprintf(stderr, "[ERROR]: No call profile running\n");
+        return I8080_ERROR;
+    }
+    out = fopen(filename, "w");
+    if(out == NULL){
+        fprintf(stderr, "[ERROR]: Could not open %s\n", filename);
+        return I8080_ERROR;
+    }
+    charge(cpu, profile);
+
+    for(uint32_t node = 0; node < profile->node_count; node++){
+        uint32_t depth = 0;
+        if(profile->nodes[node].cycles == 0)
+            continue;
+        for(uint32_t up = node; up != 0; up = profile->nodes[up].parent)
+            path[depth++] = up;
+        path[depth++] = 0;
+        while(depth > 0){
+            char buffer[NAME_SIZE];
+            depth--;
+            fputs(node_name(profile, path[depth], buffer), out);
+            fputc(depth > 0 ? ';' : ' ', out);
+        }
+        fprintf(out, "%llu\n", (unsigned long long)profile->nodes[node].cycles);
+    }
+    fclose(out);
+
+    if(profile->dropped != 0){
+        fprintf(stderr, "[ERROR]: %llu calls were not tracked, raise max_nodes\n",
+                (unsigned long long)profile->dropped);
+    }
+    return I8080_OK;
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+
+/* Switch idle-loop skipping on or off, e.g. off when comparing against a
+   reference that steps every instruction */
+void enable_idle_skip(i8080_state_t *cpu, uint8_t enable){
+    cpu->idle.enabled = enable;
+    cpu->idle.valid = 0;
+}
+
+/* False if a read from addr could have side effects or change between
+   iterations on its own */
+static int plain_read(i8080_state_t *cpu, uint16_t addr){
+    return cpu->map.kind[addr >> I8080_PAGE_SHIFT] != I8080_PAGE_MMIO;
+}
+
+/* Register-indirect reads go wherever the loop points them, only safe when
+   nothing is memory mapped I/O */
+static int no_mmio(i8080_state_t *cpu){
+    for(int page = 0; page < I8080_PAGE_COUNT; page++){
+        if(cpu->map.kind[page] == I8080_PAGE_MMIO)
+            return 0;
+    }
+    return 1;
+}
+
+static int code_page(i8080_state_t *cpu, uint16_t addr){
+    return cpu->map.kind[addr >> I8080_PAGE_SHIFT] <= I8080_PAGE_ROM;
+}
+
+/* Check every instruction in [head, from) is free of side effects and return
+   the cycles of one pass straight through them, 0 if not pure. Stores, OUT,
+   stack and interrupt control are rejected. Jumps have to stay within the
+   loop, code a pass detours through is never checked, and only the closing
+   jump may be unconditional. IN is allowed on the assumption that port
+   inputs only change from event handlers */
+static uint32_t loop_is_pure(i8080_state_t *cpu, uint16_t head, uint16_t from){
+    uint16_t pc = head;
+    uint32_t cycles = 0;
+
+    while(pc != from){
+        uint8_t op, length;
+        uint16_t addr;
+
+        if(!code_page(cpu, pc)){
+            return 0; //Code on a mirror or MMIO page
+        }
+        op = read_memory(cpu, pc);
+        length = i8080_length_table[op];
+        if((uint16_t)(from - pc) < length || !code_page(cpu, pc + length - 1)){
+            return 0;
+        }
+        addr = length == 3 ? (read_memory(cpu, pc + 2) << 8) | read_memory(cpu, pc + 1) : 0;
+
+        switch(op){
+            case 0x02: case 0x12: case 0x22: case 0x32: // STAX, SHLD, STA
+            case 0x34: case 0x35: case 0x36:            // INR M, DCR M, MVI M
+            case 0xD3: case 0xE3: case 0xE9:            // OUT, XTHL, PCHL
+            case 0xF3: case 0xFB: case 0xF9:            // DI, EI, SPHL
+                return 0;
+            case 0x0A: case 0x1A: // LDAX
+                if(!no_mmio(cpu)) return 0;
+                break;
+            case 0x2A: // LHLD
+                if(!plain_read(cpu, addr) || !plain_read(cpu, addr + 1)) return 0;
+                break;
+            case 0x3A: // LDA
+                if(!plain_read(cpu, addr)) return 0;
+                break;
+            case 0xC3: // JMP, only as the closing jump
+                if(pc != (uint16_t)(from - 3)) return 0;
+                //fall through
+            case 0xC2: case 0xCA: case 0xD2: case 0xDA: // Jcc
+            case 0xE2: case 0xEA: case 0xF2: case 0xFA:
+                if((uint16_t)(addr - head) >= (uint16_t)(from - head)) return 0;
+                break;
+            default:
+                if(op >= 0x70 && op <= 0x77) // MOV M,r and HLT
+                    return 0;
+                if(op >= 0xC0 && (op & 0x07) != 0x06 && op != 0xCB && op != 0xDB && op != 0xEB)
+                    return 0; // RET, POP, CALL, PUSH, RST
+                if(op >= 0x40 && op <= 0xBF && (op & 0x07) == 0x06 && !no_mmio(cpu))
+                    return 0; // MOV r,M and ALU M
+                break;
+        }
+        cycles += i8080_cycle_table[op];
+        pc += length;
+    }
+    return cycles;
+}
+
+/* Called on a taken backward jump from [from] to cpu->pc with at most
+   I8080_IDLE_MAX_LOOP bytes between them. The first pass snapshots the state,
+   the next one compares: identical state and a pure loop means every further
+   iteration is the same, so cycles skip ahead by whole iterations to just
+   short of target */
+void idle_check(i8080_state_t *cpu, uint16_t from, uint64_t target){
+    i8080_idle_t *idle = &cpu->idle;
+    uint16_t head = cpu->pc;
+    uint32_t slot = from % I8080_IDLE_CACHE_SIZE; //Loops are told apart by their closing jump
+    uint8_t flags;
+
+    if(idle->miss_from[slot] != from){
+        idle->miss_from[slot] = from;
+        idle->misses[slot] = 0;
+    }else if(idle->misses[slot] >= I8080_IDLE_MAX_MISSES){
+        return; //Counting or otherwise busy loop
+    }
+
+    flags = get_flags(cpu);
+
+    if(idle->valid && idle->head == head && idle->from == from){
+        if(idle->bc == cpu->bc && idle->de == cpu->de && idle->hl == cpu->hl &&
+           idle->sp == cpu->sp && idle->a == cpu->a && idle->flags == flags){
+            uint64_t period = cpu->cycles - idle->cycles;
+            //A pass that took any other path, e.g. out through an exit and back, is not skipped
+            if(period == 0 || loop_is_pure(cpu, head, from) != period){
+                idle->misses[slot] = I8080_IDLE_MAX_MISSES;
+            }else if(cpu->cycles < target && target - cpu->cycles >= period){
+                uint64_t skip = (target - cpu->cycles) / period * period;
+                cpu->cycles += skip;
+                idle->fast_forwards++;
+                idle->skipped_cycles += skip;
+            }
+        }else{
+            idle->misses[slot]++;
+        }
+    }
+
+    idle->valid = 1;
+    idle->head = head;
+    idle->from = from;
+    idle->bc = cpu->bc;
+    idle->de = cpu->de;
+    idle->hl = cpu->hl;
+    idle->sp = cpu->sp;
+    idle->a = cpu->a;
+    idle->flags = flags;
+    idle->cycles = cpu->cycles;
+}
+
+void display_idle_stats(i8080_state_t *cpu){
+    printf("Idle fast-forwards: %llu\n", (unsigned long long)cpu->idle.fast_forwards);
+    printf("Idle cycles skipped: %llu\n", (unsigned long long)cpu->idle.skipped_cycles);
+}
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+
+/* Attach handlers to a port. Buffered ports only suit devices nothing reads
+   back within the frame (e.g. sound latches): their OUTs reach the write
+   handler when the host calls flush_port_log(), not when they execute.
+   Remapping a buffered port flushes the log first, so logged OUTs reach the
+   handler they were made to */
+int map_port(i8080_state_t *cpu, uint8_t port, i8080_port_read_t read, i8080_port_write_t write,
+             void *ctx, uint32_t flags){
+    if((flags & I8080_PORT_BUFFERED) && write == NULL){
+        fprintf(stderr, "[ERROR]: Buffered port %02X needs a write handler\n", port);
+        return I8080_ERROR;
+    }
+    if(cpu->io.ports[port].flags & I8080_PORT_BUFFERED){
+        flush_port_log(cpu);
+    }
+    cpu->io.ports[port].read = read;
+    cpu->io.ports[port].write = write;
+    cpu->io.ports[port].ctx = ctx;
+    cpu->io.ports[port].flags = flags;
+    return I8080_OK;
+}
+
+/* Detach every port and drop buffered OUTs */
+void reset_ports(i8080_state_t *cpu){
+    memset(&cpu->io, 0, sizeof(cpu->io));
+}
+
+/* Replay the buffered OUTs into their write handlers in execution order,
+   normally once per frame */
+void flush_port_log(i8080_state_t *cpu){
+    i8080_io_t *io = &cpu->io;
+
+    for(uint32_t i = 0; i < io->log_count; i++){
+        i8080_port_t *port = &io->ports[io->log[i].port];
+        port->write(port->ctx, io->log[i].port, io->log[i].value);
+    }
+    io->log_count = 0;
+}
+
+uint8_t port_in(i8080_state_t *cpu, uint8_t port){
+    i8080_port_t *entry = &cpu->io.ports[port];
+    if(entry->read != NULL){
+        return entry->read(entry->ctx, port);
+    }
+    return 0xff; //Nothing drives the bus
+}
+
+void port_out(i8080_state_t *cpu, uint8_t port, uint8_t value){
+    i8080_io_t *io = &cpu->io;
+    i8080_port_t *entry = &io->ports[port];
+
+    if(entry->flags & I8080_PORT_BUFFERED){
+        if(io->log_count == I8080_PORT_LOG_SIZE){
+            io->log_overflows++;
+            flush_port_log(cpu);
+        }
+        io->log[io->log_count].cycles = cpu->cycles;
+        io->log[io->log_count].port = port;
+        io->log[io->log_count].value = value;
+        io->log_count++;
+    }else if(entry->write != NULL){
+        entry->write(entry->ctx, port, value);
+    }
+}
@@ -0,0 +1,641 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+#include "../include/i8080_jit.h"
+
+#ifdef I8080_JIT
+#if defined(__x86_64__)
+
+#include <sys/mman.h>
+
+/* Register use inside translated code:
+     rbx = cpu, r12 = cycle target, r13 = cpu->map.read, r14 = &jit->dirty
+   8080 registers stay in the state struct. [rsp] is a scratch byte used to
+   pass immediate operands to the ALU helpers, which take a pointer */
+
+#define OFF(field) ((int32_t)offsetof(i8080_state_t, field))
+
+#define JIT_BLOCK_RESERVE (8 * 1024) //Worst case code size of one block
+
+/* Entry stub: jumps to code, returns the chain site of a patchable exit or NULL */
+typedef uint8_t *(*jit_enter_fn)(i8080_state_t *cpu, uint64_t target, uint8_t *code, uint8_t *dirty);
+
+/* Offsets of the shared stubs at the start of the code buffer */
+static uint8_t *exit_null_stub(i8080_jit_t *jit);
+static uint8_t *exit_stub(i8080_jit_t *jit);
+
+/* Struct offset of each register pair by 2-bit op-code field: BC DE HL SP */
+static const int32_t pair_offset[4] = {OFF(bc), OFF(de), OFF(hl), OFF(sp)};
+
+typedef void (*alu_fn)(i8080_state_t *cpu, uint8_t *reg);
+static const alu_fn alu_table[8] = {add, adc, sub, sbb, ana, xra, ora, cmp};
+
+/* Condition flag tested by each 3-bit condition code: NZ Z NC C PO PE P M */
+static const uint8_t cond_flag[8] = {FLAG_Z, FLAG_Z, FLAG_C, FLAG_C, FLAG_P, FLAG_P, FLAG_S, FLAG_S};
+
+/* Op-codes left to the interpreter: I/O and interrupt control. Blocks always
+   stop in front of them so the host sees them between blocks */
+static int is_barrier(uint8_t op){
+    switch(op){
+        case 0xD3: // OUT
+        case 0xDB: // IN
+        case 0xF3: // DI
+        case 0xFB: // EI
+        case 0x76: // HLT
+            return 1;
+        default:
+            return (op & 0xC7) == 0xC7; // RST n
+    }
+}
+
+/* ---- x86-64 code emission ---- */
+
+static void emit8(i8080_jit_t *jit, uint8_t byte){
+    *jit->code_ptr++ = byte;
+}
+
+static void emit16(i8080_jit_t *jit, uint16_t value){
+    memcpy(jit->code_ptr, &value, 2);
+    jit->code_ptr += 2;
+}
+
+static void emit32(i8080_jit_t *jit, uint32_t value){
+    memcpy(jit->code_ptr, &value, 4);
+    jit->code_ptr += 4;
+}
+
+static void emit64(i8080_jit_t *jit, uint64_t value){
+    memcpy(jit->code_ptr, &value, 8);
+    jit->code_ptr += 8;
+}
+
+/* ModRM + disp32 for [rbx + disp] with the given reg field */
+static void emit_rbx_mem(i8080_jit_t *jit, uint8_t reg, int32_t disp){
+    emit8(jit, 0x80 | (reg << 3) | 3);
+    emit32(jit, disp);
+}
+
+/* Point a rel32 field at target */
+static void patch_rel32(uint8_t *field, uint8_t *target){
+    int32_t rel = (int32_t)(target - (field + 4));
+    memcpy(field, &rel, 4);
+}
+
+/* jmp rel32 to target */
+static void emit_jmp(i8080_jit_t *jit, uint8_t *target){
+    emit8(jit, 0xE9);
+    emit32(jit, 0);
+    patch_rel32(jit->code_ptr - 4, target);
+}
+
+/* jcc rel32 with an unresolved target, returns the rel32 field to patch */
+static uint8_t *emit_jcc(i8080_jit_t *jit, uint8_t cc){
+    emit8(jit, 0x0F);
+    emit8(jit, 0x80 | cc);
+    emit32(jit, 0);
+    return jit->code_ptr - 4;
+}
+
+/* movzx reg32, byte [rbx + disp] */
+static void emit_load8(i8080_jit_t *jit, uint8_t reg, int32_t disp){
+    emit8(jit, 0x0F);
+    emit8(jit, 0xB6);
+    emit_rbx_mem(jit, reg, disp);
+}
+
+/* mov byte [rbx + disp], reg8 */
+static void emit_store8(i8080_jit_t *jit, uint8_t reg, int32_t disp){
+    emit8(jit, 0x88);
+    emit_rbx_mem(jit, reg, disp);
+}
+
+/* mov byte [rbx + disp], imm8 */
+static void emit_store_imm8(i8080_jit_t *jit, int32_t disp, uint8_t value){
+    emit8(jit, 0xC6);
+    emit_rbx_mem(jit, 0, disp);
+    emit8(jit, value);
+}
+
+/* mov word [rbx + disp], imm16 */
+static void emit_store_imm16(i8080_jit_t *jit, int32_t disp, uint16_t value){
+    emit8(jit, 0x66);
+    emit8(jit, 0xC7);
+    emit_rbx_mem(jit, 0, disp);
+    emit16(jit, value);
+}
+
+/* add qword [rbx + cycles], imm32 */
+static void emit_add_cycles(i8080_jit_t *jit, uint32_t cycles){
+    if(cycles == 0)
+        return;
+    emit8(jit, 0x48);
+    emit8(jit, 0x81);
+    emit_rbx_mem(jit, 0, OFF(cycles));
+    emit32(jit, cycles);
+}
+
+/* eax = HL */
+static void emit_load_hl(i8080_jit_t *jit){
+    emit8(jit, 0x0F); emit8(jit, 0xB7); emit_rbx_mem(jit, 0, OFF(hl)); // movzx eax, word [rbx + hl]
+}
+
+/* Call a C helper with rdi = cpu. rsi/rdx must already hold any other arguments */
+static void emit_call(i8080_jit_t *jit, void *fn){
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xDF); // mov rdi, rbx
+    emit8(jit, 0x48); emit8(jit, 0xB8); emit64(jit, (uint64_t)(uintptr_t)fn); // mov rax, fn
+    emit8(jit, 0xFF); emit8(jit, 0xD0);                   // call rax
+}
+
+/* rsi = &register */
+static void emit_reg_ptr(i8080_jit_t *jit, int32_t disp){
+    emit8(jit, 0x48); emit8(jit, 0x8D);
+    emit8(jit, 0xB3); emit32(jit, disp);                  // lea rsi, [rbx + disp]
+}
+
+/* eax = byte at HL. RAM and ROM pages are read inline through the page
+   table, MMIO goes through read_memory() */
+static void emit_read_hl(i8080_jit_t *jit){
+    emit_load_hl(jit);
+    emit8(jit, 0x0F); emit8(jit, 0xB6); emit8(jit, 0xCC);                    // movzx ecx, ah
+    emit8(jit, 0x49); emit8(jit, 0x8B); emit8(jit, 0x4C); emit8(jit, 0xCD); emit8(jit, 0x00); // mov rcx, [r13 + rcx*8]
+    emit8(jit, 0x48); emit8(jit, 0x85); emit8(jit, 0xC9);                    // test rcx, rcx
+    emit8(jit, 0x74); emit8(jit, 9);                                         // jz slow
+    emit8(jit, 0x0F); emit8(jit, 0xB6); emit8(jit, 0xC0);                    // movzx eax, al
+    emit8(jit, 0x0F); emit8(jit, 0xB6); emit8(jit, 0x04); emit8(jit, 0x01);  // movzx eax, byte [rcx + rax]
+    emit8(jit, 0xEB); emit8(jit, 17);                                        // jmp done
+    emit8(jit, 0x89); emit8(jit, 0xC6);                                      // slow: mov esi, eax
+    emit_call(jit, (void *)read_memory);                                     // done:
+}
+
+/* rsi = pointer to a copy of the byte at HL in the [rsp] scratch */
+static void emit_hl_ptr(i8080_jit_t *jit){
+    emit_read_hl(jit);
+    emit8(jit, 0x88); emit8(jit, 0x04); emit8(jit, 0x24);                    // mov byte [rsp], al
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xE6);                    // mov rsi, rsp
+}
+
+/* Only code on RAM and ROM pages is translated, the bytes of mirror and MMIO
+   pages are not tracked by the code map */
+static int translatable(i8080_state_t *cpu, uint16_t pc){
+    return cpu->map.kind[pc >> I8080_PAGE_SHIFT] <= I8080_PAGE_ROM &&
+           cpu->map.kind[(uint16_t)(pc + 2) >> I8080_PAGE_SHIFT] <= I8080_PAGE_ROM;
+}
+
+/* Leave the block for target, counting cycles. While budget remains the exit
+   is a patchable jmp, chained straight to the target block once it exists */
+static void emit_exit_static(i8080_jit_t *jit, uint16_t target, uint32_t cycles){
+    uint8_t *site;
+
+    emit_add_cycles(jit, cycles);
+    emit_store_imm16(jit, OFF(pc), target);
+    emit8(jit, 0x4C); emit8(jit, 0x39); emit_rbx_mem(jit, 4, OFF(cycles)); // cmp [rbx + cycles], r12
+    patch_rel32(emit_jcc(jit, 0x03), exit_null_stub(jit));                 // jae exit_null
+    site = jit->code_ptr;
+    emit8(jit, 0xE9); emit32(jit, 0);                                      // jmp next (chain site)
+    emit8(jit, 0x48); emit8(jit, 0x8D); emit8(jit, 0x05);                  // lea rax, [rip + site]
+    emit32(jit, (uint32_t)(int32_t)(site - (jit->code_ptr + 4)));
+    emit_jmp(jit, exit_stub(jit));
+}
+
+/* Leave the block with PC already set by a helper */
+static void emit_exit_dynamic(i8080_jit_t *jit, uint32_t cycles){
+    emit_add_cycles(jit, cycles);
+    emit_jmp(jit, exit_null_stub(jit));
+}
+
+/* After anything that may store: leave the block if translated code was hit.
+   next_pc < 0 keeps the PC the helper left behind */
+static void emit_dirty_check(i8080_jit_t *jit, uint32_t cycles, int32_t next_pc){
+    uint8_t *skip;
+
+    emit8(jit, 0x41); emit8(jit, 0x80); emit8(jit, 0x3E); emit8(jit, 0x00); // cmp byte [r14], 0
+    skip = emit_jcc(jit, 0x04);                                            // je skip
+    emit_add_cycles(jit, cycles);
+    if(next_pc >= 0)
+        emit_store_imm16(jit, OFF(pc), (uint16_t)next_pc);
+    emit_jmp(jit, exit_null_stub(jit));
+    patch_rel32(skip, jit->code_ptr);
+}
+
+/* Test condition code ccc, returns the rel32 field of the jump taken when it fails */
+static uint8_t *emit_condition(i8080_jit_t *jit, uint8_t ccc){
+    uint8_t flag = cond_flag[ccc];
+#ifdef I8080_LAZY_FLAGS
+    emit_call(jit, (void *)get_flags);
+    emit8(jit, 0xA8); emit8(jit, flag);                   // test al, flag
+#else
+    emit8(jit, 0xF6); emit_rbx_mem(jit, 0, OFF(flags)); emit8(jit, flag); // test byte [rbx + flags], flag
+#endif
+    return emit_jcc(jit, (ccc & 1) ? 0x04 : 0x05);        // jz/jnz not taken
+}
+
+static uint8_t *exit_null_stub(i8080_jit_t *jit){
+    return jit->code + 32;
+}
+
+static uint8_t *exit_stub(i8080_jit_t *jit){
+    return jit->code + 34;
+}
+
+/* Shared enter/exit stubs at the start of the buffer. Five pushes keep rsp
+   16-byte aligned for helper calls */
+static void emit_stubs(i8080_jit_t *jit){
+    static const uint8_t enter[] = {
+        0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, // push rbx, rbp, r12, r13, r14
+        0x48, 0x83, 0xEC, 0x10,                         // sub rsp, 16
+        0x48, 0x89, 0xFB,                               // mov rbx, rdi
+        0x49, 0x89, 0xF4,                               // mov r12, rsi
+        0x49, 0x89, 0xCE,                               // mov r14, rcx
+    };
+    static const uint8_t leave[] = {
+        0x31, 0xC0,                                     // exit_null: xor eax, eax
+        0x48, 0x83, 0xC4, 0x10,                         // exit: add rsp, 16
+        0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, // pop r14, r13, r12, rbp, rbx
+        0xC3                                            // ret
+    };
+
+    jit->code_ptr = jit->code;
+    memcpy(jit->code_ptr, enter, sizeof(enter));
+    jit->code_ptr += sizeof(enter);
+    emit8(jit, 0x4C); emit8(jit, 0x8D); emit_rbx_mem(jit, 5, OFF(map.read)); // lea r13, [rbx + map.read]
+    emit8(jit, 0xFF); emit8(jit, 0xE2);                                    // jmp rdx
+    while(jit->code_ptr < exit_null_stub(jit))
+        emit8(jit, 0xCC);
+    memcpy(jit->code_ptr, leave, sizeof(leave));
+    jit->code_ptr += sizeof(leave);
+    jit->code_start = jit->code_ptr;
+}
+
+/* Translate the basic block starting at start_pc */
+static uint8_t *translate_block(i8080_state_t *cpu, uint16_t start_pc){
+    i8080_jit_t *jit = cpu->jit;
+    uint8_t *entry;
+    uint16_t pc = start_pc;
+    uint32_t cycles = 0; //Cycles of the translated instructions so far
+
+    if(jit->code_ptr + JIT_BLOCK_RESERVE > jit->code + I8080_JIT_CODE_SIZE)
+        jit_flush(jit);
+    entry = jit->code_ptr;
+
+    for(int count = 0; ; count++){
+        uint8_t op, d8, dst, src;
+        uint16_t d16, next;
+        uint8_t *skip;
+
+        if(count > 0 && !translatable(cpu, pc)){
+            emit_exit_static(jit, pc, cycles);
+            break;
+        }
+        op = read_memory(cpu, pc);
+        d8 = read_memory(cpu, pc + 1);
+        d16 = (read_memory(cpu, pc + 2) << 8) | d8;
+        next = pc + i8080_length_table[op];
+        dst = (op >> 3) & 7;
+        src = op & 7;
+
+        if(count == I8080_JIT_MAX_BLOCK_OPS || (count > 0 && is_barrier(op))){
+            emit_exit_static(jit, pc, cycles);
+            break;
+        }
+        for(uint16_t i = 0; i < i8080_length_table[op]; i++){
+            uint16_t addr = pc + i;
+            jit->code_map[addr >> 3] |= 1 << (addr & 7);
+        }
+        cycles += i8080_cycle_table[op];
+
+        if(op >= 0x40 && op <= 0x7F && op != 0x76){ // MOV dst,src
+            if(src == 6){
+                emit_read_hl(jit);
+                emit_store8(jit, 0, i8080_reg_offset[dst]);
+            }else if(dst == 6){
+                emit_load_hl(jit);
+                emit8(jit, 0x89); emit8(jit, 0xC6);                   // mov esi, eax
+                emit_load8(jit, 2, i8080_reg_offset[src]);
+                emit_call(jit, (void *)write_memory);
+                emit_dirty_check(jit, cycles, next);
+            }else if(dst != src){
+                emit_load8(jit, 0, i8080_reg_offset[src]);
+                emit_store8(jit, 0, i8080_reg_offset[dst]);
+            }
+        }else if(op >= 0x80 && op <= 0xBF){ // ALU A,src
+            if(src == 6)
+                emit_hl_ptr(jit);
+            else
+                emit_reg_ptr(jit, i8080_reg_offset[src]);
+            emit_call(jit, (void *)alu_table[dst]);
+        }else if((op & 0xC7) == 0xC6){ // ALU A,D8
+            emit8(jit, 0xC6); emit8(jit, 0x04); emit8(jit, 0x24); emit8(jit, d8); // mov byte [rsp], d8
+            emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xE6);                 // mov rsi, rsp
+            emit_call(jit, (void *)alu_table[dst]);
+        }else if((op & 0xC7) == 0x06 && dst != 6){ // MVI r,D8
+            emit_store_imm8(jit, i8080_reg_offset[dst], d8);
+        }else if((op & 0xC6) == 0x04 && dst != 6){ // INR/DCR r
+            emit_reg_ptr(jit, i8080_reg_offset[dst]);
+            emit_call(jit, (op & 1) ? (void *)dcr : (void *)inr);
+        }else if((op & 0xCF) == 0x01){ // LXI rp,D16
+            emit_store_imm16(jit, pair_offset[op >> 4], d16);
+        }else if((op & 0xC7) == 0x03){ // INX/DCX rp
+            emit8(jit, 0x66); emit8(jit, 0xFF);
+            emit_rbx_mem(jit, (op & 0x08) ? 1 : 0, pair_offset[op >> 4]); // inc/dec word [rbx + rp]
+        }else if(op == 0xC3){ // JMP
+            emit_exit_static(jit, d16, cycles);
+            break;
+        }else if((op & 0xC7) == 0xC2){ // Jcc
+            skip = emit_condition(jit, dst);
+            emit_exit_static(jit, d16, cycles);
+            patch_rel32(skip, jit->code_ptr);
+            emit_exit_static(jit, next, cycles);
+            break;
+        }else if(op == 0xCD || (op & 0xC7) == 0xC4){ // CALL / Ccc
+            uint32_t taken = cycles;
+            skip = NULL;
+            if(op != 0xCD){
+                skip = emit_condition(jit, dst);
+                taken += I8080_COND_TAKEN_CYCLES;
+            }
+            emit_store_imm16(jit, OFF(pc), pc + 1); //call() returns to PC + 2
+            emit8(jit, 0xBE); emit32(jit, d16);     // mov esi, d16
+            emit_call(jit, (void *)call);
+            emit_dirty_check(jit, taken, -1);
+            emit_exit_static(jit, d16, taken);
+            if(skip != NULL){
+                patch_rel32(skip, jit->code_ptr);
+                emit_exit_static(jit, next, cycles);
+            }
+            break;
+        }else if(op == 0xC9 || (op & 0xC7) == 0xC0){ // RET / Rcc
+            uint32_t taken = cycles;
+            skip = NULL;
+            if(op != 0xC9){
+                skip = emit_condition(jit, dst);
+                taken += I8080_COND_TAKEN_CYCLES;
+            }
+            emit_call(jit, (void *)ret);
+            emit_exit_dynamic(jit, taken);
+            if(skip != NULL){
+                patch_rel32(skip, jit->code_ptr);
+                emit_exit_static(jit, next, cycles);
+            }
+            break;
+        }else if(op == 0xE9){ // PCHL
+            emit_load_hl(jit);
+            emit8(jit, 0x66); emit8(jit, 0x89); emit_rbx_mem(jit, 0, OFF(pc)); // mov [rbx + pc], ax
+            emit_exit_dynamic(jit, cycles);
+            break;
+        }else if((op & 0xC7) == 0x00){
+            // NOP
+        }else{
+            // Anything else runs on the interpreter, which counts its own cycles
+            cycles -= i8080_cycle_table[op];
+            emit_store_imm16(jit, OFF(pc), pc);
+            emit_call(jit, (void *)run_instruction);
+            emit_dirty_check(jit, cycles, -1);
+        }
+        pc = next;
+    }
+
+    jit->block[start_pc] = entry;
+    jit->block_list[jit->block_count++] = start_pc;
+    jit->blocks_translated++;
+    return entry;
+}
+
+int jit_init(i8080_state_t *cpu){
+    i8080_jit_t *jit = calloc(1, sizeof(*jit));
+    if(jit == NULL){
+        return I8080_ERROR;
+    }
+    jit->code = mmap(NULL, I8080_JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(jit->code == MAP_FAILED){
+        free(jit);
+        return I8080_ERROR;
+    }
+    emit_stubs(jit);
+    jit->enabled = 1;
+    cpu->jit = jit;
+    return I8080_OK;
+}
+
+void jit_free(i8080_state_t *cpu){
+    i8080_jit_t *jit = cpu->jit;
+    if(jit == NULL)
+        return;
+    if(jit->shadow != NULL){
+#ifdef I8080_DECODE_CACHE
+        free_decode_cache(jit->shadow);
+#endif
+        destroy_cpu(jit->shadow);
+    }
+    munmap(jit->code, I8080_JIT_CODE_SIZE);
+    free(jit);
+    cpu->jit = NULL;
+}
+
+/* Drop every translation */
+void jit_flush(i8080_jit_t *jit){
+    for(uint32_t i = 0; i < jit->block_count; i++){
+        jit->block[jit->block_list[i]] = NULL;
+    }
+    jit->block_count = 0;
+    memset(jit->code_map, 0, sizeof(jit->code_map));
+    jit->code_ptr = jit->code_start;
+    jit->generation++;
+    jit->flushes++;
+}
+
+/* Translate the block at addr ahead of time, e.g. from a code map. Returns
+   I8080_ERROR if addr cannot start a block */
+int jit_translate(i8080_state_t *cpu, uint16_t addr){
+    i8080_jit_t *jit = cpu->jit;
+    if(jit == NULL || !translatable(cpu, addr) || is_barrier(read_memory(cpu, addr)))
+        return I8080_ERROR;
+    if(jit->block[addr] == NULL)
+        translate_block(cpu, addr);
+    return I8080_OK;
+}
+
+/* Called by the store path when translated code is overwritten */
+void jit_invalidate(i8080_state_t *cpu, uint16_t addr){
+    (void)addr;
+    jit_flush(cpu->jit);
+    cpu->jit->dirty = 1;
+}
+
+void jit_enable(i8080_state_t *cpu, uint8_t enable){
+    if(cpu->jit == NULL)
+        return;
+    if(enable && !cpu->jit->enabled)
+        jit_flush(cpu->jit); //Memory may have changed while the interpreter ran
+    cpu->jit->enabled = enable;
+}
+
+/* Verify mode: copy the state the block starts from into the shadow CPU */
+static int verify_begin(i8080_state_t *cpu){
+    i8080_jit_t *jit = cpu->jit;
+    i8080_state_t *shadow = jit->shadow;
+    i8080_arena_t *arena;
+    uint8_t *memory;
+
+    if(shadow == NULL){
+        if((shadow = create_cpu(0)) == NULL){
+            return I8080_ERROR;
+        }
+#ifdef I8080_DECODE_CACHE
+        if(init_decode_cache(shadow) != I8080_OK){
+            destroy_cpu(shadow);
+            return I8080_ERROR;
+        }
+#endif
+        jit->shadow = shadow;
+    }
+    memory = shadow->memory;
+    arena = shadow->arena;
+#ifdef I8080_DECODE_CACHE
+    i8080_decoded_t *decode_cache = shadow->decode_cache;
+    memset(decode_cache, 0, (I8080_MAX_ADDRESS + 1) * sizeof(i8080_decoded_t));
+#endif
+    *shadow = *cpu;
+    shadow->memory = memory;
+    shadow->arena = arena;
+    shadow->jit = NULL;
+    shadow->rom_image = NULL;
+#ifdef I8080_TRACE
+    shadow->trace = NULL;
+#endif
+#ifdef I8080_CALL_PROFILE
+    shadow->call_profile = NULL;
+#endif
+#ifdef I8080_DECODE_CACHE
+    shadow->decode_cache = decode_cache;
+#endif
+    memcpy(shadow->memory, cpu->memory, I8080_MAX_MEMORY_SIZE);
+    clone_memory_map(shadow, cpu);
+    return I8080_OK;
+}
+
+/* Verify mode: step the shadow CPU on the interpreter to the same cycle and compare */
+static int verify_end(i8080_state_t *cpu, uint16_t block_pc){
+    i8080_state_t *shadow = cpu->jit->shadow;
+
+    while(shadow->cycles < cpu->cycles){
+        run_instruction(shadow);
+    }
+    if(shadow->cycles != cpu->cycles || shadow->pc != cpu->pc || shadow->sp != cpu->sp ||
+       shadow->a != cpu->a || shadow->b != cpu->b || shadow->c != cpu->c || shadow->d != cpu->d ||
+       shadow->e != cpu->e || shadow->h != cpu->h || shadow->l != cpu->l ||
+       get_flags(shadow) != get_flags(cpu) ||
+       memcmp(shadow->memory, cpu->memory, I8080_MAX_MEMORY_SIZE) != 0){
+        fprintf(stderr, "[ERROR]: JIT block at %04X diverged from interpreter (PC %04X vs %04X, cycles %llu vs %llu)\n",
+                block_pc, cpu->pc, shadow->pc, (unsigned long long)cpu->cycles, (unsigned long long)shadow->cycles);
+        return I8080_ERROR;
+    }
+    return I8080_OK;
+}
+
+/* Run translated blocks until cpu->cycles reaches target, or the CPU halts.
+   Blocks run to completion, so the overshoot can be up to one block */
+static int run_blocks(i8080_state_t *cpu, uint64_t target){
+    i8080_jit_t *jit = cpu->jit;
+    jit_enter_fn enter = (jit_enter_fn)(void *)jit->code;
+    uint8_t *site = NULL;
+    uint32_t site_generation = 0;
+
+    while(cpu->cycles < target){
+        uint16_t block_pc = cpu->pc;
+        uint8_t *code = jit->block[block_pc];
+
+        if(code == NULL){
+            if(!translatable(cpu, block_pc) || is_barrier(read_memory(cpu, block_pc))){
+                run_instruction(cpu);
+                jit->dirty = 0;
+                site = NULL;
+                if(cpu->int_request && cpu->int_enable){
+                    run_instruction(cpu); //EI: the scheduler takes the interrupt after the next instruction
+                    break;
+                }
+                if(cpu->halted){
+                    break;
+                }
+                continue;
+            }
+            code = translate_block(cpu, block_pc);
+        }
+        if(site != NULL && site_generation == jit->generation){
+            patch_rel32(site + 1, code);
+            jit->chains++;
+        }
+        if(jit->verify && verify_begin(cpu) != I8080_OK){
+            return I8080_ERROR;
+        }
+
+        site = enter(cpu, target, code, &jit->dirty);
+        site_generation = jit->generation;
+        jit->dirty = 0;
+
+        if(jit->verify && verify_end(cpu, block_pc) != I8080_OK){
+            jit->enabled = 0;
+            return I8080_ERROR;
+        }
+    }
+    return I8080_OK;
+}
+
+/* Execute at least [budget] cycles on translated code, firing scheduled
+   events between blocks */
+int run_cycles_jit(i8080_state_t *cpu, uint32_t budget){
+    uint64_t end = cpu->cycles + budget;
+
+    if(cpu->jit == NULL || !cpu->jit->enabled){
+        return run_cycles(cpu, budget);
+    }
+    while(cpu->cycles < end){
+        if(run_blocks(cpu, schedule_slice(cpu, end)) != I8080_OK){
+            return I8080_ERROR;
+        }
+    }
+    return I8080_OK;
+}
+
+#else
+
+/* No code generator for this host, the interpreter is always used */
+int jit_init(i8080_state_t *cpu){
+    cpu->jit = NULL;
+    return I8080_ERROR;
+}
+
+void jit_free(i8080_state_t *cpu){
+    cpu->jit = NULL;
+}
+
+void jit_enable(i8080_state_t *cpu, uint8_t enable){
+    (void)cpu;
+    (void)enable;
+}
+
+void jit_flush(i8080_jit_t *jit){
+    (void)jit;
+}
+
+void jit_invalidate(i8080_state_t *cpu, uint16_t addr){
+    (void)cpu;
+    (void)addr;
+}
+
+int jit_translate(i8080_state_t *cpu, uint16_t addr){
+    (void)cpu;
+    (void)addr;
+    return I8080_ERROR;
+}
+
+int run_cycles_jit(i8080_state_t *cpu, uint32_t budget){
+    return run_cycles(cpu, budget);
+}
+
+#endif
+#endif
@@ -0,0 +1,531 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+#include "../include/i8080_lockstep.h"
+
+#define LANES I8080_LOCKSTEP_LANES
+#define REG_A (7)
+#define REG_M (6)
+
+typedef i8080_lane8_t v8;
+typedef i8080_lane16_t v16;
+typedef i8080_lane64_t v64;
+
+/* Lane masks, all ones where the lane takes part */
+typedef int8_t m8 __attribute__((vector_size(LANES)));
+typedef int16_t m16 __attribute__((vector_size(LANES * 2)));
+typedef int64_t m64 __attribute__((vector_size(LANES * 8)));
+
+#define WIDEN(x) __builtin_convertvector((x), v16)
+#define NARROW(x) __builtin_convertvector((x), v8)
+
+static inline v8 blend8(v8 old, v8 value, m8 mask){
+    return (old & ~(v8)mask) | (value & (v8)mask);
+}
+
+static inline v16 blend16(v16 old, v16 value, m8 mask){
+    v16 wide = (v16)__builtin_convertvector(mask, m16);
+    return (old & ~wide) | (value & wide);
+}
+
+/* Sign, Zero and Parity of each lane's result plus the fixed PSW bit, as szp_table */
+static inline v8 szp(v8 result){
+    v8 parity = result ^ (result >> 4);
+    parity ^= parity >> 2;
+    parity ^= parity >> 1;
+    return (result & FLAG_S) | ((v8)(result == 0) & FLAG_Z) | ((~parity & 1) << 2) | I8080_FLAGS_DEFAULT;
+}
+
+/* Op-codes left to the interpreter: I/O, interrupt state, HLT, RST and DAA */
+static int interpreted(uint8_t op){
+    return op == 0x27 || op == 0x76 || op == 0xD3 || op == 0xDB || op == 0xF3 || op == 0xFB || (op & 0xC7) == 0xC7;
+}
+
+static void load_lane(i8080_lockstep_t *group, uint32_t lane){
+    i8080_state_t *cpu = group->cpu[lane];
+    for(int r = 0; r < 8; r++){
+        if(r != REG_M)
+            group->reg[r][lane] = I8080_REG(cpu, r);
+    }
+    group->flags[lane] = get_flags(cpu);
+    group->sp[lane] = cpu->sp;
+    group->pc[lane] = cpu->pc;
+    group->cycles[lane] = cpu->cycles;
+}
+
+static void store_lane(i8080_lockstep_t *group, uint32_t lane){
+    i8080_state_t *cpu = group->cpu[lane];
+    for(int r = 0; r < 8; r++){
+        if(r != REG_M)
+            I8080_REG(cpu, r) = group->reg[r][lane];
+    }
+    cpu->flags = group->flags[lane];
+#ifdef I8080_LAZY_FLAGS
+    cpu->lazy.op = LAZY_NONE;
+#endif
+    cpu->sp = group->sp[lane];
+    cpu->pc = group->pc[lane];
+    cpu->cycles = group->cycles[lane];
+}
+
+/* Op-code at addr, -1 if its page has to be read through MMIO handlers */
+static int fetch_op(i8080_state_t *cpu, uint16_t addr){
+    uint8_t *page = cpu->map.read[addr >> I8080_PAGE_SHIFT];
+    return page != NULL ? page[addr & (I8080_PAGE_SIZE - 1)] : -1;
+}
+
+/* Byte at addr, straight from its page unless that is read through MMIO handlers */
+static inline uint8_t read_lane(i8080_state_t *cpu, uint16_t addr){
+    uint8_t *page = cpu->map.read[addr >> I8080_PAGE_SHIFT];
+    return page != NULL ? page[addr & (I8080_PAGE_SIZE - 1)] : read_memory(cpu, addr);
+}
+
+/* Per lane memory access, only for the lanes in mask */
+static v8 load8(i8080_lockstep_t *group, v16 addr, m8 mask){
+    v8 value = {0};
+    for(uint32_t i = 0; i < group->lanes; i++){
+        if(mask[i])
+            value[i] = read_lane(group->cpu[i], addr[i]);
+    }
+    return value;
+}
+
+static void store8(i8080_lockstep_t *group, v16 addr, v8 value, m8 mask){
+    for(uint32_t i = 0; i < group->lanes; i++){
+        if(mask[i])
+            write_memory(group->cpu[i], addr[i], value[i]);
+    }
+}
+
+static v16 load16(i8080_lockstep_t *group, v16 addr, m8 mask){
+    v16 value = {0};
+    for(uint32_t i = 0; i < group->lanes; i++){
+        if(mask[i]){
+            uint8_t lo = read_lane(group->cpu[i], addr[i]);
+            value[i] = read_lane(group->cpu[i], addr[i] + 1) << 8 | lo;
+        }
+    }
+    return value;
+}
+
+static void store16(i8080_lockstep_t *group, v16 addr, v16 value, m8 mask){
+    for(uint32_t i = 0; i < group->lanes; i++){
+        if(mask[i]){
+            write_memory(group->cpu[i], addr[i], value[i] & 0xff);
+            write_memory(group->cpu[i], addr[i] + 1, value[i] >> 8);
+        }
+    }
+}
+
+static void push16(i8080_lockstep_t *group, v16 value, m8 mask){
+    group->sp = blend16(group->sp, group->sp - 2, mask);
+    store16(group, group->sp, value, mask);
+}
+
+static v16 pop16(i8080_lockstep_t *group, m8 mask){
+    v16 value = load16(group, group->sp, mask);
+    group->sp = blend16(group->sp, group->sp + 2, mask);
+    return value;
+}
+
+/* Register pair by the op-code pair field: BC DE HL SP, or PSW for PUSH/POP */
+static v16 get_pair(i8080_lockstep_t *group, int pair, int psw){
+    if(pair == 3)
+        return psw ? WIDEN(group->reg[REG_A]) << 8 | WIDEN(group->flags) : group->sp;
+    return WIDEN(group->reg[pair * 2]) << 8 | WIDEN(group->reg[pair * 2 + 1]);
+}
+
+static void set_pair(i8080_lockstep_t *group, int pair, int psw, v16 value, m8 mask){
+    if(pair == 3 && !psw){
+        group->sp = blend16(group->sp, value, mask);
+    }else if(pair == 3){
+        group->reg[REG_A] = blend8(group->reg[REG_A], NARROW(value >> 8), mask);
+        group->flags = blend8(group->flags, (NARROW(value) & FLAG_ALL) | I8080_FLAGS_DEFAULT, mask);
+    }else{
+        group->reg[pair * 2] = blend8(group->reg[pair * 2], NARROW(value >> 8), mask);
+        group->reg[pair * 2 + 1] = blend8(group->reg[pair * 2 + 1], NARROW(value), mask);
+    }
+}
+
+/* Lanes where the 3-bit condition code holds: NZ Z NC C PO PE P M */
+static m8 condition(i8080_lockstep_t *group, uint8_t cc){
+    static const uint8_t flag[4] = {FLAG_Z, FLAG_C, FLAG_P, FLAG_S};
+    m8 set = (group->flags & flag[cc >> 1]) != 0;
+    return (cc & 1) ? set : ~set;
+}
+
+/* Register or M operand by the op-code register field */
+static v8 read_operand(i8080_lockstep_t *group, int reg, m8 mask){
+    return reg == REG_M ? load8(group, get_pair(group, 2, 0), mask) : group->reg[reg];
+}
+
+static void write_operand(i8080_lockstep_t *group, int reg, v8 value, m8 mask){
+    if(reg == REG_M)
+        store8(group, get_pair(group, 2, 0), value, mask);
+    else
+        group->reg[reg] = blend8(group->reg[reg], value, mask);
+}
+
+/* ADD ADC SUB SBB ANA XRA ORA CMP with the flags the interpreter computes */
+static void alu(i8080_lockstep_t *group, int kind, v8 b, m8 mask){
+    v8 a = group->reg[REG_A];
+    v8 carry = group->flags & FLAG_C;
+    v8 result, flags;
+
+    switch(kind){
+        case 0: // ADD
+        case 1: // ADC
+            {
+                v16 sum = WIDEN(a) + WIDEN(b) + (kind == 1 ? WIDEN(carry) : (v16){0});
+                result = NARROW(sum);
+                flags = szp(result) | (NARROW(sum >> 8) & FLAG_C) | ((a ^ b ^ result) & FLAG_AC);
+            }
+            break;
+        case 2: // SUB
+        case 3: // SBB
+        case 7: // CMP
+            {
+                v16 difference = WIDEN(a) - WIDEN(b) - (kind == 3 ? WIDEN(carry) : (v16){0});
+                result = NARROW(difference);
+                flags = szp(result) | (NARROW(difference >> 8) & FLAG_C) | ((a ^ ~b ^ result) & FLAG_AC);
+            }
+            break;
+        case 4: // ANA
+            result = a & b;
+            flags = szp(result) | (((a | b) & 0x08) << 1);
+            break;
+        case 5: // XRA
+            result = a ^ b;
+            flags = szp(result);
+            break;
+        default: // ORA
+            result = a | b;
+            flags = szp(result);
+            break;
+    }
+    if(kind != 7)
+        group->reg[REG_A] = blend8(a, result, mask);
+    group->flags = blend8(group->flags, flags, mask);
+}
+
+/* Run op on the lanes in mask. PC already points past the instruction */
+static void execute_lanes(i8080_lockstep_t *group, uint8_t op, v8 d8, v16 d16, m8 mask){
+    int reg = (op >> 3) & 7;
+    int pair = (op >> 4) & 3;
+    v8 a = group->reg[REG_A];
+    v8 flags = group->flags;
+
+    if(op >= 0x40 && op <= 0x7F){ // MOV
+        write_operand(group, reg, read_operand(group, op & 7, mask), mask);
+    }else if(op >= 0x80 && op <= 0xBF){ // ALU r
+        alu(group, reg, read_operand(group, op & 7, mask), mask);
+    }else if((op & 0xC7) == 0xC6){ // ALU d8
+        alu(group, reg, d8, mask);
+    }else if((op & 0xC7) == 0x06){ // MVI
+        write_operand(group, reg, d8, mask);
+    }else if((op & 0xC7) == 0x04){ // INR
+        v8 result = read_operand(group, reg, mask) + 1;
+        group->flags = blend8(flags, (flags & FLAG_C) | szp(result) | ((v8)((result & 0x0f) == 0) & FLAG_AC), mask);
+        write_operand(group, reg, result, mask);
+    }else if((op & 0xC7) == 0x05){ // DCR
+        v8 result = read_operand(group, reg, mask) - 1;
+        group->flags = blend8(flags, (flags & FLAG_C) | szp(result) | ((v8)((result & 0x0f) != 0x0f) & FLAG_AC), mask);
+        write_operand(group, reg, result, mask);
+    }else if((op & 0xCF) == 0x01){ // LXI
+        set_pair(group, pair, 0, d16, mask);
+    }else if((op & 0xCF) == 0x03){ // INX
+        set_pair(group, pair, 0, get_pair(group, pair, 0) + 1, mask);
+    }else if((op & 0xCF) == 0x0B){ // DCX
+        set_pair(group, pair, 0, get_pair(group, pair, 0) - 1, mask);
+    }else if((op & 0xCF) == 0x09){ // DAD
+        v16 hl = get_pair(group, 2, 0);
+        v16 sum = hl + get_pair(group, pair, 0);
+        group->flags = blend8(flags, (flags & ~FLAG_C) | (NARROW((v16)(sum < hl)) & FLAG_C), mask);
+        set_pair(group, 2, 0, sum, mask);
+    }else if((op & 0xCF) == 0xC5){ // PUSH
+        push16(group, get_pair(group, pair, 1), mask);
+    }else if((op & 0xCF) == 0xC1){ // POP
+        set_pair(group, pair, 1, pop16(group, mask), mask);
+    }else if(op == 0xC3 || (op & 0xC7) == 0xC2){ // JMP, Jcc
+        m8 taken = op == 0xC3 ? mask : condition(group, reg) & mask;
+        group->pc = blend16(group->pc, d16, taken);
+    }else if(op == 0xCD || (op & 0xC7) == 0xC4){ // CALL, Ccc
+        m8 taken = mask;
+        if(op != 0xCD){
+            taken &= condition(group, reg);
+            group->cycles += (v64)__builtin_convertvector(taken, m64) & I8080_COND_TAKEN_CYCLES;
+        }
+        push16(group, group->pc, taken);
+        group->pc = blend16(group->pc, d16, taken);
+    }else if(op == 0xC9 || (op & 0xC7) == 0xC0){ // RET, Rcc
+        m8 taken = mask;
+        if(op != 0xC9){
+            taken &= condition(group, reg);
+            group->cycles += (v64)__builtin_convertvector(taken, m64) & I8080_COND_TAKEN_CYCLES;
+        }
+        group->pc = blend16(group->pc, pop16(group, taken), taken);
+    }else{
+        switch(op){
+            case 0x02: // STAX B
+            case 0x12: // STAX D
+                store8(group, get_pair(group, pair, 0), a, mask);
+                break;
+            case 0x0A: // LDAX B
+            case 0x1A: // LDAX D
+                group->reg[REG_A] = blend8(a, load8(group, get_pair(group, pair, 0), mask), mask);
+                break;
+            case 0x22: // SHLD
+                store16(group, d16, get_pair(group, 2, 0), mask);
+                break;
+            case 0x2A: // LHLD
+                set_pair(group, 2, 0, load16(group, d16, mask), mask);
+                break;
+            case 0x32: // STA
+                store8(group, d16, a, mask);
+                break;
+            case 0x3A: // LDA
+                group->reg[REG_A] = blend8(a, load8(group, d16, mask), mask);
+                break;
+            case 0x07: // RLC
+                group->flags = blend8(flags, (flags & ~FLAG_C) | (a >> 7), mask);
+                group->reg[REG_A] = blend8(a, (a << 1) | (a >> 7), mask);
+                break;
+            case 0x0F: // RRC
+                group->flags = blend8(flags, (flags & ~FLAG_C) | (a & 1), mask);
+                group->reg[REG_A] = blend8(a, (a >> 1) | (a << 7), mask);
+                break;
+            case 0x17: // RAL
+                group->flags = blend8(flags, (flags & ~FLAG_C) | (a >> 7), mask);
+                group->reg[REG_A] = blend8(a, (a << 1) | (flags & FLAG_C), mask);
+                break;
+            case 0x1F: // RAR
+                group->flags = blend8(flags, (flags & ~FLAG_C) | (a & 1), mask);
+                group->reg[REG_A] = blend8(a, (a >> 1) | ((flags & FLAG_C) << 7), mask);
+                break;
+            case 0x2F: // CMA
+                group->reg[REG_A] = blend8(a, ~a, mask);
+                break;
+            case 0x37: // STC
+                group->flags = blend8(flags, flags | FLAG_C, mask);
+                break;
+            case 0x3F: // CMC
+                group->flags = blend8(flags, flags ^ FLAG_C, mask);
+                break;
+            case 0xE3: // XTHL
+                {
+                    v16 hl = get_pair(group, 2, 0);
+                    set_pair(group, 2, 0, load16(group, group->sp, mask), mask);
+                    store16(group, group->sp, hl, mask);
+                }
+                break;
+            case 0xE9: // PCHL
+                group->pc = blend16(group->pc, get_pair(group, 2, 0), mask);
+                break;
+            case 0xF9: // SPHL
+                group->sp = blend16(group->sp, get_pair(group, 2, 0), mask);
+                break;
+            case 0xEB: // XCHG
+                {
+                    v16 de = get_pair(group, 1, 0);
+                    set_pair(group, 1, 0, get_pair(group, 2, 0), mask);
+                    set_pair(group, 2, 0, de, mask);
+                }
+                break;
+            default: // NOP and the undocumented NOPs
+                break;
+        }
+    }
+}
+
+/* Any lane set in mask */
+static inline int any_lane(m8 mask){
+    uint64_t word[LANES / 8], any = 0;
+    memcpy(word, &mask, sizeof(word));
+    for(int i = 0; i < LANES / 8; i++){
+        any |= word[i];
+    }
+    return any != 0;
+}
+
+static inline uint32_t count_lanes(m8 mask){
+    uint64_t word[LANES / 8];
+    uint32_t count = 0;
+    memcpy(word, &mask, sizeof(word));
+    for(int i = 0; i < LANES / 8; i++){
+        count += __builtin_popcountll(word[i]);
+    }
+    return count / 8;
+}
+
+/* Run the instruction at the lowest PC among the live lanes */
+static void step(i8080_lockstep_t *group, m8 live){
+    v16 live16 = (v16)__builtin_convertvector(live, m16);
+    v16 candidate = (group->pc & live16) | ~live16; //0xFFFF for lanes that wait
+    uint32_t lead = LANES, active, waiting = count_lanes(live);
+    uint16_t pc = 0xFFFF;
+    int op;
+    m8 mask;
+    v8 d8 = {0};
+    v16 d16 = {0};
+
+    for(int i = 0; i < LANES; i++){
+        pc = candidate[i] < pc ? candidate[i] : pc;
+    }
+    mask = live & __builtin_convertvector(group->pc == pc, m8);
+    for(uint32_t i = 0; i < group->lanes; i++){
+        if(mask[i]){
+            lead = i;
+            break;
+        }
+    }
+    op = fetch_op(group->cpu[lead], pc);
+    if(op < 0){
+        mask = (m8){0};
+        mask[lead] = -1; //Code on an MMIO page, the leader goes alone
+    }else{
+        for(uint32_t i = lead + 1; i < group->lanes; i++){
+            if(mask[i] && fetch_op(group->cpu[i], pc) != op)
+                mask[i] = 0;
+        }
+    }
+    active = count_lanes(mask);
+    group->steps++;
+    group->lane_steps += active;
+    group->live_steps += waiting;
+    if(active < waiting)
+        group->divergent_steps++;
+
+    if(op < 0 || interpreted(op)){
+        group->scalar_steps++;
+        for(uint32_t i = 0; i < group->lanes; i++){
+            i8080_state_t *cpu = group->cpu[i];
+            if(!mask[i])
+                continue;
+            store_lane(group, i);
+            run_instruction(cpu);
+            load_lane(group, i);
+            //Hand back to the scheduler where execute() would have: after HLT, or
+            //after EI with an interrupt pending, which run_instruction() has
+            //already carried through the one instruction that follows EI
+            if(cpu->halted || (op == 0xFB && cpu->int_request)){
+                group->target[i] = cpu->cycles;
+            }
+        }
+        return;
+    }
+
+    //Operand bytes may differ per lane
+    if(i8080_length_table[op] > 1){
+        for(uint32_t i = 0; i < group->lanes; i++){
+            if(mask[i]){
+                i8080_state_t *cpu = group->cpu[i];
+                uint8_t lo = read_lane(cpu, pc + 1);
+                d8[i] = lo;
+                d16[i] = i8080_length_table[op] > 2 ? read_lane(cpu, pc + 2) << 8 | lo : lo;
+            }
+        }
+    }
+    group->pc = blend16(group->pc, group->pc + i8080_length_table[op], mask);
+    group->cycles += (v64)__builtin_convertvector(mask, m64) & i8080_cycle_table[op];
+    execute_lanes(group, op, d8, d16, mask);
+}
+
+/* Bind up to I8080_LOCKSTEP_LANES instances to a group */
+int init_lockstep(i8080_lockstep_t *group, i8080_state_t **cpus, uint32_t count){
+    if(count == 0 || count > LANES){
+        fprintf(stderr, "[ERROR]: A lockstep group holds 1 to %d instances, not %u\n", LANES, count);
+        return I8080_ERROR;
+    }
+    memset(group, 0, sizeof(*group));
+    for(uint32_t i = 0; i < count; i++){
+        group->cpu[i] = cpus[i];
+    }
+    group->lanes = count;
+    return I8080_OK;
+}
+
+/* Run every lane for at least [budget] cycles, as run_cycles() would on each */
+int run_lockstep(i8080_lockstep_t *group, uint32_t budget){
+    v64 end = {0}; //Unused lanes are never live
+
+    for(uint32_t i = 0; i < LANES; i++){
+        group->cycles[i] = 0;
+        group->target[i] = 0;
+        if(i < group->lanes){
+            i8080_state_t *cpu = group->cpu[i];
+            end[i] = cpu->cycles + budget;
+            group->target[i] = schedule_slice(cpu, end[i]);
+            load_lane(group, i);
+        }
+    }
+
+    for(;;){
+        m64 live = group->cycles < group->target;
+        m8 due = __builtin_convertvector(~live & (group->cycles < end), m8);
+        if(any_lane(due)){
+            //At their targets: fire the events due and go on to the next one
+            for(uint32_t i = 0; i < group->lanes; i++){
+                if(due[i]){
+                    store_lane(group, i);
+                    group->target[i] = schedule_slice(group->cpu[i], end[i]);
+                    load_lane(group, i);
+                }
+            }
+            continue;
+        }
+        if(!any_lane(__builtin_convertvector(live, m8)))
+            break;
+        step(group, __builtin_convertvector(live, m8));
+    }
+
+    for(uint32_t i = 0; i < group->lanes; i++){
+        store_lane(group, i);
+    }
+    return I8080_OK;
+}
+
+static int compare_pc(const void *a, const void *b){
+    const i8080_state_t *x = *(i8080_state_t *const *)a;
+    const i8080_state_t *y = *(i8080_state_t *const *)b;
+    if(x->pc != y->pc)
+        return x->pc < y->pc ? -1 : 1;
+    return x < y ? -1 : x > y; //Stable for instances at the same PC
+}
+
+/* Re-deal the instances of [count] groups so that instances at the same PC
+   share a group. Each group keeps its number of lanes */
+void regroup_lockstep(i8080_lockstep_t *groups, uint32_t count){
+    i8080_state_t **cpus;
+    uint32_t total = 0, next = 0;
+
+    for(uint32_t g = 0; g < count; g++){
+        total += groups[g].lanes;
+    }
+    if((cpus = malloc(total * sizeof(*cpus))) == NULL){
+        return; //Grouping is only an optimization
+    }
+    for(uint32_t g = 0; g < count; g++){
+        for(uint32_t i = 0; i < groups[g].lanes; i++)
+            cpus[next++] = groups[g].cpu[i];
+    }
+    qsort(cpus, total, sizeof(*cpus), compare_pc);
+    next = 0;
+    for(uint32_t g = 0; g < count; g++){
+        for(uint32_t i = 0; i < groups[g].lanes; i++)
+            groups[g].cpu[i] = cpus[next++];
+    }
+    free(cpus);
+}
+
+void display_lockstep_stats(i8080_lockstep_t *group){
+    printf("Lockstep lanes: %u of %d\n", group->lanes, LANES);
+    printf("Lockstep steps: %llu, %llu interpreted, %llu divergent\n", (unsigned long long)group->steps,
+           (unsigned long long)group->scalar_steps, (unsigned long long)group->divergent_steps);
+    printf("Lane utilization: %.1f%% of lanes, %.1f%% of lanes with cycles left\n",
+           group->steps ? 100.0 * group->lane_steps / ((double)group->steps * group->lanes) : 0.0,
+           group->live_steps ? 100.0 * group->lane_steps / group->live_steps : 0.0);
+}
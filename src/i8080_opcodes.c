@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+
+/* Op-code tables shared by the cores, the recompiler and the disassembly
+   tools, which link this file on its own */
+
+/* Cycle cost of each op-code. Conditional CALL/RET entries hold the
+   not-taken cost, I8080_COND_TAKEN_CYCLES is added when they branch */
+const uint8_t i8080_cycle_table[256] = {
+//  x0  x1  x2  x3  x4  x5  x6  x7  x8  x9  xA  xB  xC  xD  xE  xF
+     4, 10,  7,  5,  5,  5,  7,  4,  4, 10,  7,  5,  5,  5,  7,  4, // 0x
+     4, 10,  7,  5,  5,  5,  7,  4,  4, 10,  7,  5,  5,  5,  7,  4, // 1x
+     4, 10, 16,  5,  5,  5,  7,  4,  4, 10, 16,  5,  5,  5,  7,  4, // 2x
+     4, 10, 13,  5, 10, 10, 10,  4,  4, 10, 13,  5,  5,  5,  7,  4, // 3x
+     5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 4x
+     5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 5x
+     5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 6x
+     7,  7,  7,  7,  7,  7,  7,  7,  5,  5,  5,  5,  5,  5,  7,  5, // 7x
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // 8x
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // 9x
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // Ax
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // Bx
+     5, 10, 10, 10, 11, 11,  7, 11,  5, 10, 10, 10, 11, 17,  7, 11, // Cx
+     5, 10, 10, 10, 11, 11,  7, 11,  5, 10, 10, 10, 11, 17,  7, 11, // Dx
+     5, 10, 10, 18, 11, 11,  7, 11,  5,  5, 10,  4, 11, 17,  7, 11, // Ex
+     5, 10, 10,  4, 11, 11,  7, 11,  5,  5, 10,  4, 11, 17,  7, 11  // Fx
+};
+
+/* Length in bytes of each op-code, including operands */
+const uint8_t i8080_length_table[256] = {
+//  x0 x1 x2 x3 x4 x5 x6 x7 x8 x9 xA xB xC xD xE xF
+    1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x
+    1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 1x
+    1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1, // 2x
+    1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1, // 3x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 4x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 5x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 6x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 7x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 8x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 9x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // Ax
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // Bx
+    1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1, // Cx
+    1, 1, 3, 2, 3, 1, 2, 1, 1, 1, 3, 2, 3, 1, 2, 1, // Dx
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1, // Ex
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1  // Fx
+};
+
+/* Mnemonic, fixed arguments and immediate operand of each op-code, as the
+   core runs them: the undocumented op-codes are NOPs */
+const i8080_opcode_t i8080_opcode_table[256] = {
+    // 00
+    {"NOP", "", I8080_OPERAND_NONE}, {"LXI", "B", I8080_OPERAND_D16}, {"STAX", "B", I8080_OPERAND_NONE}, {"INX", "B", I8080_OPERAND_NONE},
+    {"INR", "B", I8080_OPERAND_NONE}, {"DCR", "B", I8080_OPERAND_NONE}, {"MVI", "B", I8080_OPERAND_D8}, {"RLC", "", I8080_OPERAND_NONE},
+    // 08
+    {"NOP", "", I8080_OPERAND_NONE}, {"DAD", "B", I8080_OPERAND_NONE}, {"LDAX", "B", I8080_OPERAND_NONE}, {"DCX", "B", I8080_OPERAND_NONE},
+    {"INR", "C", I8080_OPERAND_NONE}, {"DCR", "C", I8080_OPERAND_NONE}, {"MVI", "C", I8080_OPERAND_D8}, {"RRC", "", I8080_OPERAND_NONE},
+    // 10
+    {"NOP", "", I8080_OPERAND_NONE}, {"LXI", "D", I8080_OPERAND_D16}, {"STAX", "D", I8080_OPERAND_NONE}, {"INX", "D", I8080_OPERAND_NONE},
+    {"INR", "D", I8080_OPERAND_NONE}, {"DCR", "D", I8080_OPERAND_NONE}, {"MVI", "D", I8080_OPERAND_D8}, {"RAL", "", I8080_OPERAND_NONE},
+    // 18
+    {"NOP", "", I8080_OPERAND_NONE}, {"DAD", "D", I8080_OPERAND_NONE}, {"LDAX", "D", I8080_OPERAND_NONE}, {"DCX", "D", I8080_OPERAND_NONE},
+    {"INR", "E", I8080_OPERAND_NONE}, {"DCR", "E", I8080_OPERAND_NONE}, {"MVI", "E", I8080_OPERAND_D8}, {"RAR", "", I8080_OPERAND_NONE},
+    // 20
+    {"NOP", "", I8080_OPERAND_NONE}, {"LXI", "H", I8080_OPERAND_D16}, {"SHLD", "", I8080_OPERAND_A16}, {"INX", "H", I8080_OPERAND_NONE},
+    {"INR", "H", I8080_OPERAND_NONE}, {"DCR", "H", I8080_OPERAND_NONE}, {"MVI", "H", I8080_OPERAND_D8}, {"DAA", "", I8080_OPERAND_NONE},
+    // 28
+    {"NOP", "", I8080_OPERAND_NONE}, {"DAD", "H", I8080_OPERAND_NONE}, {"LHLD", "", I8080_OPERAND_A16}, {"DCX", "H", I8080_OPERAND_NONE},
+    {"INR", "L", I8080_OPERAND_NONE}, {"DCR", "L", I8080_OPERAND_NONE}, {"MVI", "L", I8080_OPERAND_D8}, {"CMA", "", I8080_OPERAND_NONE},
+    // 30
+    {"NOP", "", I8080_OPERAND_NONE}, {"LXI", "SP", I8080_OPERAND_D16}, {"STA", "", I8080_OPERAND_A16}, {"INX", "SP", I8080_OPERAND_NONE},
+    {"INR", "M", I8080_OPERAND_NONE}, {"DCR", "M", I8080_OPERAND_NONE}, {"MVI", "M", I8080_OPERAND_D8}, {"STC", "", I8080_OPERAND_NONE},
+    // 38
+    {"NOP", "", I8080_OPERAND_NONE}, {"DAD", "SP", I8080_OPERAND_NONE}, {"LDA", "", I8080_OPERAND_A16}, {"DCX", "SP", I8080_OPERAND_NONE},
+    {"INR", "A", I8080_OPERAND_NONE}, {"DCR", "A", I8080_OPERAND_NONE}, {"MVI", "A", I8080_OPERAND_D8}, {"CMC", "", I8080_OPERAND_NONE},
+    // 40
+    {"MOV", "B,B", I8080_OPERAND_NONE}, {"MOV", "B,C", I8080_OPERAND_NONE}, {"MOV", "B,D", I8080_OPERAND_NONE}, {"MOV", "B,E", I8080_OPERAND_NONE},
+    {"MOV", "B,H", I8080_OPERAND_NONE}, {"MOV", "B,L", I8080_OPERAND_NONE}, {"MOV", "B,M", I8080_OPERAND_NONE}, {"MOV", "B,A", I8080_OPERAND_NONE},
+    // 48
+    {"MOV", "C,B", I8080_OPERAND_NONE}, {"MOV", "C,C", I8080_OPERAND_NONE}, {"MOV", "C,D", I8080_OPERAND_NONE}, {"MOV", "C,E", I8080_OPERAND_NONE},
+    {"MOV", "C,H", I8080_OPERAND_NONE}, {"MOV", "C,L", I8080_OPERAND_NONE}, {"MOV", "C,M", I8080_OPERAND_NONE}, {"MOV", "C,A", I8080_OPERAND_NONE},
+    // 50
+    {"MOV", "D,B", I8080_OPERAND_NONE}, {"MOV", "D,C", I8080_OPERAND_NONE}, {"MOV", "D,D", I8080_OPERAND_NONE}, {"MOV", "D,E", I8080_OPERAND_NONE},
+    {"MOV", "D,H", I8080_OPERAND_NONE}, {"MOV", "D,L", I8080_OPERAND_NONE}, {"MOV", "D,M", I8080_OPERAND_NONE}, {"MOV", "D,A", I8080_OPERAND_NONE},
+    // 58
+    {"MOV", "E,B", I8080_OPERAND_NONE}, {"MOV", "E,C", I8080_OPERAND_NONE}, {"MOV", "E,D", I8080_OPERAND_NONE}, {"MOV", "E,E", I8080_OPERAND_NONE},
+    {"MOV", "E,H", I8080_OPERAND_NONE}, {"MOV", "E,L", I8080_OPERAND_NONE}, {"MOV", "E,M", I8080_OPERAND_NONE}, {"MOV", "E,A", I8080_OPERAND_NONE},
+    // 60
+    {"MOV", "H,B", I8080_OPERAND_NONE}, {"MOV", "H,C", I8080_OPERAND_NONE}, {"MOV", "H,D", I8080_OPERAND_NONE}, {"MOV", "H,E", I8080_OPERAND_NONE},
+    {"MOV", "H,H", I8080_OPERAND_NONE}, {"MOV", "H,L", I8080_OPERAND_NONE}, {"MOV", "H,M", I8080_OPERAND_NONE}, {"MOV", "H,A", I8080_OPERAND_NONE},
+    // 68
+    {"MOV", "L,B", I8080_OPERAND_NONE}, {"MOV", "L,C", I8080_OPERAND_NONE}, {"MOV", "L,D", I8080_OPERAND_NONE}, {"MOV", "L,E", I8080_OPERAND_NONE},
+    {"MOV", "L,H", I8080_OPERAND_NONE}, {"MOV", "L,L", I8080_OPERAND_NONE}, {"MOV", "L,M", I8080_OPERAND_NONE}, {"MOV", "L,A", I8080_OPERAND_NONE},
+    // 70
+    {"MOV", "M,B", I8080_OPERAND_NONE}, {"MOV", "M,C", I8080_OPERAND_NONE}, {"MOV", "M,D", I8080_OPERAND_NONE}, {"MOV", "M,E", I8080_OPERAND_NONE},
+    {"MOV", "M,H", I8080_OPERAND_NONE}, {"MOV", "M,L", I8080_OPERAND_NONE}, {"HLT", "", I8080_OPERAND_NONE}, {"MOV", "M,A", I8080_OPERAND_NONE},
+    // 78
+    {"MOV", "A,B", I8080_OPERAND_NONE}, {"MOV", "A,C", I8080_OPERAND_NONE}, {"MOV", "A,D", I8080_OPERAND_NONE}, {"MOV", "A,E", I8080_OPERAND_NONE},
+    {"MOV", "A,H", I8080_OPERAND_NONE}, {"MOV", "A,L", I8080_OPERAND_NONE}, {"MOV", "A,M", I8080_OPERAND_NONE}, {"MOV", "A,A", I8080_OPERAND_NONE},
+    // 80
+    {"ADD", "B", I8080_OPERAND_NONE}, {"ADD", "C", I8080_OPERAND_NONE}, {"ADD", "D", I8080_OPERAND_NONE}, {"ADD", "E", I8080_OPERAND_NONE},
+    {"ADD", "H", I8080_OPERAND_NONE}, {"ADD", "L", I8080_OPERAND_NONE}, {"ADD", "M", I8080_OPERAND_NONE}, {"ADD", "A", I8080_OPERAND_NONE},
+    // 88
+    {"ADC", "B", I8080_OPERAND_NONE}, {"ADC", "C", I8080_OPERAND_NONE}, {"ADC", "D", I8080_OPERAND_NONE}, {"ADC", "E", I8080_OPERAND_NONE},
+    {"ADC", "H", I8080_OPERAND_NONE}, {"ADC", "L", I8080_OPERAND_NONE}, {"ADC", "M", I8080_OPERAND_NONE}, {"ADC", "A", I8080_OPERAND_NONE},
+    // 90
+    {"SUB", "B", I8080_OPERAND_NONE}, {"SUB", "C", I8080_OPERAND_NONE}, {"SUB", "D", I8080_OPERAND_NONE}, {"SUB", "E", I8080_OPERAND_NONE},
+    {"SUB", "H", I8080_OPERAND_NONE}, {"SUB", "L", I8080_OPERAND_NONE}, {"SUB", "M", I8080_OPERAND_NONE}, {"SUB", "A", I8080_OPERAND_NONE},
+    // 98
+    {"SBB", "B", I8080_OPERAND_NONE}, {"SBB", "C", I8080_OPERAND_NONE}, {"SBB", "D", I8080_OPERAND_NONE}, {"SBB", "E", I8080_OPERAND_NONE},
+    {"SBB", "H", I8080_OPERAND_NONE}, {"SBB", "L", I8080_OPERAND_NONE}, {"SBB", "M", I8080_OPERAND_NONE}, {"SBB", "A", I8080_OPERAND_NONE},
+    // A0
+    {"ANA", "B", I8080_OPERAND_NONE}, {"ANA", "C", I8080_OPERAND_NONE}, {"ANA", "D", I8080_OPERAND_NONE}, {"ANA", "E", I8080_OPERAND_NONE},
+    {"ANA", "H", I8080_OPERAND_NONE}, {"ANA", "L", I8080_OPERAND_NONE}, {"ANA", "M", I8080_OPERAND_NONE}, {"ANA", "A", I8080_OPERAND_NONE},
+    // A8
+    {"XRA", "B", I8080_OPERAND_NONE}, {"XRA", "C", I8080_OPERAND_NONE}, {"XRA", "D", I8080_OPERAND_NONE}, {"XRA", "E", I8080_OPERAND_NONE},
+    {"XRA", "H", I8080_OPERAND_NONE}, {"XRA", "L", I8080_OPERAND_NONE}, {"XRA", "M", I8080_OPERAND_NONE}, {"XRA", "A", I8080_OPERAND_NONE},
+    // B0
+    {"ORA", "B", I8080_OPERAND_NONE}, {"ORA", "C", I8080_OPERAND_NONE}, {"ORA", "D", I8080_OPERAND_NONE}, {"ORA", "E", I8080_OPERAND_NONE},
+    {"ORA", "H", I8080_OPERAND_NONE}, {"ORA", "L", I8080_OPERAND_NONE}, {"ORA", "M", I8080_OPERAND_NONE}, {"ORA", "A", I8080_OPERAND_NONE},
+    // B8
+    {"CMP", "B", I8080_OPERAND_NONE}, {"CMP", "C", I8080_OPERAND_NONE}, {"CMP", "D", I8080_OPERAND_NONE}, {"CMP", "E", I8080_OPERAND_NONE},
+    {"CMP", "H", I8080_OPERAND_NONE}, {"CMP", "L", I8080_OPERAND_NONE}, {"CMP", "M", I8080_OPERAND_NONE}, {"CMP", "A", I8080_OPERAND_NONE},
+    // C0
+    {"RNZ", "", I8080_OPERAND_NONE}, {"POP", "B", I8080_OPERAND_NONE}, {"JNZ", "", I8080_OPERAND_A16}, {"JMP", "", I8080_OPERAND_A16},
+    {"CNZ", "", I8080_OPERAND_A16}, {"PUSH", "B", I8080_OPERAND_NONE}, {"ADI", "", I8080_OPERAND_D8}, {"RST", "0", I8080_OPERAND_NONE},
+    // C8
+    {"RZ", "", I8080_OPERAND_NONE}, {"RET", "", I8080_OPERAND_NONE}, {"JZ", "", I8080_OPERAND_A16}, {"NOP", "", I8080_OPERAND_NONE},
+    {"CZ", "", I8080_OPERAND_A16}, {"CALL", "", I8080_OPERAND_A16}, {"ACI", "", I8080_OPERAND_D8}, {"RST", "1", I8080_OPERAND_NONE},
+    // D0
+    {"RNC", "", I8080_OPERAND_NONE}, {"POP", "D", I8080_OPERAND_NONE}, {"JNC", "", I8080_OPERAND_A16}, {"OUT", "", I8080_OPERAND_D8},
+    {"CNC", "", I8080_OPERAND_A16}, {"PUSH", "D", I8080_OPERAND_NONE}, {"SUI", "", I8080_OPERAND_D8}, {"RST", "2", I8080_OPERAND_NONE},
+    // D8
+    {"RC", "", I8080_OPERAND_NONE}, {"NOP", "", I8080_OPERAND_NONE}, {"JC", "", I8080_OPERAND_A16}, {"IN", "", I8080_OPERAND_D8},
+    {"CC", "", I8080_OPERAND_A16}, {"NOP", "", I8080_OPERAND_NONE}, {"SBI", "", I8080_OPERAND_D8}, {"RST", "3", I8080_OPERAND_NONE},
+    // E0
+    {"RPO", "", I8080_OPERAND_NONE}, {"POP", "H", I8080_OPERAND_NONE}, {"JPO", "", I8080_OPERAND_A16}, {"XTHL", "", I8080_OPERAND_NONE},
+    {"CPO", "", I8080_OPERAND_A16}, {"PUSH", "H", I8080_OPERAND_NONE}, {"ANI", "", I8080_OPERAND_D8}, {"RST", "4", I8080_OPERAND_NONE},
+    // E8
+    {"RPE", "", I8080_OPERAND_NONE}, {"PCHL", "", I8080_OPERAND_NONE}, {"JPE", "", I8080_OPERAND_A16}, {"XCHG", "", I8080_OPERAND_NONE},
+    {"CPE", "", I8080_OPERAND_A16}, {"NOP", "", I8080_OPERAND_NONE}, {"XRI", "", I8080_OPERAND_D8}, {"RST", "5", I8080_OPERAND_NONE},
+    // F0
+    {"RP", "", I8080_OPERAND_NONE}, {"POP", "PSW", I8080_OPERAND_NONE}, {"JP", "", I8080_OPERAND_A16}, {"DI", "", I8080_OPERAND_NONE},
+    {"CP", "", I8080_OPERAND_A16}, {"PUSH", "PSW", I8080_OPERAND_NONE}, {"ORI", "", I8080_OPERAND_D8}, {"RST", "6", I8080_OPERAND_NONE},
+    // F8
+    {"RM", "", I8080_OPERAND_NONE}, {"SPHL", "", I8080_OPERAND_NONE}, {"JM", "", I8080_OPERAND_A16}, {"EI", "", I8080_OPERAND_NONE},
+    {"CM", "", I8080_OPERAND_A16}, {"NOP", "", I8080_OPERAND_NONE}, {"CPI", "", I8080_OPERAND_D8}, {"RST", "7", I8080_OPERAND_NONE}
+};
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static char *put_hex(char *out, uint16_t value, int digits){
+    while(digits-- > 0){
+        *out++ = hex_digits[(value >> (digits * 4)) & 0x0f];
+    }
+    return out;
+}
+
+/* Write the instruction at code as text, e.g. "LXI  B,#$1234", into text and
+   return its length in bytes. available is the number of bytes readable at
+   code, an instruction cut short by it comes out as a DB of its first byte.
+   Returns 0 if text_size is below I8080_DISASM_TEXT_SIZE */
+int disassemble_instruction(const uint8_t *code, size_t available, char *text, size_t text_size){
+    const i8080_opcode_t *entry;
+    uint8_t length;
+    char *out = text;
+    size_t name_length;
+
+    if(text_size < I8080_DISASM_TEXT_SIZE || available == 0){
+        return 0;
+    }
+    entry = &i8080_opcode_table[code[0]];
+    length = i8080_length_table[code[0]];
+    if(length > available){
+        memcpy(out, "DB   $", 6);
+        out = put_hex(out + 6, code[0], 2);
+        *out = '\0';
+        return 1;
+    }
+
+    name_length = strlen(entry->name);
+    memcpy(out, entry->name, name_length);
+    out += name_length;
+    if(entry->args[0] == '\0' && entry->operand == I8080_OPERAND_NONE){
+        *out = '\0';
+        return length;
+    }
+    while(name_length++ < 4){
+        *out++ = ' '; //Arguments start in column 6
+    }
+    *out++ = ' ';
+    if(entry->args[0] != '\0'){
+        size_t args_length = strlen(entry->args);
+        memcpy(out, entry->args, args_length);
+        out += args_length;
+        if(entry->operand != I8080_OPERAND_NONE)
+            *out++ = ',';
+    }
+    switch(entry->operand){
+        case I8080_OPERAND_D8:
+            *out++ = '#';
+            *out++ = '$';
+            out = put_hex(out, code[1], 2);
+            break;
+        case I8080_OPERAND_D16:
+            *out++ = '#';
+            /* fall through */
+        case I8080_OPERAND_A16:
+            *out++ = '$';
+            out = put_hex(out, code[2] << 8 | code[1], 4);
+            break;
+        default:
+            break;
+    }
+    *out = '\0';
+    return length;
+}
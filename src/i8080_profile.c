@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+
+#ifdef I8080_PROFILE
+
+#define PROFILE_BAR_WIDTH (40) //Characters for the op-code taking the most cycles
+
+typedef struct profile_entry_t{
+    uint32_t key; //Op-code or address
+    uint64_t count;
+}profile_entry_t;
+
+/* Start counting from zero, e.g. after boot so only the main loop shows */
+void reset_profile(i8080_state_t *cpu){
+    memset(&cpu->profile, 0, sizeof(cpu->profile));
+}
+
+static int by_count(const void *a, const void *b){
+    const profile_entry_t *x = a, *y = b;
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+/* Print every op-code that ran, most executed first, with its share of the
+   cycles as a histogram bar, then the [top] most executed addresses */
+void display_profile(i8080_state_t *cpu, uint32_t top){
+    i8080_profile_t *profile = &cpu->profile;
+    profile_entry_t ops[256];
+    profile_entry_t *pcs = malloc(I8080_MAX_MEMORY_SIZE * sizeof(profile_entry_t));
+    uint64_t instructions = 0, cycles = 0, most_cycles = 0;
+
+    if(pcs == NULL){
+        fprintf(stderr, "[ERROR]: Out of memory\n");
+        return;
+    }
+    for(int op = 0; op < 256; op++){
+        ops[op].key = op;
+        ops[op].count = profile->op_count[op];
+        instructions += profile->op_count[op];
+        cycles += profile->op_cycles[op];
+        if(profile->op_cycles[op] > most_cycles)
+            most_cycles = profile->op_cycles[op];
+    }
+    qsort(ops, 256, sizeof(ops[0]), by_count);
+
+    printf("Instructions: %llu, cycles: %llu\n", (unsigned long long)instructions, (unsigned long long)cycles);
+    printf("%-2s  %14s  %6s  %14s  %6s  %5s\n", "op", "count", "%", "cycles", "%", "avg");
+    for(int i = 0; i < 256 && ops[i].count != 0; i++){
+        uint8_t op = ops[i].key;
+        int bar = (int)(profile->op_cycles[op] * PROFILE_BAR_WIDTH / most_cycles);
+        printf("%02X  %14llu  %6.2f  %14llu  %6.2f  %5.2f  %.*s\n", op,
+               (unsigned long long)ops[i].count, 100.0 * ops[i].count / instructions,
+               (unsigned long long)profile->op_cycles[op], 100.0 * profile->op_cycles[op] / cycles,
+               (double)profile->op_cycles[op] / ops[i].count,
+               bar, "########################################");
+    }
+
+    for(uint32_t addr = 0; addr < I8080_MAX_MEMORY_SIZE; addr++){
+        pcs[addr].key = addr;
+        pcs[addr].count = profile->pc_count[addr];
+    }
+    qsort(pcs, I8080_MAX_MEMORY_SIZE, sizeof(pcs[0]), by_count);
+    printf("%-4s  %2s  %14s  %6s\n", "pc", "op", "count", "%");
+    for(uint32_t i = 0; i < top && i < I8080_MAX_MEMORY_SIZE && pcs[i].count != 0; i++){
+        uint8_t *page = cpu->map.read[pcs[i].key >> I8080_PAGE_SHIFT]; //MMIO reads could have side effects
+        if(page != NULL){
+            printf("%04X  %02X", pcs[i].key, page[pcs[i].key & (I8080_PAGE_SIZE - 1)]);
+        }else{
+            printf("%04X  --", pcs[i].key);
+        }
+        printf("  %14llu  %6.2f\n", (unsigned long long)pcs[i].count, 100.0 * pcs[i].count / instructions);
+    }
+    free(pcs);
+}
+
+#endif
@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "../include/intel8080.h"
+#include "../include/i8080_runner.h"
+#ifdef I8080_JIT
+#include "../include/i8080_jit.h"
+#endif
+
+#define RANGE(next, end) ((uint64_t)(end) << 32 | (uint32_t)(next))
+#define RANGE_NEXT(range) ((uint32_t)(range))
+#define RANGE_END(range) ((uint32_t)((range) >> 32))
+
+typedef struct runner_thread_t{
+    i8080_runner_t *runner;
+    uint32_t index;
+}runner_thread_t;
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Run instances over the whole arena on [threads] workers, 0 for one per
+   core. There are never more workers than instances */
+i8080_runner_t *create_runner(i8080_arena_t *arena, uint32_t threads){
+    i8080_runner_t *runner;
+
+    if(arena == NULL || (runner = calloc(1, sizeof(*runner))) == NULL){
+        return NULL;
+    }
+    if(threads == 0){
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (uint32_t)cores : 1;
+    }
+    if(threads > I8080_RUNNER_MAX_THREADS)
+        threads = I8080_RUNNER_MAX_THREADS;
+    if(threads > arena->count)
+        threads = arena->count;
+    runner->arena = arena;
+    runner->count = arena->count;
+    runner->threads = threads;
+    runner->workers = aligned_alloc(I8080_RUNNER_CACHE_LINE, sizeof(i8080_runner_worker_t) * threads);
+    runner->results = calloc(arena->count, sizeof(i8080_instance_result_t));
+    if(runner->workers == NULL || runner->results == NULL){
+        destroy_runner(runner);
+        return NULL;
+    }
+    memset(runner->workers, 0, sizeof(i8080_runner_worker_t) * threads);
+    return runner;
+}
+
+void destroy_runner(i8080_runner_t *runner){
+    if(runner == NULL)
+        return;
+    free(runner->workers);
+    free(runner->results);
+    free(runner);
+}
+
+/* Next instance from the front of the worker's own range, -1 once empty */
+static int64_t take_own(i8080_runner_worker_t *worker){
+    uint64_t range = __atomic_load_n(&worker->range, __ATOMIC_ACQUIRE);
+    while(RANGE_NEXT(range) < RANGE_END(range)){
+        if(__atomic_compare_exchange_n(&worker->range, &range, RANGE(RANGE_NEXT(range) + 1, RANGE_END(range)),
+                                       0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+            return RANGE_NEXT(range);
+        }
+    }
+    return -1;
+}
+
+/* Move the back half of another worker's range to this one. Nothing is
+   ever added to the ranges, so one pass finding them all empty means the
+   rest of the work is already in the hands of running workers */
+static int steal(i8080_runner_t *runner, uint32_t self){
+    for(uint32_t i = 1; i < runner->threads; i++){
+        i8080_runner_worker_t *victim = &runner->workers[(self + i) % runner->threads];
+        uint64_t range = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+        while(RANGE_NEXT(range) < RANGE_END(range)){
+            uint32_t end = RANGE_END(range);
+            uint32_t split = end - (end - RANGE_NEXT(range) + 1) / 2;
+            if(__atomic_compare_exchange_n(&victim->range, &range, RANGE(RANGE_NEXT(range), split),
+                                           0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+                __atomic_store_n(&runner->workers[self].range, RANGE(split, end), __ATOMIC_RELEASE);
+                runner->workers[self].steals++;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Step one instance in slices up to the cycle target */
+static void run_instance(i8080_runner_t *runner, uint32_t self, uint32_t index){
+    i8080_state_t *cpu = arena_cpu(runner->arena, index);
+    i8080_instance_result_t *result = &runner->results[index];
+    uint64_t start = now_ns();
+    uint64_t first = cpu->cycles;
+    uint64_t end = first + runner->cycles;
+
+    result->status = I8080_OK;
+    result->slices = 0;
+    result->stopped = 0;
+    result->worker = self;
+    while(cpu->cycles < end){
+        uint64_t budget = end - cpu->cycles;
+        if(budget > runner->slice)
+            budget = runner->slice;
+#ifdef I8080_JIT
+        if(cpu->jit != NULL)
+            result->status = run_cycles_jit(cpu, budget);
+        else
+#endif
+        result->status = run_cycles(cpu, budget);
+        result->slices++;
+        if(result->status != I8080_OK){
+            break;
+        }
+        if(runner->slice_fn != NULL && runner->slice_fn(cpu, index, runner->ctx)){
+            result->stopped = 1;
+            break;
+        }
+    }
+    result->cycles = cpu->cycles - first;
+    result->ns = now_ns() - start;
+}
+
+static void *runner_worker(void *arg){
+    runner_thread_t *thread = arg;
+    i8080_runner_t *runner = thread->runner;
+    i8080_runner_worker_t *worker = &runner->workers[thread->index];
+
+    do{
+        int64_t index;
+        while((index = take_own(worker)) >= 0){
+            run_instance(runner, thread->index, (uint32_t)index);
+            worker->instances++;
+            worker->cycles += runner->results[index].cycles;
+            worker->ns += runner->results[index].ns;
+        }
+    }while(steal(runner, thread->index));
+    return NULL;
+}
+
+/* Run every instance for [cycles] more cycles in slices of [slice], 0 for
+   I8080_RUNNER_SLICE, calling slice_fn (if not NULL) after each. The calling
+   thread is one of the workers. Fails if any instance failed */
+int run_instances(i8080_runner_t *runner, uint64_t cycles, uint32_t slice, i8080_slice_fn_t slice_fn, void *ctx){
+    pthread_t threads[I8080_RUNNER_MAX_THREADS];
+    runner_thread_t args[I8080_RUNNER_MAX_THREADS];
+    uint32_t started = 1;
+    uint64_t start;
+
+    runner->cycles = cycles;
+    runner->slice = slice ? slice : I8080_RUNNER_SLICE;
+    runner->slice_fn = slice_fn;
+    runner->ctx = ctx;
+    for(uint32_t i = 0; i < runner->threads; i++){
+        i8080_runner_worker_t *worker = &runner->workers[i];
+        memset(worker, 0, sizeof(*worker));
+        worker->range = RANGE((uint64_t)runner->count * i / runner->threads,
+                              (uint64_t)runner->count * (i + 1) / runner->threads);
+        args[i].runner = runner;
+        args[i].index = i;
+    }
+
+    start = now_ns();
+    for(; started < runner->threads; started++){
+        if(pthread_create(&threads[started], NULL, runner_worker, &args[started]) != 0){
+            break; //The workers that did start steal the rest
+        }
+    }
+    runner_worker(&args[0]);
+    for(uint32_t i = 1; i < started; i++){
+        pthread_join(threads[i], NULL);
+    }
+    runner->ns = now_ns() - start;
+
+    for(uint32_t i = 0; i < runner->count; i++){
+        if(runner->results[i].status != I8080_OK){
+            fprintf(stderr, "[ERROR]: Instance %u failed after %llu cycles\n", i,
+                    (unsigned long long)runner->results[i].cycles);
+            return I8080_ERROR;
+        }
+    }
+    return I8080_OK;
+}
+
+void display_runner_stats(i8080_runner_t *runner){
+    uint64_t cycles = 0, steals = 0;
+    double seconds = runner->ns / 1e9;
+
+    for(uint32_t i = 0; i < runner->threads; i++){
+        i8080_runner_worker_t *worker = &runner->workers[i];
+        printf("Worker %u: %llu instances, %llu steals, %llu cycles, %.1f%% busy\n", i,
+               (unsigned long long)worker->instances, (unsigned long long)worker->steals,
+               (unsigned long long)worker->cycles, runner->ns ? 100.0 * worker->ns / runner->ns : 0.0);
+        cycles += worker->cycles;
+        steals += worker->steals;
+    }
+    printf("Instances: %u on %u workers, %llu steals\n", runner->count, runner->threads, (unsigned long long)steals);
+    printf("Cycles: %llu in %.3f s, %.1f MHz\n", (unsigned long long)cycles, seconds,
+           seconds > 0 ? cycles / seconds / 1e6 : 0.0);
+}
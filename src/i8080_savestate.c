@@ -0,0 +1,440 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+
+/* File layout, all fields little-endian:
+     header   magic[8] version:u32 rom_size:u32 rom_hash:u32
+     sections tag[4] length:u32 payload[length], in any order:
+       "CPU " bc de hl psw sp pc:u16 int_enable int_request halted:u8 cycles:u64
+       "EVNT" next_id:u32 count:u32, per event in heap order
+              deadline:u64 period:u32 id:u32 rst:u8 handler:u8
+       "DEV " host device state, as handed to save_state()
+       "MEM " runs of the memory XORed with the ROM image, see encode_memory()
+     "END " section holding the FNV-1a hash of every byte before its payload */
+#define STATE_BUFFER_SIZE (4096)
+#define STATE_MIN_RUN (3) //Shorter repeats are cheaper inside a literal
+
+#define FNV_BASIS (2166136261u)
+#define FNV_PRIME (16777619u)
+
+/* Memory runs, each a varint of count << 2 | kind */
+enum{
+    RUN_ZERO = 0, //count bytes equal to the ROM image
+    RUN_LITERAL,  //count delta bytes follow
+    RUN_REPEAT    //one delta byte follows, repeated count times
+};
+
+typedef struct state_writer_t{
+    FILE *file;    //NULL only counts the bytes
+    uint32_t hash;
+    uint32_t bytes;
+    int error;
+}state_writer_t;
+
+typedef struct state_reader_t{
+    FILE *file;
+    uint32_t hash;
+    uint32_t bytes; //Consumed so far
+    uint32_t pos, len;
+    int error;
+    uint8_t buffer[STATE_BUFFER_SIZE];
+}state_reader_t;
+
+static uint32_t hash_bytes(uint32_t hash, const uint8_t *bytes, size_t size){
+    for(size_t i = 0; i < size; i++){
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/* Byte of the image load_rom() put at addr, zero past its end */
+static inline uint8_t base_byte(const i8080_state_t *cpu, uint32_t addr){
+    return cpu->rom_image != NULL && addr < cpu->loaded_rom_size ? cpu->rom_image[addr] : 0;
+}
+
+static inline uint8_t delta_byte(const i8080_state_t *cpu, uint32_t addr){
+    return cpu->memory[addr] ^ base_byte(cpu, addr);
+}
+
+static uint32_t rom_hash(const i8080_state_t *cpu){
+    return cpu->rom_image != NULL ? hash_bytes(FNV_BASIS, cpu->rom_image, cpu->loaded_rom_size) : FNV_BASIS;
+}
+
+static void put_bytes(state_writer_t *writer, const void *data, size_t size){
+    writer->hash = hash_bytes(writer->hash, data, size);
+    writer->bytes += size;
+    if(writer->file != NULL && !writer->error && fwrite(data, 1, size, writer->file) != size)
+        writer->error = 1;
+}
+
+static void put_le(state_writer_t *writer, uint64_t value, int size){
+    uint8_t bytes[8];
+    for(int i = 0; i < size; i++){
+        bytes[i] = value >> (8 * i);
+    }
+    put_bytes(writer, bytes, size);
+}
+
+#define put8(writer, value) put_le(writer, value, 1)
+#define put16(writer, value) put_le(writer, value, 2)
+#define put32(writer, value) put_le(writer, value, 4)
+#define put64(writer, value) put_le(writer, value, 8)
+
+static void put_varint(state_writer_t *writer, uint32_t value){
+    while(value >= 0x80){
+        put8(writer, (value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    put8(writer, value);
+}
+
+/* Length of the run of equal delta bytes at addr, up to limit */
+static uint32_t run_length(const i8080_state_t *cpu, uint32_t addr, uint32_t limit){
+    uint8_t value = delta_byte(cpu, addr);
+    uint32_t run = 1;
+    while(run < limit && addr + run < I8080_MAX_MEMORY_SIZE && delta_byte(cpu, addr + run) == value){
+        run++;
+    }
+    return run;
+}
+
+/* Memory as runs of delta bytes against the ROM image: untouched stretches
+   become RUN_ZERO, filled ones RUN_REPEAT and the rest RUN_LITERAL */
+static void encode_memory(state_writer_t *writer, const i8080_state_t *cpu){
+    uint32_t addr = 0;
+
+    while(addr < I8080_MAX_MEMORY_SIZE){
+        uint32_t run = run_length(cpu, addr, I8080_MAX_MEMORY_SIZE);
+        uint32_t end = addr;
+        if(run >= STATE_MIN_RUN){
+            uint8_t value = delta_byte(cpu, addr);
+            put_varint(writer, run << 2 | (value == 0 ? RUN_ZERO : RUN_REPEAT));
+            if(value != 0)
+                put8(writer, value);
+            addr += run;
+            continue;
+        }
+        //Literal up to the next run worth coding on its own
+        while(end < I8080_MAX_MEMORY_SIZE && (run = run_length(cpu, end, STATE_MIN_RUN)) < STATE_MIN_RUN){
+            end += run;
+        }
+        put_varint(writer, (end - addr) << 2 | RUN_LITERAL);
+        while(addr < end){
+            uint8_t bytes[256];
+            uint32_t count = end - addr < sizeof(bytes) ? end - addr : sizeof(bytes);
+            for(uint32_t i = 0; i < count; i++){
+                bytes[i] = delta_byte(cpu, addr + i);
+            }
+            put_bytes(writer, bytes, count);
+            addr += count;
+        }
+    }
+}
+
+static void put_section(state_writer_t *writer, const char *tag, uint32_t length){
+    put_bytes(writer, tag, 4);
+    put32(writer, length);
+}
+
+/* Write cpu's state to filename, with device_size bytes of host device state
+   (device may be NULL). Buffered OUTs are flushed first so the devices are
+   up to date */
+int save_state(i8080_state_t *cpu, const char *filename, const void *device, uint32_t device_size){
+    state_writer_t writer = {0}, counter = {0};
+    i8080_scheduler_t *sched = &cpu->sched;
+    uint32_t hash;
+
+    flush_port_log(cpu);
+    encode_memory(&counter, cpu);
+    if((writer.file = fopen(filename, "wb")) == NULL){
+        fprintf(stderr, "[ERROR]: Could not open %s\n", filename);
+        return I8080_ERROR;
+    }
+    writer.hash = FNV_BASIS;
+
+    put_bytes(&writer, I8080_STATE_MAGIC, 8);
+    put32(&writer, I8080_STATE_VERSION);
+    put32(&writer, cpu->rom_image != NULL ? cpu->loaded_rom_size : 0);
+    put32(&writer, rom_hash(cpu));
+
+    put_section(&writer, "CPU ", 6 * 2 + 3 + 8);
+    put16(&writer, cpu->bc);
+    put16(&writer, cpu->de);
+    put16(&writer, cpu->hl);
+    put16(&writer, cpu->a << 8 | get_flags(cpu));
+    put16(&writer, cpu->sp);
+    put16(&writer, cpu->pc);
+    put8(&writer, cpu->int_enable);
+    put8(&writer, cpu->int_request);
+    put8(&writer, cpu->halted);
+    put64(&writer, cpu->cycles);
+
+    put_section(&writer, "EVNT", 8 + sched->count * 18);
+    put32(&writer, sched->next_id);
+    put32(&writer, sched->count);
+    for(uint32_t i = 0; i < sched->count; i++){
+        put64(&writer, sched->heap[i].deadline);
+        put32(&writer, sched->heap[i].period);
+        put32(&writer, sched->heap[i].id);
+        put8(&writer, sched->heap[i].rst);
+        put8(&writer, sched->heap[i].fn != NULL);
+    }
+
+    if(device != NULL && device_size > 0){
+        put_section(&writer, "DEV ", device_size);
+        put_bytes(&writer, device, device_size);
+    }
+
+    put_section(&writer, "MEM ", counter.bytes);
+    encode_memory(&writer, cpu);
+
+    put_section(&writer, "END ", 4);
+    hash = writer.hash;
+    put32(&writer, hash);
+
+    if(fclose(writer.file) != 0 || writer.error){
+        fprintf(stderr, "[ERROR]: Could not write %s\n", filename);
+        return I8080_ERROR;
+    }
+    return I8080_OK;
+}
+
+static int get_bytes(state_reader_t *reader, void *data, size_t size){
+    uint8_t *out = data;
+
+    while(size > 0 && !reader->error){
+        size_t count;
+        if(reader->pos == reader->len){
+            reader->len = fread(reader->buffer, 1, sizeof(reader->buffer), reader->file);
+            reader->pos = 0;
+            if(reader->len == 0){
+                reader->error = 1;
+                break;
+            }
+        }
+        count = reader->len - reader->pos < size ? reader->len - reader->pos : size;
+        if(out != NULL){
+            memcpy(out, reader->buffer + reader->pos, count);
+            out += count;
+        }
+        reader->hash = hash_bytes(reader->hash, reader->buffer + reader->pos, count);
+        reader->bytes += count;
+        reader->pos += count;
+        size -= count;
+    }
+    return !reader->error;
+}
+
+static uint64_t get_le(state_reader_t *reader, int size){
+    uint8_t bytes[8];
+    uint64_t value = 0;
+    if(!get_bytes(reader, bytes, size))
+        return 0;
+    for(int i = 0; i < size; i++){
+        value |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+#define get8(reader) ((uint8_t)get_le(reader, 1))
+#define get16(reader) ((uint16_t)get_le(reader, 2))
+#define get32(reader) ((uint32_t)get_le(reader, 4))
+#define get64(reader) get_le(reader, 8)
+
+static uint32_t get_varint(state_reader_t *reader){
+    uint32_t value = 0;
+    for(int shift = 0; shift < 32; shift += 7){
+        uint8_t byte = get8(reader);
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            return value;
+    }
+    reader->error = 1; //Too long for a run
+    return 0;
+}
+
+/* Decode length bytes of runs straight into cpu->memory */
+static int decode_memory(state_reader_t *reader, i8080_state_t *cpu, uint32_t length){
+    uint32_t end = reader->bytes + length;
+    uint32_t addr = 0;
+
+    while(reader->bytes < end && !reader->error){
+        uint32_t code = get_varint(reader);
+        uint32_t count = code >> 2;
+        if(count > I8080_MAX_MEMORY_SIZE - addr)
+            return 0;
+        switch(code & 3){
+            case RUN_ZERO:
+                for(uint32_t i = 0; i < count; i++, addr++)
+                    cpu->memory[addr] = base_byte(cpu, addr);
+                break;
+            case RUN_REPEAT:
+                {
+                    uint8_t value = get8(reader);
+                    for(uint32_t i = 0; i < count; i++, addr++)
+                        cpu->memory[addr] = base_byte(cpu, addr) ^ value;
+                }
+                break;
+            case RUN_LITERAL:
+                if(!get_bytes(reader, cpu->memory + addr, count))
+                    return 0;
+                for(uint32_t i = 0; i < count; i++, addr++)
+                    cpu->memory[addr] ^= base_byte(cpu, addr);
+                break;
+            default:
+                return 0;
+        }
+    }
+    return !reader->error && reader->bytes == end && addr == I8080_MAX_MEMORY_SIZE;
+}
+
+/* Read a state written by save_state() into cpu, which must have the same
+   ROM loaded. Memory is decoded as the file streams in, nothing is
+   allocated; registers and events are only set once the whole file checked
+   out, but a bad file can leave memory half loaded. Saved events are matched
+   to cpu's by id to get their handlers back. device (may be NULL) receives
+   the host device state if it fits in *device_size, which is set to the
+   bytes stored */
+int load_state(i8080_state_t *cpu, const char *filename, void *device, uint32_t *device_size){
+    state_reader_t reader;
+    i8080_scheduler_t sched = cpu->sched;
+    uint16_t regs[6] = {0};
+    uint8_t int_enable = 0, int_request = 0, halted = 0;
+    uint64_t cycles = 0;
+    uint32_t stored = 0, version, size, hash;
+    uint8_t seen_cpu = 0, seen_mem = 0;
+    char magic[8];
+
+    reader.file = fopen(filename, "rb");
+    if(reader.file == NULL){
+        fprintf(stderr, "[ERROR]: Could not open %s\n", filename);
+        return I8080_ERROR;
+    }
+    setvbuf(reader.file, NULL, _IONBF, 0); //Reads go straight to reader.buffer
+    reader.hash = FNV_BASIS;
+    reader.bytes = reader.pos = reader.len = 0;
+    reader.error = 0;
+
+    get_bytes(&reader, magic, sizeof(magic));
+    version = get32(&reader);
+    size = get32(&reader);
+    hash = get32(&reader);
+    if(reader.error || memcmp(magic, I8080_STATE_MAGIC, sizeof(magic)) != 0 || version != I8080_STATE_VERSION){
+        fprintf(stderr, "[ERROR]: %s is not a version %d save state\n", filename, I8080_STATE_VERSION);
+        fclose(reader.file);
+        return I8080_ERROR;
+    }
+    if(size != (cpu->rom_image != NULL ? cpu->loaded_rom_size : 0) || hash != rom_hash(cpu)){
+        fprintf(stderr, "[ERROR]: %s was saved against another ROM\n", filename);
+        fclose(reader.file);
+        return I8080_ERROR;
+    }
+
+    for(;;){
+        char tag[4];
+        uint32_t length, start;
+        get_bytes(&reader, tag, sizeof(tag));
+        length = get32(&reader);
+        start = reader.bytes;
+        if(reader.error)
+            break;
+
+        if(memcmp(tag, "END ", 4) == 0){
+            uint32_t expected = reader.hash;
+            if(length != 4 || get32(&reader) != expected)
+                reader.error = 1;
+            break;
+        }else if(memcmp(tag, "CPU ", 4) == 0 && length == 6 * 2 + 3 + 8){
+            for(int i = 0; i < 6; i++){
+                regs[i] = get16(&reader);
+            }
+            int_enable = get8(&reader);
+            int_request = get8(&reader);
+            halted = get8(&reader);
+            cycles = get64(&reader);
+            seen_cpu = 1;
+        }else if(memcmp(tag, "EVNT", 4) == 0){
+            sched.next_id = get32(&reader);
+            sched.count = get32(&reader);
+            if(sched.count > I8080_MAX_EVENTS || length != 8 + sched.count * 18){
+                reader.error = 1;
+                break;
+            }
+            for(uint32_t i = 0; i < sched.count; i++){
+                i8080_event_t *event = &sched.heap[i];
+                uint8_t handler;
+                event->deadline = get64(&reader);
+                event->period = get32(&reader);
+                event->id = get32(&reader);
+                event->rst = get8(&reader);
+                handler = get8(&reader);
+                event->fn = NULL;
+                event->ctx = NULL;
+                for(uint32_t j = 0; j < cpu->sched.count; j++){
+                    if(cpu->sched.heap[j].id == event->id){
+                        event->fn = cpu->sched.heap[j].fn;
+                        event->ctx = cpu->sched.heap[j].ctx;
+                    }
+                }
+                if(handler && event->fn == NULL){
+                    fprintf(stderr, "[ERROR]: Saved event %u has a handler the CPU does not\n", event->id);
+                    reader.error = 1;
+                    break;
+                }
+            }
+        }else if(memcmp(tag, "DEV ", 4) == 0 && device != NULL && device_size != NULL){
+            if(length > *device_size){
+                fprintf(stderr, "[ERROR]: Saved device state needs %u bytes, %u given\n", length, *device_size);
+                reader.error = 1;
+                break;
+            }
+            get_bytes(&reader, device, length);
+            stored = length;
+        }else if(memcmp(tag, "MEM ", 4) == 0){
+            if(!decode_memory(&reader, cpu, length))
+                reader.error = 1;
+            seen_mem = 1;
+        }else{
+            get_bytes(&reader, NULL, length); //Not ours, or not wanted
+        }
+        if(reader.error || reader.bytes != start + length){
+            reader.error = 1;
+            break;
+        }
+    }
+    fclose(reader.file);
+
+    //Stores behind the CPU's back: caches and snapshot pairing are stale
+    if(seen_mem){
+        invalidate_range(cpu, 0, I8080_MAX_MEMORY_SIZE);
+        memset(cpu->dirty, 0xff, sizeof(cpu->dirty));
+    }
+    if(reader.error || !seen_cpu || !seen_mem){
+        fprintf(stderr, "[ERROR]: %s is truncated or corrupt\n", filename);
+        return I8080_ERROR;
+    }
+
+    cpu->bc = regs[0];
+    cpu->de = regs[1];
+    cpu->hl = regs[2];
+    cpu->psw = regs[3];
+#ifdef I8080_LAZY_FLAGS
+    cpu->lazy.op = LAZY_NONE;
+#endif
+    cpu->sp = regs[4];
+    cpu->pc = regs[5];
+    cpu->int_enable = int_enable;
+    cpu->int_request = int_request;
+    cpu->halted = halted;
+    cpu->cycles = cycles;
+    cpu->sched = sched;
+    cpu->idle.valid = 0;
+    cpu->io.log_count = 0;
+    if(device_size != NULL)
+        *device_size = stored;
+    return I8080_OK;
+}
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+
+/* True if event a fires before event b */
+static int event_before(const i8080_event_t *a, const i8080_event_t *b){
+    return a->deadline < b->deadline || (a->deadline == b->deadline && a->id < b->id);
+}
+
+static void swap_events(i8080_event_t *a, i8080_event_t *b){
+    i8080_event_t tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+static void sift_up(i8080_scheduler_t *sched, uint32_t i){
+    while(i > 0 && event_before(&sched->heap[i], &sched->heap[(i - 1) / 2])){
+        swap_events(&sched->heap[i], &sched->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+}
+
+static void sift_down(i8080_scheduler_t *sched, uint32_t i){
+    for(;;){
+        uint32_t first = i;
+        uint32_t left = 2 * i + 1;
+        uint32_t right = left + 1;
+        if(left < sched->count && event_before(&sched->heap[left], &sched->heap[first]))
+            first = left;
+        if(right < sched->count && event_before(&sched->heap[right], &sched->heap[first]))
+            first = right;
+        if(first == i)
+            return;
+        swap_events(&sched->heap[i], &sched->heap[first]);
+        i = first;
+    }
+}
+
+static void remove_event(i8080_scheduler_t *sched, uint32_t i){
+    sched->heap[i] = sched->heap[--sched->count];
+    if(i < sched->count){
+        sift_down(sched, i);
+        sift_up(sched, i);
+    }
+}
+
+/* Fire the event at [deadline] cycles, then every [period] cycles after if
+   period is non-zero. Returns a handle for cancel_event(), or -1 if the heap
+   is full or rst is out of range */
+int schedule_event(i8080_state_t *cpu, uint64_t deadline, uint32_t period, uint8_t rst,
+                   i8080_event_fn_t fn, void *ctx){
+    i8080_scheduler_t *sched = &cpu->sched;
+    i8080_event_t *event;
+    uint32_t id;
+
+    if(sched->count == I8080_MAX_EVENTS){
+        fprintf(stderr, "[ERROR]: Event heap full (%d events)\n", I8080_MAX_EVENTS);
+        return -1;
+    }
+    if(rst > 7 && rst != I8080_NO_RST){
+        fprintf(stderr, "[ERROR]: Invalid RST number %u\n", rst);
+        return -1;
+    }
+    event = &sched->heap[sched->count];
+    event->deadline = deadline;
+    event->period = period;
+    event->id = id = sched->next_id++ & 0x7fffffff;
+    event->rst = rst;
+    event->fn = fn;
+    event->ctx = ctx;
+    sched->count++;
+    sift_up(sched, sched->count - 1);
+    return (int)id;
+}
+
+int cancel_event(i8080_state_t *cpu, int id){
+    i8080_scheduler_t *sched = &cpu->sched;
+    for(uint32_t i = 0; i < sched->count; i++){
+        if((int)sched->heap[i].id == id){
+            remove_event(sched, i);
+            return I8080_OK;
+        }
+    }
+    return I8080_ERROR;
+}
+
+void clear_events(i8080_state_t *cpu){
+    memset(&cpu->sched, 0, sizeof(cpu->sched));
+}
+
+/* Fire every event that is due and return the cycle count execution may run
+   to: the next deadline or end, whichever is first. A halted CPU is moved
+   straight to that point instead, so callers find nothing left to run */
+uint64_t schedule_slice(i8080_state_t *cpu, uint64_t end){
+    i8080_scheduler_t *sched = &cpu->sched;
+    uint64_t slice;
+
+    while(sched->count > 0 && sched->heap[0].deadline <= cpu->cycles){
+        i8080_event_t event = sched->heap[0];
+        if(event.period != 0){
+            sched->heap[0].deadline += event.period;
+            sift_down(sched, 0);
+        }else{
+            remove_event(sched, 0);
+        }
+        sched->fired++;
+        if(event.rst != I8080_NO_RST){
+            interrupt(cpu, event.rst);
+        }
+        if(event.fn != NULL){
+            event.fn(cpu, event.ctx);
+        }
+    }
+    if(cpu->int_request && cpu->int_enable){
+        interrupt(cpu, (cpu->int_request >> 3) & 7); //Latched while interrupts were off
+    }
+
+    slice = end;
+    if(sched->count > 0 && sched->heap[0].deadline < slice){
+        slice = sched->heap[0].deadline;
+    }
+    if(cpu->halted && cpu->cycles < slice){
+        sched->halted_cycles += slice - cpu->cycles;
+        cpu->cycles = slice;
+    }
+    return slice;
+}
@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+
+/* A zeroed snapshot, nothing is held until the first take_snapshot() */
+i8080_snapshot_t *create_snapshot(void){
+    return calloc(1, sizeof(i8080_snapshot_t));
+}
+
+void destroy_snapshot(i8080_snapshot_t *snapshot){
+    free(snapshot);
+}
+
+/* Copy the pages set in dirty from src to dst, runs of pages in one go.
+   Returns the pages copied */
+static uint32_t copy_dirty(uint8_t *dst, const uint8_t *src, const uint64_t *dirty){
+    uint32_t copied = 0;
+
+    for(uint32_t word = 0; word < I8080_DIRTY_WORDS; word++){
+        uint64_t bits = dirty[word];
+        while(bits != 0){
+            uint32_t first = __builtin_ctzll(bits);
+            uint64_t rest = bits >> first;
+            uint32_t run = ~rest == 0 ? 64 : __builtin_ctzll(~rest); //All 64 set is the only full run
+            size_t offset = (size_t)(word * 64 + first) << I8080_PAGE_SHIFT;
+            memcpy(dst + offset, src + offset, (size_t)run << I8080_PAGE_SHIFT);
+            bits = run == 64 ? 0 : bits & ~(((1ULL << run) - 1) << first);
+            copied += run;
+        }
+    }
+    return copied;
+}
+
+/* Pairs cpu's dirty pages with the snapshot from now on */
+static void sync_snapshot(i8080_state_t *cpu, i8080_snapshot_t *snapshot){
+    memset(cpu->dirty, 0, sizeof(cpu->dirty));
+    snapshot->cpu = cpu;
+    snapshot->sync = ++cpu->sync;
+}
+
+/* Save cpu into snapshot. Buffered OUTs are flushed first, so the devices
+   have seen everything up to the snapshot */
+void take_snapshot(i8080_state_t *cpu, i8080_snapshot_t *snapshot){
+    flush_port_log(cpu);
+    snapshot->bc = cpu->bc;
+    snapshot->de = cpu->de;
+    snapshot->hl = cpu->hl;
+    snapshot->psw = cpu->a << 8 | get_flags(cpu);
+    snapshot->sp = cpu->sp;
+    snapshot->pc = cpu->pc;
+    snapshot->int_enable = cpu->int_enable;
+    snapshot->int_request = cpu->int_request;
+    snapshot->halted = cpu->halted;
+    snapshot->cycles = cpu->cycles;
+    snapshot->sched = cpu->sched;
+
+    if(snapshot->cpu == cpu && snapshot->sync == cpu->sync){
+        snapshot->pages_copied = copy_dirty(snapshot->memory, cpu->memory, cpu->dirty);
+    }else{
+        memcpy(snapshot->memory, cpu->memory, I8080_MAX_MEMORY_SIZE);
+        snapshot->pages_copied = I8080_PAGE_COUNT;
+    }
+    sync_snapshot(cpu, snapshot);
+}
+
+/* Put cpu back to the state in snapshot, which may come from another
+   instance. The memory map, port handlers and stats stay as they are, OUTs
+   still buffered since the snapshot are dropped */
+int restore_snapshot(i8080_state_t *cpu, i8080_snapshot_t *snapshot){
+    if(snapshot->cpu == NULL){
+        fprintf(stderr, "[ERROR]: Snapshot to restore was never taken\n");
+        return I8080_ERROR;
+    }
+
+    if(snapshot->cpu == cpu && snapshot->sync == cpu->sync){
+        snapshot->pages_copied = copy_dirty(cpu->memory, snapshot->memory, cpu->dirty);
+        for(uint32_t page = 0; page < I8080_PAGE_COUNT; page++){
+            if(cpu->dirty[page >> 6] & (1ULL << (page & 63)))
+                invalidate_range(cpu, page << I8080_PAGE_SHIFT, I8080_PAGE_SIZE);
+        }
+    }else{
+        memcpy(cpu->memory, snapshot->memory, I8080_MAX_MEMORY_SIZE);
+        invalidate_range(cpu, 0, I8080_MAX_MEMORY_SIZE);
+        snapshot->pages_copied = I8080_PAGE_COUNT;
+    }
+    sync_snapshot(cpu, snapshot);
+
+    cpu->bc = snapshot->bc;
+    cpu->de = snapshot->de;
+    cpu->hl = snapshot->hl;
+    cpu->psw = snapshot->psw;
+#ifdef I8080_LAZY_FLAGS
+    cpu->lazy.op = LAZY_NONE;
+#endif
+    cpu->sp = snapshot->sp;
+    cpu->pc = snapshot->pc;
+    cpu->int_enable = snapshot->int_enable;
+    cpu->int_request = snapshot->int_request;
+    cpu->halted = snapshot->halted;
+    cpu->cycles = snapshot->cycles;
+    cpu->sched = snapshot->sched;
+    cpu->idle.valid = 0;
+    cpu->io.log_count = 0;
+    return I8080_OK;
+}
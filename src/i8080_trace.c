@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+
+#ifdef I8080_TRACE
+
+/* Start recording into a ring of [size] records, a power of two, 0 for
+   I8080_TRACE_SIZE. Restarting drops what was recorded */
+int start_trace(i8080_state_t *cpu, uint32_t size){
+    i8080_trace_t *trace;
+
+    if(size == 0){
+        size = I8080_TRACE_SIZE;
+    }
+    if(size & (size - 1)){
+        fprintf(stderr, "[ERROR]: Trace size %u is not a power of two\n", size);
+        return I8080_ERROR;
+    }
+    stop_trace(cpu);
+    trace = calloc(1, sizeof(i8080_trace_t));
+    if(trace == NULL){
+        return I8080_ERROR;
+    }
+    trace->records = calloc(size, sizeof(i8080_trace_record_t));
+    if(trace->records == NULL){
+        free(trace);
+        return I8080_ERROR;
+    }
+    trace->mask = size - 1;
+    cpu->trace = trace;
+    return I8080_OK;
+}
+
+void stop_trace(i8080_state_t *cpu){
+    if(cpu->trace == NULL)
+        return;
+    free(cpu->trace->records);
+    free(cpu->trace);
+    cpu->trace = NULL;
+}
+
+/* Dump the ring oldest record first. Tracing carries on afterwards */
+int write_trace(i8080_state_t *cpu, const char *filename){
+    i8080_trace_t *trace = cpu->trace;
+    i8080_trace_header_t header;
+    uint64_t size, first;
+    FILE *out;
+
+    if(trace == NULL){
+        fprintf(stderr, "[ERROR]: No trace running\n");
+        return I8080_ERROR;
+    }
+    out = fopen(filename, "wb");
+    if(out == NULL){
+        fprintf(stderr, "[ERROR]: Could not open %s\n", filename);
+        return I8080_ERROR;
+    }
+
+    size = (uint64_t)trace->mask + 1;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, I8080_TRACE_MAGIC, sizeof(header.magic));
+    header.version = I8080_TRACE_VERSION;
+    header.record_size = sizeof(i8080_trace_record_t);
+    header.records = trace->count < size ? trace->count : size;
+    header.total = trace->count;
+    fwrite(&header, sizeof(header), 1, out);
+
+    //The ring wraps at the oldest record once it has filled
+    first = trace->count - header.records;
+    for(uint64_t i = 0; i < header.records; ){
+        uint64_t slot = (first + i) & trace->mask;
+        uint64_t run = size - slot;
+        if(run > header.records - i)
+            run = header.records - i;
+        fwrite(&trace->records[slot], sizeof(i8080_trace_record_t), run, out);
+        i += run;
+    }
+    if(fclose(out) != 0){
+        fprintf(stderr, "[ERROR]: Could not write %s\n", filename);
+        return I8080_ERROR;
+    }
+    return I8080_OK;
+}
+
+#endif
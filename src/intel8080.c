@@ -2,120 +2,515 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <stddef.h>
 
 #include "../include/intel8080.h"
+#ifdef I8080_JIT
+#include "../include/i8080_jit.h"
+#endif
 
 #define MERGE_16BIT(h, l) ((h<<8 | l) & 0xffff)
 
-int main(int argc, char **argv){
-    //Initialise
-    puts("Loading Intel8080 CPU Emulator...");
-    i8080_state_t *cpu = malloc(sizeof(*cpu));
-    // memset(cpu, 0, sizeof(i8080_state_t));
+/* Sign, Zero and Parity flags of every 8-bit result, including the fixed PSW bit 1 */
+static const uint8_t szp_table[256] = {
+    0x46, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06, // 0x
+    0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02, // 1x
+    0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02, // 2x
+    0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06, // 3x
+    0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02, // 4x
+    0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06, // 5x
+    0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02, 0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06, // 6x
+    0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06, 0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02, // 7x
+    0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86, 0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82, // 8x
+    0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82, 0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86, // 9x
+    0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82, 0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86, // Ax
+    0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86, 0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82, // Bx
+    0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82, 0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86, // Cx
+    0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86, 0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82, // Dx
+    0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86, 0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82, // Ex
+    0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82, 0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86  // Fx
+};
 
-    // i8080_rom_t *rom = malloc(sizeof(i8080_rom_t));
-    if(cpu == NULL){
-        fprintf(stderr, "[ERROR]: Could not intialise CPU\n");
-        return 1;
+/* Auxillary carry after an add/subtract, indexed by bit 3 of operand A,
+   operand B and the result (see AC_INDEX) */
+static const uint8_t ac_add_table[8] = {0, 0, FLAG_AC, 0, FLAG_AC, 0, FLAG_AC, FLAG_AC};
+static const uint8_t ac_sub_table[8] = {FLAG_AC, 0, 0, 0, FLAG_AC, FLAG_AC, FLAG_AC, 0};
+
+#define AC_INDEX(a, b, result) ((((a) & 0x08) >> 1) | (((b) & 0x08) >> 2) | (((result) & 0x08) >> 3))
+#define CARRY_OUT(result) (((result) >> 8) & FLAG_C)
+
+#ifdef I8080_LAZY_FLAGS
+/* Record the last ALU op instead of computing flags. Bit 8 of the stored
+   result always holds the carry out, so Z/S/P/C can be read straight from it.
+   The result is stored first as INR/DCR read the previous carry to build it */
+#define LAZY_RECORD(cpu, kind, op_a, op_b, res) ((cpu)->lazy.result = (res), (cpu)->lazy.op = (kind), \
+                                                 (cpu)->lazy.a = (op_a), (cpu)->lazy.b = (op_b))
+#define FLAGS_ADD(cpu, a, b, result) LAZY_RECORD(cpu, LAZY_ADD, a, b, result)
+#define FLAGS_SUB(cpu, a, b, result) LAZY_RECORD(cpu, LAZY_SUB, a, b, result)
+#define FLAGS_AND(cpu, a, b, result) LAZY_RECORD(cpu, LAZY_AND, a, b, result)
+#define FLAGS_LOGIC(cpu, result) LAZY_RECORD(cpu, LAZY_LOGIC, 0, 0, result)
+#define FLAGS_INR(cpu, result) LAZY_RECORD(cpu, LAZY_INR, 0, 0, (result) | (FLAG_TEST(cpu, FLAG_C) << 8))
+#define FLAGS_DCR(cpu, result) LAZY_RECORD(cpu, LAZY_DCR, 0, 0, (result) | (FLAG_TEST(cpu, FLAG_C) << 8))
+#define FLAG_TEST(cpu, flag) ((cpu)->lazy.op == LAZY_NONE ? ((cpu)->flags & (flag)) : \
+                              (((flag) == FLAG_C) ? CARRY_OUT((cpu)->lazy.result) : (szp_table[(cpu)->lazy.result & 0xff] & (flag))))
+#define MATERIALIZE_FLAGS(cpu) do{ if((cpu)->lazy.op != LAZY_NONE) materialize_flags(cpu); }while(0)
+#else
+#define FLAGS_ADD(cpu, a, b, result) ((cpu)->flags = szp_table[(result) & 0xff] | CARRY_OUT(result) | ac_add_table[AC_INDEX(a, b, result)])
+#define FLAGS_SUB(cpu, a, b, result) ((cpu)->flags = szp_table[(result) & 0xff] | CARRY_OUT(result) | ac_sub_table[AC_INDEX(a, b, result)])
+#define FLAGS_AND(cpu, a, b, result) ((cpu)->flags = szp_table[result] | ((((a) | (b)) & 0x08) << 1)) //AC = OR of bit 3 of both operands
+#define FLAGS_LOGIC(cpu, result) ((cpu)->flags = szp_table[result])
+#define FLAGS_INR(cpu, result) ((cpu)->flags = ((cpu)->flags & FLAG_C) | szp_table[result] | ((((result) & 0x0f) == 0) ? FLAG_AC : 0))
+#define FLAGS_DCR(cpu, result) ((cpu)->flags = ((cpu)->flags & FLAG_C) | szp_table[result] | ((((result) & 0x0f) == 0x0f) ? 0 : FLAG_AC))
+#define FLAG_TEST(cpu, flag) ((cpu)->flags & (flag))
+#define MATERIALIZE_FLAGS(cpu) do{}while(0)
+#endif
+
+#ifdef I8080_FUSION
+/* A fused pair spans up to I8080_FUSE_MAX_BYTES, so a store to addr can change
+   the decoded entries starting anywhere in addr-4 to addr */
+#define INVALIDATE_DECODE(cpu, addr) do{ \
+        (cpu)->decode_cache[(uint16_t)(addr)].length = 0; \
+        (cpu)->decode_cache[(uint16_t)((addr) - 1)].length = 0; \
+        (cpu)->decode_cache[(uint16_t)((addr) - 2)].length = 0; \
+        (cpu)->decode_cache[(uint16_t)((addr) - 3)].length = 0; \
+        (cpu)->decode_cache[(uint16_t)((addr) - 4)].length = 0; \
+    }while(0)
+#elif defined(I8080_DECODE_CACHE)
+/* An instruction is at most 3 bytes long, so a store to addr can change the
+   decoded entries starting at addr, addr-1 and addr-2 */
+#define INVALIDATE_DECODE(cpu, addr) do{ \
+        (cpu)->decode_cache[(uint16_t)(addr)].length = 0; \
+        (cpu)->decode_cache[(uint16_t)((addr) - 1)].length = 0; \
+        (cpu)->decode_cache[(uint16_t)((addr) - 2)].length = 0; \
+    }while(0)
+#else
+#define INVALIDATE_DECODE(cpu, addr) do{}while(0)
+#endif
+
+#ifdef I8080_JIT
+/* Stores into translated code throw the translations away */
+#define INVALIDATE_JIT(cpu, addr) do{ \
+        if((cpu)->jit != NULL && JIT_IS_CODE((cpu)->jit, addr)) \
+            jit_invalidate(cpu, addr); \
+    }while(0)
+#else
+#define INVALIDATE_JIT(cpu, addr) do{}while(0)
+#endif
+
+#ifdef I8080_PROFILE
+/* Count an instruction about to run from PC, no branches */
+#define PROFILE(cpu, op) do{ \
+        (cpu)->profile.op_count[op]++; \
+        (cpu)->profile.op_cycles[op] += i8080_cycle_table[op]; \
+        (cpu)->profile.pc_count[(cpu)->pc]++; \
+        (cpu)->profile.last_op = (op); \
+    }while(0)
+#define PROFILE_TAKEN(cpu) ((cpu)->profile.op_cycles[(cpu)->profile.last_op] += I8080_COND_TAKEN_CYCLES)
+#else
+#define PROFILE(cpu, op) do{}while(0)
+#define PROFILE_TAKEN(cpu) do{}while(0)
+#endif
+
+#ifdef I8080_TRACE
+/* Record the instruction about to run from PC in the trace ring */
+#define TRACE(cpu, opcode, operand) do{ \
+        if((cpu)->trace != NULL){ \
+            i8080_trace_record_t *record = &(cpu)->trace->records[(cpu)->trace->count++ & (cpu)->trace->mask]; \
+            MATERIALIZE_FLAGS(cpu); \
+            record->cycles = (cpu)->cycles; \
+            record->pc = (cpu)->pc; \
+            record->sp = (cpu)->sp; \
+            record->bc = (cpu)->bc; \
+            record->de = (cpu)->de; \
+            record->hl = (cpu)->hl; \
+            record->psw = (cpu)->a << 8 | (cpu)->flags; \
+            record->imm = (operand); \
+            record->op = (opcode); \
+        } \
+    }while(0)
+#else
+#define TRACE(cpu, opcode, operand) do{}while(0)
+#endif
+
+#ifdef I8080_CALL_PROFILE
+/* PC has just moved to a subroutine, its return address is at SP */
+#define CALL_PROFILE_ENTER(cpu) do{ if((cpu)->call_profile != NULL) call_profile_enter(cpu); }while(0)
+#define CALL_PROFILE_LEAVE(cpu) do{ if((cpu)->call_profile != NULL) call_profile_leave(cpu); }while(0)
+#else
+#define CALL_PROFILE_ENTER(cpu) do{}while(0)
+#define CALL_PROFILE_LEAVE(cpu) do{}while(0)
+#endif
+
+const uint8_t i8080_reg_offset[8] = {
+    offsetof(i8080_state_t, b), offsetof(i8080_state_t, c), offsetof(i8080_state_t, d), offsetof(i8080_state_t, e),
+    offsetof(i8080_state_t, h), offsetof(i8080_state_t, l), 0, offsetof(i8080_state_t, a)
+};
+
+#define PAGE(addr) ((uint16_t)(addr) >> I8080_PAGE_SHIFT)
+#define PAGE_OFFSET(addr) ((addr) & (I8080_PAGE_SIZE - 1))
+
+/* Note a store to the page for the next snapshot take or restore */
+#define MARK_DIRTY(cpu, page) ((cpu)->dirty[(page) >> 6] |= 1ULL << ((page) & 63))
+
+/* True if the page's bytes can be cached by address: RAM and ROM. Mirror
+   pages are only coherent uncached, MMIO can change under us */
+#define PAGE_CACHEABLE(cpu, addr) ((cpu)->map.kind[PAGE(addr)] <= I8080_PAGE_ROM)
+
+/* Store to a ROM, mirror or MMIO page */
+static void write_slow(i8080_state_t *cpu, uint16_t addr, uint8_t value){
+    uint8_t page = PAGE(addr);
+
+    switch(cpu->map.kind[page]){
+        case I8080_PAGE_MIRROR:
+            {
+                uint16_t source = (cpu->map.alias[page] << I8080_PAGE_SHIFT) | PAGE_OFFSET(addr);
+                if(cpu->map.kind[PAGE(source)] == I8080_PAGE_RAM){
+                    cpu->map.read[page][PAGE_OFFSET(addr)] = value;
+                    MARK_DIRTY(cpu, PAGE(source));
+                    INVALIDATE_DECODE(cpu, source);
+                    INVALIDATE_JIT(cpu, source);
+                }
+            }
+            break;
+        case I8080_PAGE_MMIO:
+            if(cpu->map.mmio_write[page] != NULL){
+                cpu->map.mmio_write[page](cpu->map.mmio_ctx[page], addr, value);
+            }
+            break;
+        default:
+            break; //ROM
     }
+}
 
-    //Get ROM filename to load
-    if(argc < 2){
-        fprintf(stderr, "[ERROR]: No input file provided\n");
-        return 1;
+/* Load from an MMIO page */
+static uint8_t read_slow(i8080_state_t *cpu, uint16_t addr){
+    uint8_t page = PAGE(addr);
+    if(cpu->map.mmio_read[page] != NULL){
+        return cpu->map.mmio_read[page](cpu->map.mmio_ctx[page], addr);
     }
+    return 0xff; //Open bus
+}
 
-    char *rom_filename = *(argv+1);
-    printf("Loading ROM File: %s\n", rom_filename);
+/* Store a byte to memory. All CPU stores go through here */
+static inline void write_byte(i8080_state_t *cpu, uint16_t addr, uint8_t value){
+    uint8_t *page = cpu->map.write[PAGE(addr)];
+    if(page != NULL){
+        page[PAGE_OFFSET(addr)] = value;
+        MARK_DIRTY(cpu, PAGE(addr));
+        INVALIDATE_DECODE(cpu, addr);
+        INVALIDATE_JIT(cpu, addr);
+    }else{
+        write_slow(cpu, addr, value);
+    }
+}
 
-    // if(load_rom(cpu, rom_filename) != I8080_OK){
-    //     fprintf(stderr, "[ERROR]: did not load ROM\n");
-    //     return 1;
-    // }
+/* Load a byte from memory. All CPU loads go through here */
+static inline uint8_t read_byte(i8080_state_t *cpu, uint16_t addr){
+    uint8_t *page = cpu->map.read[PAGE(addr)];
+    if(page != NULL){
+        return page[PAGE_OFFSET(addr)];
+    }
+    return read_slow(cpu, addr);
+}
 
-    cpu->pc = 0;
-    cpu->flags.c = 0;
-    cpu->flags.ac = 0;
-    cpu->flags.z = 0;
-    cpu->flags.s = 0;
-    cpu->flags.p = 0;
+/* Store a byte on behalf of code outside the interpreter (e.g. the JIT) */
+void write_memory(i8080_state_t *cpu, uint16_t addr, uint8_t value){
+    write_byte(cpu, addr, value);
+}
 
-    // //TEST RUN
-    // while(cpu->pc < cpu->loaded_rom_size){
-    //     run_instruction(cpu);
-    // }
-    // run_instruction(cpu);
+/* Load a byte on behalf of code outside the interpreter */
+uint8_t read_memory(i8080_state_t *cpu, uint16_t addr){
+    return read_byte(cpu, addr);
+}
 
-    // test_inr(cpu);
-    // test_dcr(cpu);
-    // test_mvi(cpu);
-    test_ldax(cpu);
+/* Check a mapping request covers whole pages inside the address space */
+static int map_range_ok(uint16_t start, uint32_t length){
+    if(PAGE_OFFSET(start) != 0 || PAGE_OFFSET(length) != 0 || length == 0 ||
+       start + length > I8080_MAX_MEMORY_SIZE){
+        fprintf(stderr, "[ERROR]: Memory map range %04X+%X is not whole pages\n", start, length);
+        return 0;
+    }
+    return 1;
+}
 
-    if (cpu)
-        free(cpu);
+/* Cached decodes and translations of remapped or rewritten pages are stale */
+void invalidate_range(i8080_state_t *cpu, uint16_t start, uint32_t length){
+#ifdef I8080_DECODE_CACHE
+    if(cpu->decode_cache != NULL){
+        //Entries up to 4 bytes before the range can cover it, see INVALIDATE_DECODE
+        for(uint32_t addr = start; addr < start + length + 4; addr++){
+            cpu->decode_cache[(uint16_t)(addr - 4)].length = 0;
+        }
+    }
+#endif
+#ifdef I8080_JIT
+    if(cpu->jit != NULL){
+        for(uint32_t addr = start; addr < start + length; addr++){
+            if(JIT_IS_CODE(cpu->jit, addr)){
+                jit_invalidate(cpu, addr);
+                break;
+            }
+        }
+    }
+#endif
+    (void)cpu;
+    (void)start;
+    (void)length;
+}
 
-    return 0;
+/* Map [start, start+length) onto cpu->memory at the same address */
+static int map_direct(i8080_state_t *cpu, uint16_t start, uint32_t length, uint8_t kind){
+    if(!map_range_ok(start, length)){
+        return I8080_ERROR;
+    }
+    for(uint32_t page = PAGE(start); page < PAGE(start) + length / I8080_PAGE_SIZE; page++){
+        uint8_t *host = cpu->memory + (page << I8080_PAGE_SHIFT);
+        cpu->map.read[page] = host;
+        cpu->map.write[page] = kind == I8080_PAGE_RAM ? host : NULL;
+        cpu->map.kind[page] = kind;
+        cpu->map.alias[page] = page;
+        cpu->map.mmio_read[page] = NULL;
+        cpu->map.mmio_write[page] = NULL;
+        cpu->map.mmio_ctx[page] = NULL;
+    }
+    invalidate_range(cpu, start, length);
+    return I8080_OK;
 }
 
-void display_flags(i8080_state_t *cpu){
-    printf("C:  %d\n", cpu->flags.c);
-    printf("AC: %d\n", cpu->flags.ac);
-    printf("S:  %d\n", cpu->flags.s);
-    printf("P:  %d\n", cpu->flags.p);
-    printf("Z:  %d\n", cpu->flags.z);
+int map_ram(i8080_state_t *cpu, uint16_t start, uint32_t length){
+    return map_direct(cpu, start, length, I8080_PAGE_RAM);
+}
+
+/* Stores to ROM pages are ignored */
+int map_rom(i8080_state_t *cpu, uint16_t start, uint32_t length){
+    return map_direct(cpu, start, length, I8080_PAGE_ROM);
 }
 
-void check_flags(i8080_state_t *cpu, uint16_t result, uint8_t mask){
-    if (mask & FLAG_Z)
-        cpu->flags.z = ((result & 0xff) == 0); //Zero flag
-    if (mask & FLAG_C)
-        cpu->flags.c = (result > 0xff); //Carry flag
-    if (mask & FLAG_AC)
-        cpu->flags.ac = (result & (1<<3)) != 0; //Check state of 4th bit
-    if (mask & FLAG_S) //Sign
-        cpu->flags.s = ((result & 0x80) != 0); //Check HSB
-    if (mask & FLAG_P){ //Parity: 1=even, 0=odd
-        uint16_t x = result & 0xff;
-        x ^= x >> 4;
-        x ^= x >> 2;
-        x ^= x >> 1;
-        cpu->flags.p = ~(x & 1);
+/* Make [start, start+length) show the RAM or ROM pages from [source] on */
+int map_mirror(i8080_state_t *cpu, uint16_t start, uint32_t length, uint16_t source){
+    if(!map_range_ok(start, length) || !map_range_ok(source, length)){
+        return I8080_ERROR;
     }
+    for(uint32_t i = 0; i < length / I8080_PAGE_SIZE; i++){
+        uint8_t page = PAGE(start) + i;
+        uint8_t from = PAGE(source) + i;
+        if(cpu->map.kind[from] > I8080_PAGE_ROM){
+            fprintf(stderr, "[ERROR]: Page %02X to mirror is not RAM or ROM\n", from);
+            return I8080_ERROR;
+        }
+        cpu->map.read[page] = cpu->map.read[from];
+        cpu->map.write[page] = NULL; //Slow path keeps the source page's caches coherent
+        cpu->map.kind[page] = I8080_PAGE_MIRROR;
+        cpu->map.alias[page] = from;
+        cpu->map.mmio_read[page] = NULL;
+        cpu->map.mmio_write[page] = NULL;
+        cpu->map.mmio_ctx[page] = NULL;
+    }
+    invalidate_range(cpu, start, length);
+    return I8080_OK;
 }
 
-void clear_flags(i8080_state_t *cpu){
-    cpu->flags.c = 0;
-    cpu->flags.ac = 0;
-    cpu->flags.p = 0;
-    cpu->flags.s = 0;
-    cpu->flags.z = 0;
+/* Route every access to [start, start+length) to the handlers. A NULL read
+   handler reads 0xFF, a NULL write handler drops the store */
+int map_mmio(i8080_state_t *cpu, uint16_t start, uint32_t length,
+             i8080_mmio_read_t read, i8080_mmio_write_t write, void *ctx){
+    if(!map_range_ok(start, length)){
+        return I8080_ERROR;
+    }
+    for(uint32_t page = PAGE(start); page < PAGE(start) + length / I8080_PAGE_SIZE; page++){
+        cpu->map.read[page] = NULL;
+        cpu->map.write[page] = NULL;
+        cpu->map.kind[page] = I8080_PAGE_MMIO;
+        cpu->map.alias[page] = page;
+        cpu->map.mmio_read[page] = read;
+        cpu->map.mmio_write[page] = write;
+        cpu->map.mmio_ctx[page] = ctx;
+    }
+    invalidate_range(cpu, start, length);
+    return I8080_OK;
 }
 
-/* Increase value in register */
-void inr(i8080_state_t *cpu, uint8_t *reg){
-    uint16_t result = *reg + 1;
-    check_flags(cpu, result, FLAG_Z|FLAG_S|FLAG_P|FLAG_AC);
-    *reg = result & 0xff;
+/* Map the whole address space as RAM on cpu->memory */
+void reset_memory_map(i8080_state_t *cpu){
+    map_ram(cpu, 0, I8080_MAX_MEMORY_SIZE);
 }
 
-/* Increase 16-bit regsiter pair */
-void inx(uint8_t *reg_hi, uint8_t *reg_lo){
-    uint16_t result = (((*reg_hi << 8) | *reg_lo) + 1);
-    *reg_hi = result >> 8;
-    *reg_lo = result & 0xff;  
+/* Copy src's page table to dst, moving pages that point into src->memory
+   onto dst->memory. MMIO handlers are shared */
+void clone_memory_map(i8080_state_t *dst, const i8080_state_t *src){
+    dst->map = src->map;
+    for(int page = 0; page < I8080_PAGE_COUNT; page++){
+        uint8_t *host = src->map.read[page];
+        if(host != NULL && host >= src->memory && host < src->memory + I8080_MAX_MEMORY_SIZE){
+            dst->map.read[page] = dst->memory + (host - src->memory);
+            if(dst->map.write[page] != NULL){
+                dst->map.write[page] = dst->map.read[page];
+            }
+        }
+    }
 }
 
-/* Decrease value in register */
-void dcr(i8080_state_t *cpu, uint8_t *reg){
-    uint16_t result = *reg - 1;
-    check_flags(cpu, result, FLAG_Z|FLAG_S|FLAG_P|FLAG_AC);
-    *reg = result & 0xff;
+/* Operand bytes of an instruction of [length] at addr, only the bytes it has
+   are read so MMIO sees no stray loads */
+#define FETCH_OPERAND(cpu, addr, length) \
+    ((length) == 3 ? MERGE_16BIT(read_byte(cpu, (addr) + 2), read_byte(cpu, (addr) + 1)) : \
+     (length) == 2 ? read_byte(cpu, (addr) + 1) : 0)
+
+#ifdef I8080_FUSION
+const char *const i8080_fuse_names[I8080_FUSE_COUNT] = {
+    "NONE",
+    "DCR B + JNZ", "DCR C + JNZ", "DCR D + JNZ", "DCR E + JNZ", "DCR H + JNZ", "DCR L + JNZ", "DCR A + JNZ",
+    "INX H + MOV B,M", "INX H + MOV C,M", "INX H + MOV D,M", "INX H + MOV E,M",
+    "INX H + MOV H,M", "INX H + MOV L,M", "INX H + MOV A,M",
+    "LDAX B + MOV M,A", "LDAX D + MOV M,A",
+    "CPI + JZ", "CPI + JNZ"
+};
+
+/* Register field (0-5, 7 for A) to its place in a run of per-register FUSE_ kinds */
+static const uint8_t fuse_reg_index[8] = {0, 1, 2, 3, 4, 5, 0, 6};
+
+/* FUSE_ kind for the instruction op at addr followed by op2 */
+static uint8_t fuse_kind(uint8_t op, uint8_t op2){
+    uint8_t reg = (op >> 3) & 7;
+
+    if((op & 0xC7) == 0x05 && reg != 6 && op2 == 0xC2) // DCR r + JNZ
+        return FUSE_DCR_B_JNZ + fuse_reg_index[reg];
+    if(op == 0x23 && (op2 & 0xC7) == 0x46 && op2 != 0x76) // INX H + MOV r,M
+        return FUSE_INX_H_MOV_B_M + fuse_reg_index[(op2 >> 3) & 7];
+    if((op == 0x0A || op == 0x1A) && op2 == 0x77) // LDAX rp + MOV M,A
+        return op == 0x0A ? FUSE_LDAX_B_MOV_M_A : FUSE_LDAX_D_MOV_M_A;
+    if(op == 0xFE && (op2 == 0xCA || op2 == 0xC2)) // CPI + JZ/JNZ
+        return op2 == 0xCA ? FUSE_CPI_JZ : FUSE_CPI_JNZ;
+    return FUSE_NONE;
 }
+#endif
 
-void dcx(uint8_t *reg_hi, uint8_t *reg_lo){
-    uint16_t result = (((*reg_hi << 8) | *reg_lo) - 1);
-    *reg_hi = result >> 8;
-    *reg_lo = result & 0xff;
+#ifdef I8080_DECODE_CACHE
+/* Decode the instruction at addr into its decode cache entry */
+static inline i8080_decoded_t *decode_instruction(i8080_state_t *cpu, uint16_t addr){
+    i8080_decoded_t *decoded = &cpu->decode_cache[addr];
+    uint8_t length;
+    decoded->op = read_byte(cpu, addr);
+    length = i8080_length_table[decoded->op];
+    decoded->imm = FETCH_OPERAND(cpu, addr, length);
+#ifdef I8080_FUSION
+    decoded->fused = FUSE_NONE;
+    if(PAGE_CACHEABLE(cpu, addr) && PAGE_CACHEABLE(cpu, addr + I8080_FUSE_MAX_BYTES - 1)){
+        uint16_t next = addr + length;
+        uint8_t op2 = read_byte(cpu, next);
+        decoded->fused = fuse_kind(decoded->op, op2);
+        //Every pair's operand lies inside the checked window, lone ops read nothing past it
+        if(decoded->fused != FUSE_NONE){
+            decoded->fused_imm = FETCH_OPERAND(cpu, next, i8080_length_table[op2]);
+        }
+    }
+#endif
+    //Entries on mirror and MMIO pages are decoded again on every fetch
+    decoded->length = PAGE_CACHEABLE(cpu, addr) && PAGE_CACHEABLE(cpu, addr + length - 1) ? length : 0;
+    return decoded;
+}
+
+/* Allocate an empty decode cache covering the whole address space, or empty
+   the one already allocated */
+int init_decode_cache(i8080_state_t *cpu){
+    if(cpu->decode_cache != NULL){
+        //Already allocated with the arena, start it over empty
+        memset(cpu->decode_cache, 0, (I8080_MAX_ADDRESS + 1) * sizeof(i8080_decoded_t));
+    }else if((cpu->decode_cache = calloc(I8080_MAX_ADDRESS + 1, sizeof(i8080_decoded_t))) == NULL){
+        return I8080_ERROR;
+    }
+#ifdef I8080_FUSION
+    memset(cpu->fusion_hits, 0, sizeof(cpu->fusion_hits));
+#endif
+    return I8080_OK;
+}
+
+void free_decode_cache(i8080_state_t *cpu){
+    free(cpu->decode_cache);
+    cpu->decode_cache = NULL;
+}
+
+/* Eagerly decode every address in [start, start+length) */
+void predecode_range(i8080_state_t *cpu, uint16_t start, uint32_t length){
+    for(uint32_t i = 0; i < length; i++){
+        decode_instruction(cpu, start + i);
+    }
+}
+#endif
+
+#ifdef I8080_LAZY_FLAGS
+/* Compute the flags byte from the recorded ALU op */
+void materialize_flags(i8080_state_t *cpu){
+    uint16_t result = cpu->lazy.result;
+    uint8_t flags = szp_table[result & 0xff] | CARRY_OUT(result);
+
+    switch(cpu->lazy.op){
+        case LAZY_ADD:
+            flags |= ac_add_table[AC_INDEX(cpu->lazy.a, cpu->lazy.b, result)];
+            break;
+        case LAZY_SUB:
+            flags |= ac_sub_table[AC_INDEX(cpu->lazy.a, cpu->lazy.b, result)];
+            break;
+        case LAZY_AND:
+            flags |= ((cpu->lazy.a | cpu->lazy.b) & 0x08) << 1;
+            break;
+        case LAZY_INR:
+            flags |= ((result & 0x0f) == 0) ? FLAG_AC : 0;
+            break;
+        case LAZY_DCR:
+            flags |= ((result & 0x0f) == 0x0f) ? 0 : FLAG_AC;
+            break;
+        default:
+            break;
+    }
+    cpu->flags = flags;
+    cpu->lazy.op = LAZY_NONE;
+}
+#endif
+
+/* Get the PSW flags byte, computing any pending lazy flags first */
+uint8_t get_flags(i8080_state_t *cpu){
+    MATERIALIZE_FLAGS(cpu);
+    return cpu->flags;
+}
+
+#ifdef I8080_FUSION
+/* Print how often each fused pair ran */
+void display_fusion_stats(i8080_state_t *cpu){
+    for(int kind = FUSE_NONE + 1; kind < I8080_FUSE_COUNT; kind++){
+        printf("%-18s %llu\n", i8080_fuse_names[kind], (unsigned long long)cpu->fusion_hits[kind]);
+    }
+}
+#endif
+
+void display_flags(i8080_state_t *cpu){
+    MATERIALIZE_FLAGS(cpu);
+    printf("C:  %d\n", FLAG_TEST(cpu, FLAG_C) != 0);
+    printf("AC: %d\n", (cpu->flags & FLAG_AC) != 0);
+    printf("S:  %d\n", FLAG_TEST(cpu, FLAG_S) != 0);
+    printf("P:  %d\n", FLAG_TEST(cpu, FLAG_P) != 0);
+    printf("Z:  %d\n", FLAG_TEST(cpu, FLAG_Z) != 0);
+}
+
+void clear_flags(i8080_state_t *cpu){
+#ifdef I8080_LAZY_FLAGS
+    cpu->lazy.op = LAZY_NONE;
+#endif
+    cpu->flags = I8080_FLAGS_DEFAULT;
+}
+
+/* Increase value in register. Carry is left unchanged */
+void inr(i8080_state_t *cpu, uint8_t *reg){
+    uint8_t result = *reg + 1;
+    FLAGS_INR(cpu, result);
+    *reg = result;
+}
+
+/* Decrease value in register. Carry is left unchanged */
+void dcr(i8080_state_t *cpu, uint8_t *reg){
+    uint8_t result = *reg - 1;
+    FLAGS_DCR(cpu, result);
+    *reg = result;
 }
 
 /* Move a given value into a register */
@@ -126,7 +521,7 @@ void mvi(uint8_t *reg, uint8_t value){
 /* LDAX [reg], mem[addr] -- Load data from memory address into a register */
 void ldax(i8080_state_t *cpu, uint8_t *reg, uint16_t addr){
     if(addr <= I8080_MAX_ADDRESS){
-        *reg = cpu->memory[addr];
+        *reg = read_byte(cpu, addr);
     }else{
         fprintf(stderr, "Address exceeds CPU memory\n");
     }
@@ -134,76 +529,96 @@ void ldax(i8080_state_t *cpu, uint8_t *reg, uint16_t addr){
 
 /* STAX [addr]. Store accumulator in address from register pair */
 void stax(i8080_state_t *cpu, uint16_t addr){
-    cpu->memory[addr] = cpu->a;
+    write_byte(cpu, addr, cpu->a);
 }
 
 /* ADD [reg] - add value in register to current value in accumulator */
 void add(i8080_state_t *cpu, uint8_t *reg){
     uint16_t result = cpu->a + *reg;
-    check_flags(cpu, result, FLAG_Z|FLAG_S|FLAG_P|FLAG_C|FLAG_AC);
+    FLAGS_ADD(cpu, cpu->a, *reg, result);
     cpu->a = result & 0xff;
 }
 
 /* ADC [reg] - add register value to A + carry bit */
 void adc(i8080_state_t *cpu, uint8_t *reg){
-    uint16_t result = (cpu->a + *reg + cpu->flags.c);
-    check_flags(cpu, result, FLAG_Z|FLAG_S|FLAG_P|FLAG_C|FLAG_AC);
+    uint16_t result = cpu->a + *reg + FLAG_TEST(cpu, FLAG_C);
+    FLAGS_ADD(cpu, cpu->a, *reg, result);
     cpu->a = result & 0xff;
 }
 
 /* SUB [reg] - subtract value in register to current value in accumulator */
 void sub(i8080_state_t *cpu, uint8_t *reg){
     uint16_t result = cpu->a - *reg;
-    check_flags(cpu, result, FLAG_Z|FLAG_S|FLAG_P|FLAG_C|FLAG_AC);
+    FLAGS_SUB(cpu, cpu->a, *reg, result);
     cpu->a = result & 0xff;
 }
 
 /* SBB [reg] - subtract register value to A - carry bit */
 void sbb(i8080_state_t *cpu, uint8_t *reg){
-    uint16_t result = (cpu->a - *reg - cpu->flags.c);
-    check_flags(cpu, result, FLAG_Z|FLAG_S|FLAG_P|FLAG_C|FLAG_AC);
+    uint16_t result = cpu->a - *reg - FLAG_TEST(cpu, FLAG_C);
+    FLAGS_SUB(cpu, cpu->a, *reg, result);
     cpu->a = result & 0xff;
 }
 
 /* ANA [reg] - Logical AND of register and accumulator. Carry is reset to 0 */
 void ana(i8080_state_t *cpu, uint8_t *reg){
-    cpu->a = cpu->a & *reg;
-    check_flags(cpu, (uint16_t)cpu->a, FLAG_S|FLAG_Z|FLAG_P|FLAG_C);
+    uint8_t result = cpu->a & *reg;
+    FLAGS_AND(cpu, cpu->a, *reg, result);
+    cpu->a = result;
 }
 
 /* XRA [reg] - Logical XOR of register and accumulator. Carry is reset to 0 */
 void xra(i8080_state_t *cpu, uint8_t *reg){
     cpu->a = cpu->a ^ *reg;
-    check_flags(cpu, (uint16_t)cpu->a, FLAG_S|FLAG_Z|FLAG_P|FLAG_C|FLAG_AC); 
+    FLAGS_LOGIC(cpu, cpu->a);
 }
 
 /* ORA [reg] - Logical OR of register and accumulator. Carry is reset to 0 */
 void ora(i8080_state_t *cpu, uint8_t *reg){
     cpu->a = cpu->a | *reg;
-    check_flags(cpu, (uint16_t)cpu->a, FLAG_S|FLAG_Z|FLAG_P|FLAG_C);
+    FLAGS_LOGIC(cpu, cpu->a);
 }
 
-/* CMP [reg] - Set Z flag = 1 if [reg] == A, else set Z=0 */
+/* CMP [reg] - Compare register with A by subtraction, A is left unchanged */
 void cmp(i8080_state_t *cpu, uint8_t *reg){
     uint16_t result = cpu->a - *reg;
-    check_flags(cpu, result, FLAG_Z|FLAG_S|FLAG_P|FLAG_AC|FLAG_C);
-    cpu->flags.z = (cpu->a == *reg) ? 1 : 0;
+    FLAGS_SUB(cpu, cpu->a, *reg, result);
+}
+
+/* DAA - Adjust accumulator to two BCD digits after an addition */
+void daa(i8080_state_t *cpu){
+    uint8_t correction = 0;
+    uint8_t carry;
+    uint16_t result;
+
+    MATERIALIZE_FLAGS(cpu);
+    carry = cpu->flags & FLAG_C;
+    uint8_t lsb = cpu->a & 0x0f;
+    uint8_t msb = cpu->a >> 4;
+
+    if((cpu->flags & FLAG_AC) || lsb > 9)
+        correction |= 0x06;
+    if(carry || msb > 9 || (msb >= 9 && lsb > 9)){
+        correction |= 0x60;
+        carry = FLAG_C;
+    }
+    result = (cpu->a + correction) | (carry << 8); //Carry is kept if already set
+    FLAGS_ADD(cpu, cpu->a, correction, result);
+    cpu->a = result & 0xff;
 }
 
 /* RET - Replace program-counter by value addressed by stack pointer */
 void ret(i8080_state_t *cpu){
     // PC.lo <- (sp); PC.hi<-(sp+1); SP <- SP+2
-    uint8_t d16_l = cpu->memory[cpu->sp];
-    uint8_t d16_h = cpu->memory[cpu->sp+1];
-    cpu->pc = MERGE_16BIT(d16_h, d16_l);
-    cpu->sp += 2;
+    cpu->pc = pop(cpu);
+    CALL_PROFILE_LEAVE(cpu);
 }
 
-/* POP - Replace value in register pair with that help at data addressed by stack pointer */
-void pop(i8080_state_t *cpu, uint8_t *reg_hi, uint8_t *reg_lo){
-    *reg_hi = cpu->memory[cpu->sp+1];
-    *reg_lo = cpu->memory[cpu->sp];
+/* POP - Return the 16-bit value addressed by the stack pointer, for a register pair */
+uint16_t pop(i8080_state_t *cpu){
+    uint16_t value = MERGE_16BIT(read_byte(cpu, cpu->sp + 1), read_byte(cpu, cpu->sp));
     cpu->sp += 2;
+    return value;
 }
 
 /* JMP - Program counter is moved to address given */
@@ -213,17 +628,56 @@ void jmp(i8080_state_t *cpu, uint16_t addr){
 
 /* CALL - Push Return pos onto stack. Move PC to target address */
 void call(i8080_state_t *cpu, uint16_t addr){
-    uint16_t ret = cpu->pc + 2; //We want to return to just after this instruction
-    cpu->memory[cpu->sp - 1] = ret & 0xff; // Push current position onto the stack
-    cpu->memory[cpu->sp - 2] = (ret >> 8) & 0xff;
-    cpu->sp -= 2; // Reset stack pointer to the address we just pushed
+    push(cpu, cpu->pc + 2); //We want to return to just after this instruction
     cpu->pc = addr; // Move PC to target
+    CALL_PROFILE_ENTER(cpu);
 }
 
-/* PUSH - Push register pair data onto stack */
-void push(i8080_state_t *cpu, uint8_t *reg_hi, uint8_t *reg_lo){
-    cpu->memory[cpu->sp - 2] = *reg_lo;
-    cpu->memory[cpu->sp - 1] = *reg_hi;
+/* Conditional RET - Return if condition is met, taken branch costs extra cycles */
+void cond_ret(i8080_state_t *cpu, uint8_t condition){
+    if(condition){
+        ret(cpu);
+        cpu->cycles += I8080_COND_TAKEN_CYCLES;
+        PROFILE_TAKEN(cpu);
+    }
+}
+
+/* Conditional CALL - Call if condition is met, otherwise skip address operand */
+void cond_call(i8080_state_t *cpu, uint8_t condition, uint16_t addr){
+    if(condition){
+        call(cpu, addr);
+        cpu->cycles += I8080_COND_TAKEN_CYCLES;
+        PROFILE_TAKEN(cpu);
+    }else{
+        cpu->pc += 2;
+    }
+}
+
+/* RST - Call the restart vector n * 8 */
+void rst(i8080_state_t *cpu, uint8_t n){
+    push(cpu, cpu->pc);
+    cpu->pc = n << 3;
+    CALL_PROFILE_ENTER(cpu);
+}
+
+/* Raise an interrupt that executes RST n. It is latched until EI if
+   interrupts are off, and accepting it wakes a halted CPU */
+void interrupt(i8080_state_t *cpu, uint8_t n){
+    if(!cpu->int_enable){
+        cpu->int_request = 0xC7 | (n << 3);
+        return;
+    }
+    cpu->int_request = 0;
+    cpu->int_enable = 0;
+    cpu->halted = 0;
+    rst(cpu, n);
+    cpu->cycles += I8080_RST_CYCLES;
+}
+
+/* PUSH - Push a 16-bit value (register pair) onto stack */
+void push(i8080_state_t *cpu, uint16_t value){
+    write_byte(cpu, cpu->sp - 2, value & 0xff);
+    write_byte(cpu, cpu->sp - 1, value >> 8);
     cpu->sp -= 2;
 }
 
@@ -256,914 +710,1137 @@ void test_dcr(i8080_state_t *cpu){
     display_flags(cpu);
 }
 
+#ifdef I8080_FUSION
+/* Run the fused pair when the budget would not have stopped between its two
+   instructions. d16 then holds the operand of the second one */
+#define FUSE(decoded) do{ \
+        if((decoded)->fused != FUSE_NONE && cpu->cycles < target){ \
+            op = I8080_FUSE_BASE + (decoded)->fused; \
+            d16 = (decoded)->fused_imm; \
+            cpu->fusion_hits[(decoded)->fused]++; \
+        } \
+    }while(0)
+#else
+#define FUSE(decoded) do{}while(0)
+#endif
+
+/* Fetch the op-code at PC and its two operand bytes, then charge its cycles.
+   PC is left pointing at the first operand byte */
+#ifdef I8080_DECODE_CACHE
+#define FETCH() do{ \
+        i8080_decoded_t *decoded = &cpu->decode_cache[cpu->pc]; \
+        if(decoded->length == 0) \
+            decoded = decode_instruction(cpu, cpu->pc); \
+        op = decoded->op; \
+        d16 = decoded->imm; \
+        d8 = d16 & 0xff; \
+        PROFILE(cpu, op); \
+        cpu->cycles += i8080_cycle_table[op]; \
+        TRACE(cpu, op, d16); \
+        cpu->pc++; \
+        FUSE(decoded); \
+    }while(0)
+#else
+#define FETCH() do{ \
+        uint8_t *page = cpu->map.read[PAGE(cpu->pc)]; \
+        if(page != NULL && PAGE_OFFSET(cpu->pc) < I8080_PAGE_SIZE - 2){ \
+            op = page[PAGE_OFFSET(cpu->pc)]; \
+            d16 = MERGE_16BIT(page[PAGE_OFFSET(cpu->pc) + 2], page[PAGE_OFFSET(cpu->pc) + 1]); \
+        }else{ \
+            op = read_byte(cpu, cpu->pc); \
+            d16 = FETCH_OPERAND(cpu, cpu->pc, i8080_length_table[op]); \
+        } \
+        d8 = d16 & 0xff; \
+        PROFILE(cpu, op); \
+        cpu->cycles += i8080_cycle_table[op]; \
+        TRACE(cpu, op, d16); \
+        cpu->pc++; \
+    }while(0)
+#endif
+
+#ifdef I8080_FUSION
+#define I8080_DISPATCH_SIZE (I8080_FUSE_BASE + I8080_FUSE_COUNT)
+
+/* Start the second instruction of a fused pair. PC is left at its first operand byte */
+#define FUSED_SECOND(op2) do{ \
+        PROFILE(cpu, op2); \
+        cpu->cycles += i8080_cycle_table[op2]; \
+        TRACE(cpu, op2, d16); \
+        cpu->pc++; \
+    }while(0)
+
+/* JNZ as the second half of a pair, d16 holds its target */
+#define FUSED_JNZ() do{ \
+        FUSED_SECOND(0xC2); \
+        cpu->pc = FLAG_TEST(cpu, FLAG_Z) ? cpu->pc + 2 : d16; \
+    }while(0)
+#else
+#define I8080_DISPATCH_SIZE (256)
+#endif
+
+/* Taken JMP/Jcc, PC at the address operand. A short backward jump may close
+   an idle loop, see idle_check() */
+#define JUMP(addr) do{ \
+        uint16_t jump_from = cpu->pc + 2; \
+        cpu->pc = (addr); \
+        if((uint16_t)(jump_from - cpu->pc) <= I8080_IDLE_MAX_LOOP && cpu->idle.enabled) \
+            idle_check(cpu, jump_from, target); \
+    }while(0)
+
+#ifdef I8080_THREADED_CORE
+/* Threaded core: every handler ends in its own indirect jump to the next one */
+#define DISPATCH(op) goto *dispatch[op];
+#define OP(n) op_##n:
+#define NEXT do{ if(cpu->cycles >= target) goto done; FETCH(); goto *dispatch[op]; }while(0)
+#else
+/* Switch core: a single shared dispatch branch at the top of the loop */
+#define DISPATCH(op) switch(op)
+#define OP(n) case n:
+#define NEXT break
+#endif
+
+static int execute(i8080_state_t *cpu, uint64_t target);
+
+/* Execute a single instruction. Events are not serviced, see run_cycles() */
 int run_instruction(i8080_state_t *cpu){
-    unsigned char *op = &cpu->memory[cpu->pc]; // Get op-code at program counter position
-    unsigned char d16_l = cpu->memory[cpu->pc + 1];
-    unsigned char d16_h = cpu->memory[cpu->pc + 2];
-    cpu->pc++; //Increment Program Counter - some instructions will apply extra increments to PC
-
-    //Parse for OP-Code
-    switch(*op){
-        case 0x00: break; //NOP
-        case 0x01: //LXI BC,D16
-            cpu->b = d16_h;
-            cpu->c = d16_l;
-            cpu->pc += 2;
-            printf("0x%04X written to BC\n", (cpu->b<<8 | cpu->c));
-            break;
-        case 0x02: //STAX BC
-            cpu->memory[(cpu->b <<8) | cpu->c] = cpu->a;
-            break;
-        case 0x03: //INX BC
-            inx(&(cpu->b), &(cpu->c));
-            break;
-        case 0x04: //INR B
-            inr(cpu, &(cpu->b));
-            break;
-        case 0x05: //DCR B
-            dcr(cpu, &(cpu->b));
-            break;
-        case 0x06: //MVI B
-            mvi(&(cpu->b), d16_l);
-            cpu->pc++;
-            break;
-        case 0x07: //RLC - Rotate accumulator left
-            cpu->flags.c = cpu->a & 0x40;
-            cpu->a = ((cpu->a << 1) | (cpu->a >> 7)) & 0xff;
-            break;
-        case 0x08: break; //NOP
-        case 0x09: //DAD BC (Add BC reg to HL reg)
-            {
-                uint16_t result = ((cpu->h << 8) | cpu->l) + ((cpu->b << 8) | cpu->c);
-                check_flags(cpu, result, FLAG_C);
-                cpu->h = ((result>>8) & 0xff);
-                cpu->l = (result & 0xff);
-            }
-        case 0x0A: //LDAX BC (Load BC into A)
-            ldax(cpu, &(cpu->a), ((cpu->b <<8) | cpu->c));
-            break;
-        case 0x0B: //DCX BC
-            dcx(&(cpu->b), &(cpu->c));
-            break;
-        case 0x0C: //INR C
-            inr(cpu, &(cpu->c));
-            break;
-        case 0x0D: //DCR C
-            dcr(cpu, &(cpu->c));
-            break;
-        case 0x0E: //MVI C,D8 (Move 8-bit value into C)
-            mvi(&(cpu->c), d16_l);
-            cpu->pc++;
-            break;
-        case 0x0F: //RRC (Rotate accumulator right)
-            cpu->flags.c = cpu->a & 0x1; //Carry bit = current A[0]
-            cpu->a = ((cpu->a >> 1) | (cpu->a << 7)) & 0xff;
-            break;
-        case 0x10: //NOP
-            break;
-        case 0x11: //LXI D, D16 (Load value in DE)
-            cpu->d = d16_h;
-            cpu->e = d16_l;
-            cpu->pc += 2;
-            break;
-        case 0x12: //STAX D (Load A into memory addressed by DE)
-            stax(cpu, ((cpu->d << 8) | cpu->e));
-            break;
-        case 0x13: //INX DE
-            inx(&(cpu->d), &(cpu->e));
-        case 0x14: //INR D
-            inr(cpu, &(cpu->d));
-            break;
-        case 0x15: //DCR D
-            dcr(cpu, &(cpu->d));
-            break;
-        case 0x16: //MVI D,D8
-            mvi(&(cpu->d), d16_l);
-            cpu->pc++;
-            break;
-        case 0x17: // RAL (Rotate accumulator Left, through carry)
-            {
-                uint8_t prev_carry = cpu->flags.c;
-                cpu->flags.c = cpu->a & 0x1; //CY = A[0]
-                cpu->a = ((cpu->a >> 1) | (prev_carry << 7)); //Shift A left, A[7]=prev carry bit
-                break;
-            }
-        case 0x18: //NOP
-            break;
-        case 0x19: //DAD D
-            {
-                uint16_t result = ((cpu->h << 8) | cpu->l) + ((cpu->d << 8) | cpu->e);
-                check_flags(cpu, result, FLAG_C);
-                cpu->h = ((result>>8) & 0xff);
-                cpu->l = (result & 0xff);
-            }
-        case 0x1A: //LDAX D
-            ldax(cpu, &(cpu->a), ((cpu->d <<8) | cpu->e));
-            break;
-        case 0x1B: //DCX D
-            dcx(&(cpu->d), &(cpu->e));
-            break;
-        case 0x1C: //INR E
-            inr(cpu, &(cpu->e));
-            break;
-        case 0x1D: //DCR E
-            dcr(cpu, &(cpu->e));
-            break;
-        case 0x1E: //MVI E, D8
-            mvi((&cpu->e), d16_l);
-            cpu->pc++;
-            break;
-        case 0x1F: //RAR (Rotate A right through carry)
-            not_implemented(*op);
-            break; //TO IMPLEMENT
-        case 0x20: //NOP
-            break;
-        case 0x21: //LXI H,D16
-            cpu->h = d16_h;
-            cpu->l = d16_l;
-            cpu->pc += 2;
-            break;
-        case 0x22: //SHLD addr
-            {
-                uint16_t addr = ((d16_h << 8) | d16_l);
-                cpu->memory[addr] = cpu->l;
-                cpu->memory[addr+1] = cpu->h;
-                cpu->pc += 2;
-                break;
-            }
-        case 0x23: //INX H
-            inx(&(cpu->h), &(cpu->l));
-            break;
-        case 0x24: // INR H
-            inr(cpu, &(cpu->h));
-            break;
-        case 0x25: // DCR H
-            dcr(cpu, &(cpu->h));
-            break;
-        case 0x26: // MVI H,D8
-            mvi(&(cpu->h), d16_l);
-            cpu->pc++;
-            break;
-        case 0x27: // DAA
-            not_implemented(*op);
-            break;
-        case 0x28: // NOP
-            break;
-        case 0x29: // DAD H (HL *= 2)
-            {
-                uint16_t result = (((cpu->h << 8) | cpu->l) << 1);
-                check_flags(cpu, result, FLAG_C);
-                cpu->h = result >> 8;
-                cpu->l = result & 0xff;
-                break;
-            }
-        case 0x2A: // LHLD addr
-            {
-                uint16_t addr = MERGE_16BIT(d16_h, d16_l);
-                cpu->l = cpu->memory[addr];
-                cpu->h = cpu->memory[addr+1];
-                cpu->pc += 2;
-                break;
-            }
-        case 0x2B: // DCH HL
-            dcx(&(cpu->h), &(cpu->l));
-            break;
-        case 0x2C: //INR L
-            inr(cpu, &(cpu->l));
-            break;
-        case 0x2D: // DCR L
-            dcr(cpu, &(cpu->l));
-            break;
-        case 0x2E: // MVI L, D8
-            mvi(&(cpu->l), d16_l);
-            cpu->pc++;
-            break;
-        case 0x2F: // CMA (A = !A)
-            cpu->a = ~(cpu->a) & 0xff;
-            break;
-        case 0x30: // NOP
-            break;
-        case 0x31: //LXI SP,D16 (update stack pointer)
-            cpu->sp = MERGE_16BIT(d16_h, d16_l);
-            cpu->pc += 2;
-            break;
-        case 0x32: //STA addr
-            cpu->memory[MERGE_16BIT(d16_h, d16_l)] = cpu->a;
-            cpu->pc += 2;
-            break;
-        case 0x33: // INX SP
-            cpu->sp += 1;
-            break; 
-        case 0x34: // INR M (Increment data at memory addressed by HL)
-            inr(cpu, &cpu->memory[MERGE_16BIT(cpu->h, cpu->l)]);
-            break;
-        case 0x35: // DCR M (Deccrement data at memory addressed by HL)
-            dcr(cpu, &cpu->memory[MERGE_16BIT(cpu->h, cpu->l)]);
-            break;
-        case 0x36: // MVI M,D8 (Move val into memory addresse dy HL)
-            cpu->memory[MERGE_16BIT(cpu->h, cpu->l)] = d16_l;
-            cpu->pc++;
-            break;
-        case 0x37: // STC
-            cpu->c = 0x1;
-            break;
-        case 0x38: //NOP
-            break;
-        case 0x39: //DAD SP (Add stackpointer to HL)
-            {
-                uint16_t result = MERGE_16BIT(cpu->h, cpu->l) + cpu->sp;
-                check_flags(cpu, result, FLAG_C);
-                cpu->h = result >> 8;
-                cpu->l = result & 0xff;
-                break;
-            }
-        case 0x3A: // LDA addr
-            cpu->a = cpu->memory[MERGE_16BIT(d16_h, d16_l)];
-            cpu->pc += 2;
-            break;
-        case 0x3B: // DCX SP
-            cpu->sp -= 1;
-            break;
-        case 0x3C: // INR A
-            inr(cpu, &(cpu->a));
-            break;
-        case 0x3D: // DCR A
-            dcr(cpu, &(cpu->a));
-            break;
-        case 0x3E: // MVI A,D8
-            mvi(&(cpu->a), d16_l);
-            cpu->pc++;
-            break;
-        case 0x3F: // CMC
-            cpu->c = !(cpu->c);
-        case 0x40: // MOV B,B
-            break;
-        case 0x41: // MOV B,C
-            cpu->b = cpu->c;
-            break;
-        case 0x42: // MOV B, D
-            cpu->b = cpu->d;
-            break;
-        case 0x43: // MOV B,E
-            cpu->b = cpu->e;
-            break;
-        case 0x44: // MOV B,H
-            cpu->b = cpu->h;
-            break;
-        case 0x45: // MOV B,L
-            cpu->b = cpu->l;
-        case 0x46: // MOV B,M
-            cpu->b = cpu->memory[MERGE_16BIT(cpu->h, cpu->l)];
-            break;
-        case 0x47: // MOV B,A
-            cpu->b = cpu->a;
-            break;
-        case 0x48: // MOV C,B
-            cpu->c = cpu->b;
-            break;
-        case 0x49: // MOV C,C
-            break;
-        case 0x4A: // MOV C,D
-            cpu->c = cpu->d;
-            break;
-        case 0x4B: // MOV C,E
-            cpu->c = cpu->e;
-            break;
-        case 0x4C: // MOV C,H
-            cpu->c = cpu->h;
-            break;
-        case 0x4D: // MOV C,L
-            cpu->c = cpu->l;
-            break;
-        case 0x4E: // MOV C,M
-            cpu->c = cpu->memory[MERGE_16BIT(cpu->h, cpu->l)];
-            break;
-        case 0x4F: // MOV C,A
-            cpu->c = cpu->a;
-            break;
-        case 0x50: // MOV D,B
-            cpu->d = cpu->b;
-            break;
-        case 0x51: // MOV D,C
-            cpu->d = cpu->c;
-            break;
-        case 0x52: // MOV D, D
-            break;
-        case 0x53: // MOV D,E
-            cpu->d = cpu->e;
-            break;
-        case 0x54: // MOV D,H
-            cpu->d = cpu->h;
-            break;
-        case 0x55: // MOV D,L
-            cpu->d = cpu->l;
-            break;
-        case 0x56: // MOV D,M
-            cpu->d = cpu->memory[MERGE_16BIT(cpu->h, cpu->l)];
-            break;
-        case 0x57: // MOV D,A
-            cpu->d = cpu->a;
-            break;
-        case 0x58: // MOV E,B
-            cpu->e = cpu->b;
-            break;
-        case 0x59: // MOV E,C
-            cpu->e = cpu->c;
-            break;
-        case 0x5A: // MOV E,D
-            cpu->e = cpu->d;
-            break;
-        case 0x5B: // MOV E,E
-            break;
-        case 0x5C: // MOV E,H
-            cpu->e = cpu->h;
-            break;
-        case 0x5D: // MOV E,L
-            cpu->e = cpu->l;
-        case 0x5E: // MOV E,M
-            cpu->e = cpu->memory[MERGE_16BIT(cpu->h, cpu->l)];
-            break;
-        case 0x5F: // MOV E,A
-            cpu->e = cpu->a;
-            break;
-        case 0x60: // MOV H,B
-            cpu->h = cpu->b;
-            break;
-        case 0x61: // MOV H,C
-            cpu->h = cpu->c;
-            break;
-        case 0x62: // MOV H, D
-            cpu->h = cpu->d;
-            break;
-        case 0x63: // MOV H,E
-            cpu->h = cpu->e;
-            break;
-        case 0x64: // MOV H,H
-            break;
-        case 0x65: // MOV H,L
-            cpu->h = cpu->l;
-            break;
-        case 0x66: // MOV H,M
-            cpu->h = cpu->memory[MERGE_16BIT(cpu->h, cpu->l)];
-            break;
-        case 0x67: // MOV H,A
-            cpu->h = cpu->a;
-            break;
-        case 0x68: // MOV L,B
-            cpu->l = cpu->b;
-        case 0x69: // MOV L,C
-            cpu->l = cpu->c;
-            break;
-        case 0x6A: // MOV L,D
-            cpu->l = cpu->d;
-            break;
-        case 0x6B: // MOV L,E
-            cpu->l = cpu->e;
-            break;
-        case 0x6C: // MOV L,H
-            cpu->l = cpu->h;
-            break;
-        case 0x6D: // MOV L,L
-            break;
-        case 0x6E: // MOV L,M
-            cpu->l = cpu->memory[MERGE_16BIT(cpu->h, cpu->l)];
-            break;
-        case 0x6F: // MOV L,A
-            cpu->l = cpu->a;
-            break;
-        case 0x70: // MOV M,B
-            cpu->memory[MERGE_16BIT(cpu->h, cpu->l)] = cpu->b;
-            break;
-        case 0x71: // MOV M,C
-            cpu->memory[MERGE_16BIT(cpu->h, cpu->l)] = cpu->c;
-            break;
-        case 0x72: // MOV M,D
-            cpu->memory[MERGE_16BIT(cpu->h, cpu->l)] = cpu->d;
-            break;
-        case 0x73: // MOV M,E
-            cpu->memory[MERGE_16BIT(cpu->h, cpu->l)] = cpu->e;
-            break;
-        case 0x74: // MOV M,H
-            cpu->memory[MERGE_16BIT(cpu->h, cpu->l)] = cpu->h;
-            break;
-        case 0x75: // MOV M,L
-            cpu->memory[MERGE_16BIT(cpu->h, cpu->l)] = cpu->l;
-            break;
-        case 0x76: // HLT (HALT - increment pc and wait for interrupt)
-            not_implemented(*op);
-            break;
-        case 0x77: // MOV M,A
-            cpu->memory[MERGE_16BIT(cpu->h, cpu->l)] = cpu->a;
-            break;
-        case 0x78: // MOV A,B
-            cpu->a = cpu->b;
-        case 0x79: // MOV A,C
-            cpu->a = cpu->c;
-            break;
-        case 0x7A: // MOV A,D
-            cpu->a = cpu->d;
-            break;
-        case 0x7B: // MOV A,E
-            cpu->a = cpu->e;
-            break;
-        case 0x7C: // MOV A,H
-            cpu->a = cpu->h;
-            break;
-        case 0x7D: // MOV A,L
-            cpu->a = cpu->l;
-            break;
-        case 0x7E: // MOV A,M
-            cpu->a = cpu->memory[MERGE_16BIT(cpu->h, cpu->l)];
-            break;
-        case 0x7F: // MOV A,A
-            break;
-        case 0x80: // ADD B
-            add(cpu, &(cpu->b));
-            break;
-        case 0x81: // ADD C
-            add(cpu, &(cpu->c));
-            break;
-        case 0x82: // ADD D
-            add(cpu, &(cpu->d));
-            break;
-        case 0x83: // ADD E
-            add(cpu, &(cpu->e));
-            break;
-        case 0x84: // ADD H
-            add(cpu, &(cpu->h));
-            break;
-        case 0x85: // ADD L
-            add(cpu, &(cpu->l));
-            break;
-        case 0x86: // ADD M
-            // not_implemented(*op);
-            // // cpu->a = (cpu->a + cpu->memory[MERGE_16BIT(cpu->h, cpu->l)]);
-            add(cpu, &(cpu->memory[MERGE_16BIT(cpu->h, cpu->l)]));
-            break;
-        case 0x87: // ADD A
-            add(cpu, &(cpu->a));
-            break;
-        case 0x88: // ADC B
-            adc(cpu, &(cpu->b));
-            break;
-        case 0x89: // ADC C
-            adc(cpu, &(cpu->c));
-            break;
-        case 0x8A: // ADC D
-            adc(cpu, &(cpu->d));
-            break;
-        case 0x8B: // ADC E
-            adc(cpu, &(cpu->e));
-            break;
-        case 0x8C: // ADC H
-            adc(cpu, &(cpu->h));
-            break;
-        case 0x8D: // ADC L
-            adc(cpu, &(cpu->l));
-            break;
-        case 0x8E: // ADC M
-            adc(cpu, &(cpu->memory[MERGE_16BIT(cpu->h, cpu->l)]));
-            break;
-        case 0x8F: // ADC A
-            adc(cpu, &(cpu->a));
-            break;
-        case 0x90: // SUB B
-            sub(cpu, &(cpu->b));
-            break;
-        case 0x91: // SUB C
-            sub(cpu, &(cpu->c));
-            break;
-        case 0x92: // SUB D
-            sub(cpu, &(cpu->d));
-            break;
-        case 0x93: // SUB E
-            sub(cpu, &(cpu->e));
-            break;
-        case 0x94: //SUB H
-            sub(cpu, &(cpu->h));
-            break;
-        case 0x95: // SUB L
-            sub(cpu, &(cpu->l));
-            break;
-        case 0x96: // SUB M
-            sub(cpu, &(cpu->memory[MERGE_16BIT(cpu->h, cpu->l)]));
-            break;
-        case 0x97: // SUB A
-            sub(cpu, &(cpu->a));
-            break;
-        case 0x98: // SBB B
-            sbb(cpu, &(cpu->b));
-            break;
-        case 0x99: // SBB C
-            sbb(cpu, &(cpu->c));
-            break;
-        case 0x9A: // SBB D
-            sbb(cpu, &(cpu->d));
-            break;
-        case 0x9B: // SBB E
-            sbb(cpu, &(cpu->e));
-            break;
-        case 0x9C: // SBB H
-            sbb(cpu, &(cpu->h));
-            break;
-        case 0x9D: // SBB L
-            sbb(cpu, &(cpu->l));
-            break;
-        case 0x9E: // SBB M
-            sbb(cpu, &(cpu->memory[MERGE_16BIT(cpu->h, cpu->l)]));
-            break;
-        case 0x9F: // SBB A
-            sbb(cpu, &(cpu->a));
-            break;
-        case 0xA0: // ANA B
-            ana(cpu, &(cpu->b));
-            break;
-        case 0xA1: // ANA C
-            ana(cpu, &(cpu->c));
-            break;
-        case 0xA2: // ANA D
-            ana(cpu, &(cpu->d));
-            break;
-        case 0xA3: // ANA E
-            ana(cpu, &(cpu->e));
-            break;
-        case 0xA4: // ANA H
-            ana(cpu, &(cpu->h));
-            break;
-        case 0xA5: // ANA L
-            ana(cpu, &(cpu->l));
-            break;
-        case 0xA6: // ANA M
-            ana(cpu, &(cpu->memory[MERGE_16BIT(cpu->h, cpu->l)]));
-            break;
-        case 0xA7: // ANA A
-            cpu->flags.c = 0;
-            break;
-        case 0xA8: // XRA B
-            xra(cpu, &(cpu->b));
-            break;
-        case 0xA9: // XRA C
-            xra(cpu, &(cpu->c));
-            break;
-        case 0xAA: // XRA D
-            xra(cpu, &(cpu->d));
-            break;
-        case 0xAB: // XRA E
-            xra(cpu, &(cpu->e));
-            break;
-        case 0xAC: // XRA H
-            xra(cpu, &(cpu->h));
-            break;
-        case 0xAD: // XRA L
-            xra(cpu, &(cpu->l));
-            break;
-        case 0xAE: // XRA M
-            xra(cpu, &(cpu->memory[MERGE_16BIT(cpu->h, cpu->l)]));
-            break;
-        case 0xAF: // XRA A
-            cpu->flags.c = 0;
-            break;
-        case 0xB0: // ORA B
-            ora(cpu, &(cpu->b));
-            break;
-        case 0xB1: // ORA C
-            ora(cpu, &(cpu->c));
-            break;
-        case 0xB2: // ORA D
-            ora(cpu, &(cpu->d));
-            break;
-        case 0xB3: // ORA E
-            ora(cpu, &(cpu->e));
-            break;
-        case 0xB4: // ORA H
-            ora(cpu, &(cpu->h));
-            break;
-        case 0xB5: // ORA L
-            ora(cpu, &(cpu->l));
-            break;
-        case 0xB6: // ORA M
-            ora(cpu, &(cpu->memory[MERGE_16BIT(cpu->h, cpu->l)]));
-            break;
-        case 0xB7: // ORA A
-            cpu->flags.c = 0;
-            break;
-        case 0xB8: // CMP B
-            cmp(cpu, &(cpu->b));
-            break;
-        case 0xB9: // CMP C
-            cmp(cpu, &(cpu->c));
-            break;
-        case 0xBA: // CMP D
-            cmp(cpu, &(cpu->d));
-            break;
-        case 0xBB: // CMP E
-            cmp(cpu, &(cpu->e));
-            break;
-        case 0xBC: // CMP H
-            cmp(cpu, &(cpu->h));
-            break;
-        case 0xBD: // CMP L
-            cmp(cpu, &(cpu->l));
-            break;
-        case 0xBE: // CMP M
-            cmp(cpu, &(cpu->memory[MERGE_16BIT(cpu->h, cpu->l)]));
-            break;
-        case 0xBF: // CMP A
-            cmp(cpu, &(cpu->a));
-            break;
-        case 0xC0: // RNZ
-            if(!cpu->flags.z)
-                ret(cpu);
-            break;
-        case 0xC1: // POP BC
-            pop(cpu, &(cpu->b), &(cpu->c));
-            break;
-        case 0xC2: // JNZ
-            if(!cpu->flags.z){
-                jmp(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
-                cpu->pc += 2;
-            }
-            break;
-        case 0xC3: // JMP
-            jmp(cpu, MERGE_16BIT(d16_h, d16_l));
-            cpu->pc += 2;
-            break;
-        case 0xC4: // CNZ
-            if(!cpu->flags.z){
-                call(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
+    return execute(cpu, cpu->cycles + 1);
+}
+
+/* Execute instructions until at least [budget] cycles have elapsed, firing
+   scheduled events on the way. The last instruction may overshoot the
+   budget, cpu->cycles holds the exact count */
+int run_cycles(i8080_state_t *cpu, uint32_t budget){
+    uint64_t end = cpu->cycles + budget;
+
+    while(cpu->cycles < end){
+        execute(cpu, schedule_slice(cpu, end));
+    }
+    return I8080_OK;
+}
+
+/* Run the interpreter until cpu->cycles reaches target, or HLT */
+static int execute(i8080_state_t *cpu, uint64_t target){
+#ifdef I8080_FUSION
+    uint16_t op; //Op-code, or I8080_FUSE_BASE + kind for a fused pair
+#else
+    uint8_t op;
+#endif
+    uint16_t d16; //Operand bytes 2 and 3 as a 16-bit value
+    uint8_t d8;   //Operand byte 2
+#ifdef I8080_THREADED_CORE
+    static void *const dispatch[I8080_DISPATCH_SIZE] = {
+        &&op_0x00, &&op_0x01, &&op_0x02, &&op_0x03, &&op_0x04, &&op_0x05, &&op_0x06, &&op_0x07, &&op_0x08, &&op_0x09, &&op_0x0A, &&op_0x0B, &&op_0x0C, &&op_0x0D, &&op_0x0E, &&op_0x0F,
+        &&op_0x10, &&op_0x11, &&op_0x12, &&op_0x13, &&op_0x14, &&op_0x15, &&op_0x16, &&op_0x17, &&op_0x18, &&op_0x19, &&op_0x1A, &&op_0x1B, &&op_0x1C, &&op_0x1D, &&op_0x1E, &&op_0x1F,
+        &&op_0x20, &&op_0x21, &&op_0x22, &&op_0x23, &&op_0x24, &&op_0x25, &&op_0x26, &&op_0x27, &&op_0x28, &&op_0x29, &&op_0x2A, &&op_0x2B, &&op_0x2C, &&op_0x2D, &&op_0x2E, &&op_0x2F,
+        &&op_0x30, &&op_0x31, &&op_0x32, &&op_0x33, &&op_0x34, &&op_0x35, &&op_0x36, &&op_0x37, &&op_0x38, &&op_0x39, &&op_0x3A, &&op_0x3B, &&op_0x3C, &&op_0x3D, &&op_0x3E, &&op_0x3F,
+        &&op_0x40, &&op_0x41, &&op_0x42, &&op_0x43, &&op_0x44, &&op_0x45, &&op_0x46, &&op_0x47, &&op_0x48, &&op_0x49, &&op_0x4A, &&op_0x4B, &&op_0x4C, &&op_0x4D, &&op_0x4E, &&op_0x4F,
+        &&op_0x50, &&op_0x51, &&op_0x52, &&op_0x53, &&op_0x54, &&op_0x55, &&op_0x56, &&op_0x57, &&op_0x58, &&op_0x59, &&op_0x5A, &&op_0x5B, &&op_0x5C, &&op_0x5D, &&op_0x5E, &&op_0x5F,
+        &&op_0x60, &&op_0x61, &&op_0x62, &&op_0x63, &&op_0x64, &&op_0x65, &&op_0x66, &&op_0x67, &&op_0x68, &&op_0x69, &&op_0x6A, &&op_0x6B, &&op_0x6C, &&op_0x6D, &&op_0x6E, &&op_0x6F,
+        &&op_0x70, &&op_0x71, &&op_0x72, &&op_0x73, &&op_0x74, &&op_0x75, &&op_0x76, &&op_0x77, &&op_0x78, &&op_0x79, &&op_0x7A, &&op_0x7B, &&op_0x7C, &&op_0x7D, &&op_0x7E, &&op_0x7F,
+        &&op_0x80, &&op_0x81, &&op_0x82, &&op_0x83, &&op_0x84, &&op_0x85, &&op_0x86, &&op_0x87, &&op_0x88, &&op_0x89, &&op_0x8A, &&op_0x8B, &&op_0x8C, &&op_0x8D, &&op_0x8E, &&op_0x8F,
+        &&op_0x90, &&op_0x91, &&op_0x92, &&op_0x93, &&op_0x94, &&op_0x95, &&op_0x96, &&op_0x97, &&op_0x98, &&op_0x99, &&op_0x9A, &&op_0x9B, &&op_0x9C, &&op_0x9D, &&op_0x9E, &&op_0x9F,
+        &&op_0xA0, &&op_0xA1, &&op_0xA2, &&op_0xA3, &&op_0xA4, &&op_0xA5, &&op_0xA6, &&op_0xA7, &&op_0xA8, &&op_0xA9, &&op_0xAA, &&op_0xAB, &&op_0xAC, &&op_0xAD, &&op_0xAE, &&op_0xAF,
+        &&op_0xB0, &&op_0xB1, &&op_0xB2, &&op_0xB3, &&op_0xB4, &&op_0xB5, &&op_0xB6, &&op_0xB7, &&op_0xB8, &&op_0xB9, &&op_0xBA, &&op_0xBB, &&op_0xBC, &&op_0xBD, &&op_0xBE, &&op_0xBF,
+        &&op_0xC0, &&op_0xC1, &&op_0xC2, &&op_0xC3, &&op_0xC4, &&op_0xC5, &&op_0xC6, &&op_0xC7, &&op_0xC8, &&op_0xC9, &&op_0xCA, &&op_0xCB, &&op_0xCC, &&op_0xCD, &&op_0xCE, &&op_0xCF,
+        &&op_0xD0, &&op_0xD1, &&op_0xD2, &&op_0xD3, &&op_0xD4, &&op_0xD5, &&op_0xD6, &&op_0xD7, &&op_0xD8, &&op_0xD9, &&op_0xDA, &&op_0xDB, &&op_0xDC, &&op_0xDD, &&op_0xDE, &&op_0xDF,
+        &&op_0xE0, &&op_0xE1, &&op_0xE2, &&op_0xE3, &&op_0xE4, &&op_0xE5, &&op_0xE6, &&op_0xE7, &&op_0xE8, &&op_0xE9, &&op_0xEA, &&op_0xEB, &&op_0xEC, &&op_0xED, &&op_0xEE, &&op_0xEF,
+        &&op_0xF0, &&op_0xF1, &&op_0xF2, &&op_0xF3, &&op_0xF4, &&op_0xF5, &&op_0xF6, &&op_0xF7, &&op_0xF8, &&op_0xF9, &&op_0xFA, &&op_0xFB, &&op_0xFC, &&op_0xFD, &&op_0xFE, &&op_0xFF
+#ifdef I8080_FUSION
+        , &&op_0x100, &&op_0x101, &&op_0x102, &&op_0x103, &&op_0x104, &&op_0x105, &&op_0x106,
+        &&op_0x107, &&op_0x108, &&op_0x109, &&op_0x10A, &&op_0x10B, &&op_0x10C, &&op_0x10D,
+        &&op_0x10E, &&op_0x10F, &&op_0x110, &&op_0x111
+#endif
+    };
+#endif
+
+    if(cpu->halted){
+        return I8080_OK; //Only an interrupt moves it on
+    }
+    cpu->idle.valid = 0; //Events may have run since the last snapshot
+    while(cpu->cycles < target){
+        FETCH();
+
+        //Parse for OP-Code
+        DISPATCH(op){
+            OP(0x00) NEXT; //NOP
+            OP(0x01) //LXI BC,D16
+                cpu->bc = d16;
                 cpu->pc += 2;
-            }
-            break;
-        case 0xC5: // PUSH BC
-            push(cpu, &(cpu->b), &(cpu->c));
-            break;
-        case 0xC6: // ADI D8
-            {
-                uint16_t result = cpu->a + d16_l;
-                check_flags(cpu, result, FLAG_ALL);
-                cpu->a = result & 0xff;
+                NEXT;
+            OP(0x02) //STAX BC
+                stax(cpu, cpu->bc);
+                NEXT;
+            OP(0x03) //INX BC
+                cpu->bc++;
+                NEXT;
+            OP(0x04) //INR B
+                inr(cpu, &(cpu->b));
+                NEXT;
+            OP(0x05) //DCR B
+                dcr(cpu, &(cpu->b));
+                NEXT;
+            OP(0x06) //MVI B
+                mvi(&(cpu->b), d8);
                 cpu->pc++;
-                break;
-            }
-        case 0xC7: // RST 0
-            not_implemented(*op);
-            break;
-        case 0xC8: // RZ
-            if(cpu->flags.z)
-                ret(cpu);
-            break;
-        case 0xC9: // RET
-            ret(cpu);
-            break;
-        case 0xCA: // JZ adr
-            if(cpu->flags.z){
-                jmp(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
-                cpu->pc += 2;
-            }
-            break;
-        case 0xCB: // NOP
-            break;
-        case 0xCC: // CZ addr
-            if(cpu->flags.c){
-                call(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
-                cpu->pc += 2;
-            }
-            break;
-        case 0xCD: // CALL addr
-            call(cpu, MERGE_16BIT(d16_h, d16_l));
-            break;
-        case 0xCE: // ACI D8
-            {
-                uint16_t result = cpu->a + d16_l + cpu->flags.c;
-                check_flags(cpu, result, FLAG_ALL);
-                cpu->a = result & 0xff;
+                NEXT;
+            OP(0x07) //RLC - Rotate accumulator left
+                MATERIALIZE_FLAGS(cpu);
+                cpu->flags = (cpu->flags & ~FLAG_C) | (cpu->a >> 7); //Carry bit = current A[7]
+                cpu->a = ((cpu->a << 1) | (cpu->a >> 7)) & 0xff;
+                NEXT;
+            OP(0x08) NEXT; //NOP
+            OP(0x09) //DAD BC (Add BC reg to HL reg)
+                {
+                    uint32_t result = cpu->hl + cpu->bc;
+                    MATERIALIZE_FLAGS(cpu);
+                    cpu->flags = (cpu->flags & ~FLAG_C) | (result >> 16);
+                    cpu->hl = result;
+                    NEXT;
+                }
+            OP(0x0A) //LDAX BC (Load BC into A)
+                ldax(cpu, &(cpu->a), cpu->bc);
+                NEXT;
+            OP(0x0B) //DCX BC
+                cpu->bc--;
+                NEXT;
+            OP(0x0C) //INR C
+                inr(cpu, &(cpu->c));
+                NEXT;
+            OP(0x0D) //DCR C
+                dcr(cpu, &(cpu->c));
+                NEXT;
+            OP(0x0E) //MVI C,D8 (Move 8-bit value into C)
+                mvi(&(cpu->c), d8);
                 cpu->pc++;
-                break;
-            }
-        case 0xCF: // RST 1
-            not_implemented(*op);
-            break;
-        case 0xD0: // RNC
-            if(!cpu->flags.c)
-                ret(cpu);
-            break;
-        case 0xD1: // POP DE
-            pop(cpu, &(cpu->d), &(cpu->e));
-            break;
-        case 0xD2: // JNC adr
-            if(!cpu->flags.c){
-                jmp(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
+                NEXT;
+            OP(0x0F) //RRC (Rotate accumulator right)
+                MATERIALIZE_FLAGS(cpu);
+                cpu->flags = (cpu->flags & ~FLAG_C) | (cpu->a & 0x1); //Carry bit = current A[0]
+                cpu->a = ((cpu->a >> 1) | (cpu->a << 7)) & 0xff;
+                NEXT;
+            OP(0x10) //NOP
+                NEXT;
+            OP(0x11) //LXI D, D16 (Load value in DE)
+                cpu->de = d16;
                 cpu->pc += 2;
-            }
-            break;
-        case 0xD3: // OUT D8
-            not_implemented(*op);
-            break;
-        case 0xD4: // CNC addr
-            if(!cpu->flags.c){
-                call(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
+                NEXT;
+            OP(0x12) //STAX D (Load A into memory addressed by DE)
+                stax(cpu, cpu->de);
+                NEXT;
+            OP(0x13) //INX DE
+                cpu->de++;
+                NEXT;
+            OP(0x14) //INR D
+                inr(cpu, &(cpu->d));
+                NEXT;
+            OP(0x15) //DCR D
+                dcr(cpu, &(cpu->d));
+                NEXT;
+            OP(0x16) //MVI D,D8
+                mvi(&(cpu->d), d8);
+                cpu->pc++;
+                NEXT;
+            OP(0x17) // RAL (Rotate accumulator Left, through carry)
+                {
+                    MATERIALIZE_FLAGS(cpu);
+                    uint8_t prev_carry = cpu->flags & FLAG_C;
+                    cpu->flags = (cpu->flags & ~FLAG_C) | (cpu->a >> 7); //CY = A[7]
+                    cpu->a = ((cpu->a << 1) | prev_carry); //Shift A left, A[0]=prev carry bit
+                    NEXT;
+                }
+            OP(0x18) //NOP
+                NEXT;
+            OP(0x19) //DAD D
+                {
+                    uint32_t result = cpu->hl + cpu->de;
+                    MATERIALIZE_FLAGS(cpu);
+                    cpu->flags = (cpu->flags & ~FLAG_C) | (result >> 16);
+                    cpu->hl = result;
+                    NEXT;
+                }
+            OP(0x1A) //LDAX D
+                ldax(cpu, &(cpu->a), cpu->de);
+                NEXT;
+            OP(0x1B) //DCX D
+                cpu->de--;
+                NEXT;
+            OP(0x1C) //INR E
+                inr(cpu, &(cpu->e));
+                NEXT;
+            OP(0x1D) //DCR E
+                dcr(cpu, &(cpu->e));
+                NEXT;
+            OP(0x1E) //MVI E, D8
+                mvi((&cpu->e), d8);
+                cpu->pc++;
+                NEXT;
+            OP(0x1F) //RAR (Rotate A right through carry)
+                {
+                    MATERIALIZE_FLAGS(cpu);
+                    uint8_t prev_carry = cpu->flags & FLAG_C;
+                    cpu->flags = (cpu->flags & ~FLAG_C) | (cpu->a & 0x1); //CY = A[0]
+                    cpu->a = ((cpu->a >> 1) | (prev_carry << 7)); //Shift A right, A[7]=prev carry bit
+                    NEXT;
+                }
+            OP(0x20) //NOP
+                NEXT;
+            OP(0x21) //LXI H,D16
+                cpu->hl = d16;
                 cpu->pc += 2;
-            }
-            break;
-        case 0xD5: // PUSH DE
-            push(cpu, &(cpu->d), &(cpu->e));
-            break;
-        case 0xD6: // SUI D8
-            {
-                uint16_t result = cpu->a - d16_l;
-                check_flags(cpu, result, FLAG_ALL);
-                cpu->a = result & 0xff;
+                NEXT;
+            OP(0x22) //SHLD addr
+                {
+                    write_byte(cpu, d16, cpu->l);
+                    write_byte(cpu, d16 + 1, cpu->h);
+                    cpu->pc += 2;
+                    NEXT;
+                }
+            OP(0x23) //INX H
+                cpu->hl++;
+                NEXT;
+            OP(0x24) // INR H
+                inr(cpu, &(cpu->h));
+                NEXT;
+            OP(0x25) // DCR H
+                dcr(cpu, &(cpu->h));
+                NEXT;
+            OP(0x26) // MVI H,D8
+                mvi(&(cpu->h), d8);
                 cpu->pc++;
-                break;
-            }
-        case 0xD7: // RST 2
-            not_implemented(*op);
-            break;
-        case 0xD8: // RC
-            if(cpu->flags.c)
-                ret(cpu);
-            break;
-        case 0xD9: // NOP
-            break;
-        case 0xDA: // JC addr
-            if(cpu->flags.c){
-                jmp(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
+                NEXT;
+            OP(0x27) // DAA
+                daa(cpu);
+                NEXT;
+            OP(0x28) // NOP
+                NEXT;
+            OP(0x29) // DAD H (HL *= 2)
+                {
+                    uint32_t result = cpu->hl + cpu->hl;
+                    MATERIALIZE_FLAGS(cpu);
+                    cpu->flags = (cpu->flags & ~FLAG_C) | (result >> 16);
+                    cpu->hl = result;
+                    NEXT;
+                }
+            OP(0x2A) // LHLD addr
+                {
+                    cpu->hl = MERGE_16BIT(read_byte(cpu, d16 + 1), read_byte(cpu, d16));
+                    cpu->pc += 2;
+                    NEXT;
+                }
+            OP(0x2B) // DCH HL
+                cpu->hl--;
+                NEXT;
+            OP(0x2C) //INR L
+                inr(cpu, &(cpu->l));
+                NEXT;
+            OP(0x2D) // DCR L
+                dcr(cpu, &(cpu->l));
+                NEXT;
+            OP(0x2E) // MVI L, D8
+                mvi(&(cpu->l), d8);
+                cpu->pc++;
+                NEXT;
+            OP(0x2F) // CMA (A = !A)
+                cpu->a = ~(cpu->a) & 0xff;
+                NEXT;
+            OP(0x30) // NOP
+                NEXT;
+            OP(0x31) //LXI SP,D16 (update stack pointer)
+                cpu->sp = d16;
                 cpu->pc += 2;
-            }
-            break;
-        case 0xDB: // IN D8
-            not_implemented(*op)
-            cpu->pc++;
-            break;
-        case 0xDC: // CC addr
-            if(cpu->flags.c){
-                call(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
+                NEXT;
+            OP(0x32) //STA addr
+                write_byte(cpu, d16, cpu->a);
                 cpu->pc += 2;
-            }
-            break;
-        case 0xDD: // NOP
-            break;
-        case 0xDE: // SBI D8
-            {
-                uint16_t result = cpu->a - d16_l - cpu->flags.c;
-                check_flags(cpu, result, FLAG_ALL);
-                cpu->a = result & 0xff;
+                NEXT;
+            OP(0x33) // INX SP
+                cpu->sp += 1;
+                NEXT; 
+            OP(0x34) // INR M (Increment data at memory addressed by HL)
+                {
+                    uint16_t addr = cpu->hl;
+                    uint8_t value = read_byte(cpu, addr);
+                    inr(cpu, &value);
+                    write_byte(cpu, addr, value);
+                }
+                NEXT;
+            OP(0x35) // DCR M (Deccrement data at memory addressed by HL)
+                {
+                    uint16_t addr = cpu->hl;
+                    uint8_t value = read_byte(cpu, addr);
+                    dcr(cpu, &value);
+                    write_byte(cpu, addr, value);
+                }
+                NEXT;
+            OP(0x36) // MVI M,D8 (Move val into memory addresse dy HL)
+                write_byte(cpu, cpu->hl, d8);
                 cpu->pc++;
-                break;
-            }
-            break;
-        case 0xDF: // RST 3
-            not_implemented(*op);
-            break;
-        case 0xE0: // RPO
-            if(!cpu->flags.p)
-                ret(cpu);
-            break;
-        case 0xE1: // POP HL
-            pop(cpu, &(cpu->h), &(cpu->l));
-            break;
-        case 0xE2: // JPO addr
-            if(!cpu->flags.p){
-                jmp(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
+                NEXT;
+            OP(0x37) // STC
+                MATERIALIZE_FLAGS(cpu);
+                cpu->flags |= FLAG_C;
+                NEXT;
+            OP(0x38) //NOP
+                NEXT;
+            OP(0x39) //DAD SP (Add stackpointer to HL)
+                {
+                    uint32_t result = cpu->hl + cpu->sp;
+                    MATERIALIZE_FLAGS(cpu);
+                    cpu->flags = (cpu->flags & ~FLAG_C) | (result >> 16);
+                    cpu->hl = result;
+                    NEXT;
+                }
+            OP(0x3A) // LDA addr
+                cpu->a = read_byte(cpu, d16);
                 cpu->pc += 2;
-            }
-            break;
-        case 0xE3: // XTHL
-            {
-                uint8_t prev_h = cpu->h;
-                uint8_t prev_l = cpu->l;
-                cpu->l = cpu->memory[cpu->sp];
-                cpu->h = cpu->memory[cpu->sp + 1];
-                cpu->memory[cpu->sp] = prev_l;
-                cpu->memory[cpu->sp + 1] = prev_h;
-            }
-            break;
-        case 0xE4: // CPO addr
-            if(!cpu->flags.p){
-                call(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
-                cpu->pc +=2;
-            }
-            break;
-        case 0xE5: // PUSH H
-            push(cpu, &(cpu->h), &(cpu->l));
-            break;
-        case 0xE6: // ANI D8
-            {
-                uint16_t result = cpu->a & d16_l;
-                check_flags(cpu, result, FLAG_ALL);
-                cpu->a = result & 0xff;
+                NEXT;
+            OP(0x3B) // DCX SP
+                cpu->sp -= 1;
+                NEXT;
+            OP(0x3C) // INR A
+                inr(cpu, &(cpu->a));
+                NEXT;
+            OP(0x3D) // DCR A
+                dcr(cpu, &(cpu->a));
+                NEXT;
+            OP(0x3E) // MVI A,D8
+                mvi(&(cpu->a), d8);
                 cpu->pc++;
-                break;
-            }
-            break;
-        case 0xE7: // RST 4
-            not_implemented(*op);
-            break;
-        case 0xE8: // RPE
-            if(cpu->flags.p)
-                ret(cpu);
-            break;
-        case 0xE9: // PCHL
-            cpu->pc = MERGE_16BIT(d16_h, d16_l);
-            break;
-        case 0xEA: // JPE addr
-            if(cpu->flags.p){
-                jmp(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
-                cpu->pc += 2;
-            }
-            break;
-        case 0xEB: // XCHG
-            {
-                uint8_t prev_d = cpu->d;
-                uint8_t prev_e = cpu->e;
-                cpu->d = cpu->memory[cpu->sp];
-                cpu->e = cpu->memory[cpu->sp + 1];
-                cpu->memory[cpu->sp] = prev_d;
-                cpu->memory[cpu->sp + 1] = prev_e;
-            }
-            break;
-        case 0xEC: // CPE addr
-            if(cpu->flags.p){
-                call(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
-                cpu->pc += 2;
-            }
-            break;
-        case 0xED: // NOP
-            break;
-        case 0xEE: // XRI D8
-            {
-                uint16_t result = cpu->a ^ d16_l;
-                check_flags(cpu, result, FLAG_ALL);
-                cpu->a = result & 0xff;
+                NEXT;
+            OP(0x3F) // CMC
+                MATERIALIZE_FLAGS(cpu);
+                cpu->flags ^= FLAG_C;
+                NEXT;
+            OP(0x40) // MOV B,B
+                NEXT;
+            OP(0x41) // MOV B,C
+                cpu->b = cpu->c;
+                NEXT;
+            OP(0x42) // MOV B, D
+                cpu->b = cpu->d;
+                NEXT;
+            OP(0x43) // MOV B,E
+                cpu->b = cpu->e;
+                NEXT;
+            OP(0x44) // MOV B,H
+                cpu->b = cpu->h;
+                NEXT;
+            OP(0x45) // MOV B,L
+                cpu->b = cpu->l;
+                NEXT;
+            OP(0x46) // MOV B,M
+                cpu->b = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x47) // MOV B,A
+                cpu->b = cpu->a;
+                NEXT;
+            OP(0x48) // MOV C,B
+                cpu->c = cpu->b;
+                NEXT;
+            OP(0x49) // MOV C,C
+                NEXT;
+            OP(0x4A) // MOV C,D
+                cpu->c = cpu->d;
+                NEXT;
+            OP(0x4B) // MOV C,E
+                cpu->c = cpu->e;
+                NEXT;
+            OP(0x4C) // MOV C,H
+                cpu->c = cpu->h;
+                NEXT;
+            OP(0x4D) // MOV C,L
+                cpu->c = cpu->l;
+                NEXT;
+            OP(0x4E) // MOV C,M
+                cpu->c = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x4F) // MOV C,A
+                cpu->c = cpu->a;
+                NEXT;
+            OP(0x50) // MOV D,B
+                cpu->d = cpu->b;
+                NEXT;
+            OP(0x51) // MOV D,C
+                cpu->d = cpu->c;
+                NEXT;
+            OP(0x52) // MOV D, D
+                NEXT;
+            OP(0x53) // MOV D,E
+                cpu->d = cpu->e;
+                NEXT;
+            OP(0x54) // MOV D,H
+                cpu->d = cpu->h;
+                NEXT;
+            OP(0x55) // MOV D,L
+                cpu->d = cpu->l;
+                NEXT;
+            OP(0x56) // MOV D,M
+                cpu->d = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x57) // MOV D,A
+                cpu->d = cpu->a;
+                NEXT;
+            OP(0x58) // MOV E,B
+                cpu->e = cpu->b;
+                NEXT;
+            OP(0x59) // MOV E,C
+                cpu->e = cpu->c;
+                NEXT;
+            OP(0x5A) // MOV E,D
+                cpu->e = cpu->d;
+                NEXT;
+            OP(0x5B) // MOV E,E
+                NEXT;
+            OP(0x5C) // MOV E,H
+                cpu->e = cpu->h;
+                NEXT;
+            OP(0x5D) // MOV E,L
+                cpu->e = cpu->l;
+                NEXT;
+            OP(0x5E) // MOV E,M
+                cpu->e = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x5F) // MOV E,A
+                cpu->e = cpu->a;
+                NEXT;
+            OP(0x60) // MOV H,B
+                cpu->h = cpu->b;
+                NEXT;
+            OP(0x61) // MOV H,C
+                cpu->h = cpu->c;
+                NEXT;
+            OP(0x62) // MOV H, D
+                cpu->h = cpu->d;
+                NEXT;
+            OP(0x63) // MOV H,E
+                cpu->h = cpu->e;
+                NEXT;
+            OP(0x64) // MOV H,H
+                NEXT;
+            OP(0x65) // MOV H,L
+                cpu->h = cpu->l;
+                NEXT;
+            OP(0x66) // MOV H,M
+                cpu->h = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x67) // MOV H,A
+                cpu->h = cpu->a;
+                NEXT;
+            OP(0x68) // MOV L,B
+                cpu->l = cpu->b;
+                NEXT;
+            OP(0x69) // MOV L,C
+                cpu->l = cpu->c;
+                NEXT;
+            OP(0x6A) // MOV L,D
+                cpu->l = cpu->d;
+                NEXT;
+            OP(0x6B) // MOV L,E
+                cpu->l = cpu->e;
+                NEXT;
+            OP(0x6C) // MOV L,H
+                cpu->l = cpu->h;
+                NEXT;
+            OP(0x6D) // MOV L,L
+                NEXT;
+            OP(0x6E) // MOV L,M
+                cpu->l = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x6F) // MOV L,A
+                cpu->l = cpu->a;
+                NEXT;
+            OP(0x70) // MOV M,B
+                write_byte(cpu, cpu->hl, cpu->b);
+                NEXT;
+            OP(0x71) // MOV M,C
+                write_byte(cpu, cpu->hl, cpu->c);
+                NEXT;
+            OP(0x72) // MOV M,D
+                write_byte(cpu, cpu->hl, cpu->d);
+                NEXT;
+            OP(0x73) // MOV M,E
+                write_byte(cpu, cpu->hl, cpu->e);
+                NEXT;
+            OP(0x74) // MOV M,H
+                write_byte(cpu, cpu->hl, cpu->h);
+                NEXT;
+            OP(0x75) // MOV M,L
+                write_byte(cpu, cpu->hl, cpu->l);
+                NEXT;
+            OP(0x76) // HLT (HALT - increment pc and wait for interrupt)
+                cpu->halted = 1;
+                target = cpu->cycles; //Hand back to the scheduler
+                NEXT;
+            OP(0x77) // MOV M,A
+                write_byte(cpu, cpu->hl, cpu->a);
+                NEXT;
+            OP(0x78) // MOV A,B
+                cpu->a = cpu->b;
+                NEXT;
+            OP(0x79) // MOV A,C
+                cpu->a = cpu->c;
+                NEXT;
+            OP(0x7A) // MOV A,D
+                cpu->a = cpu->d;
+                NEXT;
+            OP(0x7B) // MOV A,E
+                cpu->a = cpu->e;
+                NEXT;
+            OP(0x7C) // MOV A,H
+                cpu->a = cpu->h;
+                NEXT;
+            OP(0x7D) // MOV A,L
+                cpu->a = cpu->l;
+                NEXT;
+            OP(0x7E) // MOV A,M
+                cpu->a = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x7F) // MOV A,A
+                NEXT;
+            OP(0x80) // ADD B
+                add(cpu, &(cpu->b));
+                NEXT;
+            OP(0x81) // ADD C
+                add(cpu, &(cpu->c));
+                NEXT;
+            OP(0x82) // ADD D
+                add(cpu, &(cpu->d));
+                NEXT;
+            OP(0x83) // ADD E
+                add(cpu, &(cpu->e));
+                NEXT;
+            OP(0x84) // ADD H
+                add(cpu, &(cpu->h));
+                NEXT;
+            OP(0x85) // ADD L
+                add(cpu, &(cpu->l));
+                NEXT;
+            OP(0x86) // ADD M
+                d8 = read_byte(cpu, cpu->hl);
+                add(cpu, &d8);
+                NEXT;
+            OP(0x87) // ADD A
+                add(cpu, &(cpu->a));
+                NEXT;
+            OP(0x88) // ADC B
+                adc(cpu, &(cpu->b));
+                NEXT;
+            OP(0x89) // ADC C
+                adc(cpu, &(cpu->c));
+                NEXT;
+            OP(0x8A) // ADC D
+                adc(cpu, &(cpu->d));
+                NEXT;
+            OP(0x8B) // ADC E
+                adc(cpu, &(cpu->e));
+                NEXT;
+            OP(0x8C) // ADC H
+                adc(cpu, &(cpu->h));
+                NEXT;
+            OP(0x8D) // ADC L
+                adc(cpu, &(cpu->l));
+                NEXT;
+            OP(0x8E) // ADC M
+                d8 = read_byte(cpu, cpu->hl);
+                adc(cpu, &d8);
+                NEXT;
+            OP(0x8F) // ADC A
+                adc(cpu, &(cpu->a));
+                NEXT;
+            OP(0x90) // SUB B
+                sub(cpu, &(cpu->b));
+                NEXT;
+            OP(0x91) // SUB C
+                sub(cpu, &(cpu->c));
+                NEXT;
+            OP(0x92) // SUB D
+                sub(cpu, &(cpu->d));
+                NEXT;
+            OP(0x93) // SUB E
+                sub(cpu, &(cpu->e));
+                NEXT;
+            OP(0x94) //SUB H
+                sub(cpu, &(cpu->h));
+                NEXT;
+            OP(0x95) // SUB L
+                sub(cpu, &(cpu->l));
+                NEXT;
+            OP(0x96) // SUB M
+                d8 = read_byte(cpu, cpu->hl);
+                sub(cpu, &d8);
+                NEXT;
+            OP(0x97) // SUB A
+                sub(cpu, &(cpu->a));
+                NEXT;
+            OP(0x98) // SBB B
+                sbb(cpu, &(cpu->b));
+                NEXT;
+            OP(0x99) // SBB C
+                sbb(cpu, &(cpu->c));
+                NEXT;
+            OP(0x9A) // SBB D
+                sbb(cpu, &(cpu->d));
+                NEXT;
+            OP(0x9B) // SBB E
+                sbb(cpu, &(cpu->e));
+                NEXT;
+            OP(0x9C) // SBB H
+                sbb(cpu, &(cpu->h));
+                NEXT;
+            OP(0x9D) // SBB L
+                sbb(cpu, &(cpu->l));
+                NEXT;
+            OP(0x9E) // SBB M
+                d8 = read_byte(cpu, cpu->hl);
+                sbb(cpu, &d8);
+                NEXT;
+            OP(0x9F) // SBB A
+                sbb(cpu, &(cpu->a));
+                NEXT;
+            OP(0xA0) // ANA B
+                ana(cpu, &(cpu->b));
+                NEXT;
+            OP(0xA1) // ANA C
+                ana(cpu, &(cpu->c));
+                NEXT;
+            OP(0xA2) // ANA D
+                ana(cpu, &(cpu->d));
+                NEXT;
+            OP(0xA3) // ANA E
+                ana(cpu, &(cpu->e));
+                NEXT;
+            OP(0xA4) // ANA H
+                ana(cpu, &(cpu->h));
+                NEXT;
+            OP(0xA5) // ANA L
+                ana(cpu, &(cpu->l));
+                NEXT;
+            OP(0xA6) // ANA M
+                d8 = read_byte(cpu, cpu->hl);
+                ana(cpu, &d8);
+                NEXT;
+            OP(0xA7) // ANA A
+                ana(cpu, &(cpu->a));
+                NEXT;
+            OP(0xA8) // XRA B
+                xra(cpu, &(cpu->b));
+                NEXT;
+            OP(0xA9) // XRA C
+                xra(cpu, &(cpu->c));
+                NEXT;
+            OP(0xAA) // XRA D
+                xra(cpu, &(cpu->d));
+                NEXT;
+            OP(0xAB) // XRA E
+                xra(cpu, &(cpu->e));
+                NEXT;
+            OP(0xAC) // XRA H
+                xra(cpu, &(cpu->h));
+                NEXT;
+            OP(0xAD) // XRA L
+                xra(cpu, &(cpu->l));
+                NEXT;
+            OP(0xAE) // XRA M
+                d8 = read_byte(cpu, cpu->hl);
+                xra(cpu, &d8);
+                NEXT;
+            OP(0xAF) // XRA A
+                xra(cpu, &(cpu->a));
+                NEXT;
+            OP(0xB0) // ORA B
+                ora(cpu, &(cpu->b));
+                NEXT;
+            OP(0xB1) // ORA C
+                ora(cpu, &(cpu->c));
+                NEXT;
+            OP(0xB2) // ORA D
+                ora(cpu, &(cpu->d));
+                NEXT;
+            OP(0xB3) // ORA E
+                ora(cpu, &(cpu->e));
+                NEXT;
+            OP(0xB4) // ORA H
+                ora(cpu, &(cpu->h));
+                NEXT;
+            OP(0xB5) // ORA L
+                ora(cpu, &(cpu->l));
+                NEXT;
+            OP(0xB6) // ORA M
+                d8 = read_byte(cpu, cpu->hl);
+                ora(cpu, &d8);
+                NEXT;
+            OP(0xB7) // ORA A
+                ora(cpu, &(cpu->a));
+                NEXT;
+            OP(0xB8) // CMP B
+                cmp(cpu, &(cpu->b));
+                NEXT;
+            OP(0xB9) // CMP C
+                cmp(cpu, &(cpu->c));
+                NEXT;
+            OP(0xBA) // CMP D
+                cmp(cpu, &(cpu->d));
+                NEXT;
+            OP(0xBB) // CMP E
+                cmp(cpu, &(cpu->e));
+                NEXT;
+            OP(0xBC) // CMP H
+                cmp(cpu, &(cpu->h));
+                NEXT;
+            OP(0xBD) // CMP L
+                cmp(cpu, &(cpu->l));
+                NEXT;
+            OP(0xBE) // CMP M
+                d8 = read_byte(cpu, cpu->hl);
+                cmp(cpu, &d8);
+                NEXT;
+            OP(0xBF) // CMP A
+                cmp(cpu, &(cpu->a));
+                NEXT;
+            OP(0xC0) // RNZ
+                cond_ret(cpu, !FLAG_TEST(cpu, FLAG_Z));
+                NEXT;
+            OP(0xC1) // POP BC
+                cpu->bc = pop(cpu);
+                NEXT;
+            OP(0xC2) // JNZ
+                if(!FLAG_TEST(cpu, FLAG_Z)){
+                    JUMP(d16);
+                }else{
+                    cpu->pc += 2;
+                }
+                NEXT;
+            OP(0xC3) // JMP
+                JUMP(d16);
+                NEXT;
+            OP(0xC4) // CNZ
+                cond_call(cpu, !FLAG_TEST(cpu, FLAG_Z), d16);
+                NEXT;
+            OP(0xC5) // PUSH BC
+                push(cpu, cpu->bc);
+                NEXT;
+            OP(0xC6) // ADI D8
+                add(cpu, &d8);
                 cpu->pc++;
-                break;
-            }
-            break;
-        case 0xEF: // RST 4
-            not_implemented(*op);
-            break;
-        case 0xF0: // RPE
-            if(cpu->flags.p)
+                NEXT;
+            OP(0xC7) // RST 0
+                rst(cpu, 0);
+                NEXT;
+            OP(0xC8) // RZ
+                cond_ret(cpu, FLAG_TEST(cpu, FLAG_Z));
+                NEXT;
+            OP(0xC9) // RET
                 ret(cpu);
-            break;
-        case 0xF1: // POP PSW
-            not_implemented(*op);
-            break;
-        case 0xF2: // JP addr
-            if(cpu->flags.p){
-                jmp(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
-                cpu->pc += 2;
-            }
-            break;
-        case 0xF3: // DI
-            not_implemented(*op);
-            break;
-        case 0xF4: // CP addr
-            if(cpu->flags.p){
-                call(cpu, MERGE_16BIT(d16_h, d16_l));
-            }else{
-                cpu->pc += 2;
-            }
-            break;
-        case 0xF5: // PUSH PSW
-            not_implemented(*op);
-            break;
-        case 0xF6:
-            break;
-        case 0xF7:
-            break;
-        case 0xF8:
-            break;
-        case 0xF9:
-            break;
-        case 0xFA:
-            break;
-        case 0xFB:
-            break;
-        case 0xFC:
-            break;
-        case 0xFD:
-            break;
-        case 0xFE:
-            break;
-        case 0xFF:
-            break;
-        default: 
-            break;
+                NEXT;
+            OP(0xCA) // JZ adr
+                if(FLAG_TEST(cpu, FLAG_Z)){
+                    JUMP(d16);
+                }else{
+                    cpu->pc += 2;
+                }
+                NEXT;
+            OP(0xCB) // NOP
+                NEXT;
+            OP(0xCC) // CZ addr
+                cond_call(cpu, FLAG_TEST(cpu, FLAG_Z), d16);
+                NEXT;
+            OP(0xCD) // CALL addr
+                call(cpu, d16);
+                NEXT;
+            OP(0xCE) // ACI D8
+                adc(cpu, &d8);
+                cpu->pc++;
+                NEXT;
+            OP(0xCF) // RST 1
+                rst(cpu, 1);
+                NEXT;
+            OP(0xD0) // RNC
+                cond_ret(cpu, !FLAG_TEST(cpu, FLAG_C));
+                NEXT;
+            OP(0xD1) // POP DE
+                cpu->de = pop(cpu);
+                NEXT;
+            OP(0xD2) // JNC adr
+                if(!FLAG_TEST(cpu, FLAG_C)){
+                    JUMP(d16);
+                }else{
+                    cpu->pc += 2;
+                }
+                NEXT;
+            OP(0xD3) // OUT D8
+                port_out(cpu, d8, cpu->a);
+                cpu->pc++;
+                NEXT;
+            OP(0xD4) // CNC addr
+                cond_call(cpu, !FLAG_TEST(cpu, FLAG_C), d16);
+                NEXT;
+            OP(0xD5) // PUSH DE
+                push(cpu, cpu->de);
+                NEXT;
+            OP(0xD6) // SUI D8
+                sub(cpu, &d8);
+                cpu->pc++;
+                NEXT;
+            OP(0xD7) // RST 2
+                rst(cpu, 2);
+                NEXT;
+            OP(0xD8) // RC
+                cond_ret(cpu, FLAG_TEST(cpu, FLAG_C));
+                NEXT;
+            OP(0xD9) // NOP
+                NEXT;
+            OP(0xDA) // JC addr
+                if(FLAG_TEST(cpu, FLAG_C)){
+                    JUMP(d16);
+                }else{
+                    cpu->pc += 2;
+                }
+                NEXT;
+            OP(0xDB) // IN D8
+                cpu->a = port_in(cpu, d8);
+                cpu->pc++;
+                NEXT;
+            OP(0xDC) // CC addr
+                cond_call(cpu, FLAG_TEST(cpu, FLAG_C), d16);
+                NEXT;
+            OP(0xDD) // NOP
+                NEXT;
+            OP(0xDE) // SBI D8
+                sbb(cpu, &d8);
+                cpu->pc++;
+                NEXT;
+            OP(0xDF) // RST 3
+                rst(cpu, 3);
+                NEXT;
+            OP(0xE0) // RPO
+                cond_ret(cpu, !FLAG_TEST(cpu, FLAG_P));
+                NEXT;
+            OP(0xE1) // POP HL
+                cpu->hl = pop(cpu);
+                NEXT;
+            OP(0xE2) // JPO addr
+                if(!FLAG_TEST(cpu, FLAG_P)){
+                    JUMP(d16);
+                }else{
+                    cpu->pc += 2;
+                }
+                NEXT;
+            OP(0xE3) // XTHL
+                {
+                    uint16_t prev_hl = cpu->hl;
+                    cpu->hl = MERGE_16BIT(read_byte(cpu, cpu->sp + 1), read_byte(cpu, cpu->sp));
+                    write_byte(cpu, cpu->sp, prev_hl & 0xff);
+                    write_byte(cpu, cpu->sp + 1, prev_hl >> 8);
+                }
+                NEXT;
+            OP(0xE4) // CPO addr
+                cond_call(cpu, !FLAG_TEST(cpu, FLAG_P), d16);
+                NEXT;
+            OP(0xE5) // PUSH H
+                push(cpu, cpu->hl);
+                NEXT;
+            OP(0xE6) // ANI D8
+                ana(cpu, &d8);
+                cpu->pc++;
+                NEXT;
+            OP(0xE7) // RST 4
+                rst(cpu, 4);
+                NEXT;
+            OP(0xE8) // RPE
+                cond_ret(cpu, FLAG_TEST(cpu, FLAG_P));
+                NEXT;
+            OP(0xE9) // PCHL
+                cpu->pc = cpu->hl;
+                NEXT;
+            OP(0xEA) // JPE addr
+                if(FLAG_TEST(cpu, FLAG_P)){
+                    JUMP(d16);
+                }else{
+                    cpu->pc += 2;
+                }
+                NEXT;
+            OP(0xEB) // XCHG (Swap DE and HL)
+                {
+                    uint16_t prev_de = cpu->de;
+                    cpu->de = cpu->hl;
+                    cpu->hl = prev_de;
+                }
+                NEXT;
+            OP(0xEC) // CPE addr
+                cond_call(cpu, FLAG_TEST(cpu, FLAG_P), d16);
+                NEXT;
+            OP(0xED) // NOP
+                NEXT;
+            OP(0xEE) // XRI D8
+                xra(cpu, &d8);
+                cpu->pc++;
+                NEXT;
+            OP(0xEF) // RST 5
+                rst(cpu, 5);
+                NEXT;
+            OP(0xF0) // RP
+                cond_ret(cpu, !FLAG_TEST(cpu, FLAG_S));
+                NEXT;
+            OP(0xF1) // POP PSW
+                MATERIALIZE_FLAGS(cpu);
+                cpu->psw = pop(cpu);
+                cpu->flags = (cpu->flags & FLAG_ALL) | I8080_FLAGS_DEFAULT;
+                NEXT;
+            OP(0xF2) // JP addr
+                if(!FLAG_TEST(cpu, FLAG_S)){
+                    JUMP(d16);
+                }else{
+                    cpu->pc += 2;
+                }
+                NEXT;
+            OP(0xF3) // DI
+                cpu->int_enable = 0;
+                NEXT;
+            OP(0xF4) // CP addr
+                cond_call(cpu, !FLAG_TEST(cpu, FLAG_S), d16);
+                NEXT;
+            OP(0xF5) // PUSH PSW
+                MATERIALIZE_FLAGS(cpu);
+                push(cpu, cpu->psw);
+                NEXT;
+            OP(0xF6) // ORI D8
+                ora(cpu, &d8);
+                cpu->pc++;
+                NEXT;
+            OP(0xF7) // RST 6
+                rst(cpu, 6);
+                NEXT;
+            OP(0xF8) // RM
+                cond_ret(cpu, FLAG_TEST(cpu, FLAG_S));
+                NEXT;
+            OP(0xF9) // SPHL
+                cpu->sp = cpu->hl;
+                NEXT;
+            OP(0xFA) // JM addr
+                if(FLAG_TEST(cpu, FLAG_S)){
+                    JUMP(d16);
+                }else{
+                    cpu->pc += 2;
+                }
+                NEXT;
+            OP(0xFB) // EI
+                cpu->int_enable = 1;
+                if(cpu->int_request){
+                    target = cpu->cycles + 1; //Accept it after the next instruction
+                }
+                NEXT;
+            OP(0xFC) // CM addr
+                cond_call(cpu, FLAG_TEST(cpu, FLAG_S), d16);
+                NEXT;
+            OP(0xFD)
+                NEXT;
+            OP(0xFE) // CPI D8
+                cmp(cpu, &d8);
+                cpu->pc++;
+                NEXT;
+            OP(0xFF) // RST 7
+                rst(cpu, 7);
+                NEXT;
+#ifdef I8080_FUSION
+            OP(0x100) // DCR B + JNZ addr
+                dcr(cpu, &(cpu->b));
+                FUSED_JNZ();
+                NEXT;
+            OP(0x101) // DCR C + JNZ addr
+                dcr(cpu, &(cpu->c));
+                FUSED_JNZ();
+                NEXT;
+            OP(0x102) // DCR D + JNZ addr
+                dcr(cpu, &(cpu->d));
+                FUSED_JNZ();
+                NEXT;
+            OP(0x103) // DCR E + JNZ addr
+                dcr(cpu, &(cpu->e));
+                FUSED_JNZ();
+                NEXT;
+            OP(0x104) // DCR H + JNZ addr
+                dcr(cpu, &(cpu->h));
+                FUSED_JNZ();
+                NEXT;
+            OP(0x105) // DCR L + JNZ addr
+                dcr(cpu, &(cpu->l));
+                FUSED_JNZ();
+                NEXT;
+            OP(0x106) // DCR A + JNZ addr
+                dcr(cpu, &(cpu->a));
+                FUSED_JNZ();
+                NEXT;
+            OP(0x107) // INX H + MOV B,M
+                cpu->hl++;
+                FUSED_SECOND(0x46);
+                cpu->b = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x108) // INX H + MOV C,M
+                cpu->hl++;
+                FUSED_SECOND(0x4E);
+                cpu->c = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x109) // INX H + MOV D,M
+                cpu->hl++;
+                FUSED_SECOND(0x56);
+                cpu->d = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x10A) // INX H + MOV E,M
+                cpu->hl++;
+                FUSED_SECOND(0x5E);
+                cpu->e = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x10B) // INX H + MOV H,M
+                cpu->hl++;
+                FUSED_SECOND(0x66);
+                cpu->h = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x10C) // INX H + MOV L,M
+                cpu->hl++;
+                FUSED_SECOND(0x6E);
+                cpu->l = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x10D) // INX H + MOV A,M
+                cpu->hl++;
+                FUSED_SECOND(0x7E);
+                cpu->a = read_byte(cpu, cpu->hl);
+                NEXT;
+            OP(0x10E) // LDAX B + MOV M,A
+                ldax(cpu, &(cpu->a), cpu->bc);
+                FUSED_SECOND(0x77);
+                write_byte(cpu, cpu->hl, cpu->a);
+                NEXT;
+            OP(0x10F) // LDAX D + MOV M,A
+                ldax(cpu, &(cpu->a), cpu->de);
+                FUSED_SECOND(0x77);
+                write_byte(cpu, cpu->hl, cpu->a);
+                NEXT;
+            OP(0x110) // CPI D8 + JZ addr
+                cmp(cpu, &d8);
+                cpu->pc++;
+                FUSED_SECOND(0xCA);
+                if(FLAG_TEST(cpu, FLAG_Z)){
+                    JUMP(d16);
+                }else{
+                    cpu->pc += 2;
+                }
+                NEXT;
+            OP(0x111) // CPI D8 + JNZ addr
+                cmp(cpu, &d8);
+                cpu->pc++;
+                FUSED_SECOND(0xC2);
+                if(!FLAG_TEST(cpu, FLAG_Z)){
+                    JUMP(d16);
+                }else{
+                    cpu->pc += 2;
+                }
+                NEXT;
+#endif
+        }
     }
+#ifdef I8080_THREADED_CORE
+done:
+#endif
 
     return I8080_OK;
 }
@@ -1172,6 +1849,7 @@ int load_rom(i8080_state_t *cpu, char *rom_filename){
     //Open file
     FILE *rom_file;
     int rom_size;
+    uint8_t *rom_image;
 
     if((rom_file = fopen(rom_filename, "rb")) == NULL){
         return I8080_ERROR;
@@ -1181,19 +1859,39 @@ int load_rom(i8080_state_t *cpu, char *rom_filename){
     fseek(rom_file, 0, SEEK_END);
     rom_size = ftell(rom_file);
     rewind(rom_file);
-    
-    //Load ROM into CPU memory
-    if(rom_size > I8080_MAX_MEMORY_SIZE){
+    if(rom_size < 0 || rom_size > I8080_MAX_MEMORY_SIZE){
+        fclose(rom_file);
         return I8080_ERROR;
     }
-    printf("ROM Size: %d\n", rom_size);
-    cpu->loaded_rom_size = rom_size;
-    int read_bytes = fread(cpu->memory, sizeof(uint8_t), rom_size, rom_file);
+
+    //Read the whole image before touching memory, save states are deltas against it
+    if((rom_image = malloc(rom_size > 0 ? rom_size : 1)) == NULL){
+        fclose(rom_file);
+        return I8080_ERROR;
+    }
+    int read_bytes = fread(rom_image, sizeof(uint8_t), rom_size, rom_file);
+    fclose(rom_file);
     if( read_bytes != rom_size){
+        free(rom_image);
         return I8080_ERROR;
     }
 
-    fclose(rom_file);
+    //Load ROM into CPU memory
+    memcpy(cpu->memory, rom_image, rom_size);
+    free(cpu->rom_image);
+    cpu->rom_image = rom_image;
+    cpu->loaded_rom_size = rom_size;
+    //The load is a store like any other for snapshots and cached code
+    for(int page = 0; page < (rom_size + I8080_PAGE_SIZE - 1) >> I8080_PAGE_SHIFT; page++){
+        MARK_DIRTY(cpu, page);
+    }
+    invalidate_range(cpu, 0, rom_size);
+#ifdef I8080_DECODE_CACHE
+    if(cpu->decode_cache != NULL){
+        predecode_range(cpu, 0, rom_size);
+    }
+#endif
+
     return I8080_OK;
 }
 
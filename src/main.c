@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/intel8080.h"
+
+int main(int argc, char **argv){
+    //Initialise
+    puts("Loading Intel8080 CPU Emulator...");
+    i8080_state_t *cpu = create_cpu(0);
+
+    // i8080_rom_t *rom = malloc(sizeof(i8080_rom_t));
+    if(cpu == NULL){
+        fprintf(stderr, "[ERROR]: Could not intialise CPU\n");
+        return 1;
+    }
+
+    //Get ROM filename to load
+    if(argc < 2){
+        fprintf(stderr, "[ERROR]: No input file provided\n");
+        return 1;
+    }
+
+#ifdef I8080_DECODE_CACHE
+    if(init_decode_cache(cpu) != I8080_OK){
+        fprintf(stderr, "[ERROR]: Could not allocate decode cache\n");
+        return 1;
+    }
+#endif
+
+    char *rom_filename = *(argv+1);
+    printf("Loading ROM File: %s\n", rom_filename);
+
+    // if(load_rom(cpu, rom_filename) != I8080_OK){
+    //     fprintf(stderr, "[ERROR]: did not load ROM\n");
+    //     return 1;
+    // }
+
+    cpu->pc = 0;
+    cpu->cycles = 0;
+    clear_flags(cpu);
+
+#ifdef I8080_CALL_PROFILE
+    //Optional symbol file after the ROM, collapsed stacks go to calls.folded
+    if(start_call_profile(cpu, 0) != I8080_OK){
+        fprintf(stderr, "[ERROR]: Could not start call profile\n");
+        return 1;
+    }
+    if(argc > 2){
+        load_symbols(cpu, argv[2]);
+    }
+#endif
+
+    // //TEST RUN
+    // while(cpu->pc < cpu->loaded_rom_size){
+    //     run_instruction(cpu);
+    // }
+    // run_instruction(cpu);
+
+    // test_inr(cpu);
+    // test_dcr(cpu);
+    // test_mvi(cpu);
+    test_ldax(cpu);
+
+#ifdef I8080_FUSION
+    display_fusion_stats(cpu);
+#endif
+#ifdef I8080_PROFILE
+    display_profile(cpu, 32);
+#endif
+#ifdef I8080_CALL_PROFILE
+    write_call_profile(cpu, "calls.folded");
+    stop_call_profile(cpu);
+#endif
+#ifdef I8080_DECODE_CACHE
+    free_decode_cache(cpu);
+#endif
+    destroy_cpu(cpu);
+
+    return 0;
+}
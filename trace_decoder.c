@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define I8080_TRACE
+#include "include/intel8080.h"
+
+/* Offline decoder for traces written by write_trace(). Prints one line per
+   record, oldest first: cycle count, PC, the registers and flags before the
+   instruction ran, then the instruction as the disassembler prints it.
+
+   Usage: trace_decoder <trace file> [-n last records] */
+
+/* S Z A P C, '.' where clear */
+static void flag_string(uint8_t flags, char *out){
+    out[0] = flags & FLAG_S ? 'S' : '.';
+    out[1] = flags & FLAG_Z ? 'Z' : '.';
+    out[2] = flags & FLAG_AC ? 'A' : '.';
+    out[3] = flags & FLAG_P ? 'P' : '.';
+    out[4] = flags & FLAG_C ? 'C' : '.';
+    out[5] = '\0';
+}
+
+int main(int argc, char **argv){
+    char *filename = NULL;
+    uint64_t last = 0;
+    i8080_trace_header_t header;
+    i8080_trace_record_t record;
+    FILE *trace_file;
+
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+            last = strtoull(argv[++i], NULL, 0);
+        }else{
+            filename = argv[i];
+        }
+    }
+    if(filename == NULL){
+        fprintf(stderr, "ERROR: Usage: %s <trace file> [-n last records]\n", argv[0]);
+        return 1;
+    }
+    if((trace_file = fopen(filename, "rb")) == NULL){
+        fprintf(stderr, "ERROR: Could not open trace file: %s\n", filename);
+        return 1;
+    }
+    if(fread(&header, sizeof(header), 1, trace_file) != 1 ||
+       memcmp(header.magic, I8080_TRACE_MAGIC, sizeof(header.magic)) != 0){
+        fprintf(stderr, "ERROR: %s is not a trace file\n", filename);
+        return 1;
+    }
+    if(header.version != I8080_TRACE_VERSION || header.record_size != sizeof(record)){
+        fprintf(stderr, "ERROR: Trace version %u with %u byte records, expected %d with %zu\n",
+                header.version, header.record_size, I8080_TRACE_VERSION, sizeof(record));
+        return 1;
+    }
+
+    printf("Trace: %llu records of %llu instructions\n",
+           (unsigned long long)header.records, (unsigned long long)header.total);
+    if(last != 0 && last < header.records){
+        fseek(trace_file, (long)((header.records - last) * sizeof(record)), SEEK_CUR);
+    }
+    while(fread(&record, sizeof(record), 1, trace_file) == 1){
+        uint8_t bytes[3] = {record.op, record.imm & 0xff, record.imm >> 8};
+        char text[I8080_DISASM_TEXT_SIZE];
+        char flags[6];
+        flag_string(record.psw & 0xff, flags);
+        disassemble_instruction(bytes, sizeof(bytes), text, sizeof(text));
+        printf("%12llu  %04X  A=%02X BC=%04X DE=%04X HL=%04X SP=%04X %s  %s\n",
+               (unsigned long long)record.cycles, record.pc, record.psw >> 8,
+               record.bc, record.de, record.hl, record.sp, flags, text);
+    }
+    fclose(trace_file);
+    return 0;
+}